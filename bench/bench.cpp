@@ -0,0 +1,1027 @@
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+#include <glm/glm.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "DynamicResolution.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "TriangleRasterizer.h"
+#include "lighting.h"
+#include "mesh_io.h"
+#include "mesh_simplification.h"
+#include "primitives.h"
+#include "texture.h"
+
+// Renders a scene into the rasterizer's own buffers for a fixed number of
+// frames, with no window and no vsync, and reports how long the frames took.
+// Every frame advances the animation by the same fixed time step, so a given
+// set of options always renders the exact same frames, which can be dumped
+// and compared against previously dumped golden images.
+
+const float FIXED_TIME_STEP = 1.0f / 60.0f;
+
+// Heap allocations are counted while a frame is being measured, by
+// replacing every global operator new and delete, so that frames which have
+// warmed up can be checked to not allocate at all.
+std::atomic<bool> is_counting_allocations(false);
+std::atomic<Uint64> allocation_count(0);
+
+// Returns nullptr when out of memory, for the nothrow operators. Everything
+// is freed with std::free(), including the overaligned allocations.
+void* allocate_counted(size_t size, size_t alignment) {
+    if (is_counting_allocations.load(std::memory_order_relaxed)) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+
+    // std::aligned_alloc() needs the size to be a multiple of the alignment.
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* allocate_counted_or_throw(size_t size, size_t alignment) {
+    void* memory = allocate_counted(size, alignment);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void* operator new(size_t size) {
+    return allocate_counted_or_throw(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size) {
+    return allocate_counted_or_throw(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_counted_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_counted_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate_counted(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate_counted(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_counted(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_counted(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+struct BenchOptions {
+    std::string scene_name = "cubes";
+    int object_count = 1000;
+    float object_size = 0.25f;
+    std::string mesh_path;
+    std::string save_mesh_path;
+    float lod_pixel_error = 0.0f;
+
+    int width = 640;
+    int height = 360;
+    int frame_count = 300;
+    int warmup_frame_count = 10;
+
+    std::string kernel_name;
+    int thread_count = 0;
+
+    bool is_texturing = true;
+    bool is_using_coordinate_texture = false;
+    std::string texture_path = "resources/test-texture.png";
+    texture::TextureFilter texture_filter = texture::TextureFilter::NEAREST;
+    texture::TextureWrap texture_wrap = texture::TextureWrap::REPEAT;
+
+    bool is_drawing_overdraw_heatmap = false;
+    bool is_shading_deferred = false;
+    bool is_sorting_draws = true;
+    bool is_checking_allocations = false;
+    int sample_count = 1;
+    raster_kernels::DepthFormat depth_format = raster_kernels::DepthFormat::FLOAT;
+    int perspective_span_length = 0;
+    lighting::LightingModel lighting_model = lighting::LightingModel::UNLIT;
+    float frame_budget_milliseconds = 0.0f;
+
+    std::string dump_directory;
+    std::string dump_format = "ppm";
+    std::string compare_directory;
+    int dump_interval = 60;
+    int compare_tolerance = 0;
+};
+
+// An object added to the scene along with how it moves.
+struct BenchObject {
+    int id;
+    glm::vec3 position;
+    float phase_degrees;
+
+    // Applied before anything else, to bring loaded meshes to a sensible size.
+    glm::mat4 normalization = glm::mat4(1.0f);
+};
+
+// --------------------------------------------------------------------------
+
+void print_usage() {
+    std::cout
+        << "usage: 3d-software-renderer-bench [options]\n"
+        << "\n"
+        << "  --scene cubes|stress|mesh     the two cubes from the demo, a grid of many small cubes, or a loaded mesh (cubes)\n"
+        << "  --objects N                   number of cubes in the stress scene (1000)\n"
+        << "  --object-size S               edge length of the stress scene's cubes, which sets the triangle sizes (0.25)\n"
+        << "  --mesh PATH                   .obj, .ply or .mesh file for the mesh scene, scaled to fit the view, or\n"
+        << "                                to use instead of the stress scene's cubes\n"
+        << "  --lod PIXELS                  build coarser versions of the mesh, and draw each object with the coarsest\n"
+        << "                                one that is off by at most PIXELS on screen\n"
+        << "  --save-mesh PATH              write the mesh scene's mesh to PATH in the binary .mesh format\n"
+        << "  --width W, --height H         render resolution (640x360)\n"
+        << "  --frames N                    number of measured frames (300)\n"
+        << "  --warmup N                    frames rendered before measuring (10)\n"
+        << "  --kernel scalar|sse2|avx2     raster kernel (best supported)\n"
+        << "  --threads N                   rasterizer threads (all hardware threads)\n"
+        << "  --texture PATH                texture image (resources/test-texture.png)\n"
+        << "  --no-texture                  shade with vertex colors only\n"
+        << "  --coordinate-texture          use a generated texture whose texels are their own coordinates, so that\n"
+        << "                                color differences in --compare are texture coordinate errors in texels\n"
+        << "  --filter nearest|bilinear|nearest-mipmap|trilinear (nearest)\n"
+        << "  --wrap clamp|repeat           (repeat)\n"
+        << "  --overdraw-heatmap            render how many times each pixel was shaded instead of its color\n"
+        << "  --deferred                    record visible triangles first, then shade each visible pixel once\n"
+        << "  --unsorted                    draw objects in the order they were added instead of nearest first\n"
+        << "  --check-allocations           exit with an error if any measured frame allocates from the heap\n"
+        << "  --msaa 1|2|4                  samples per pixel, where each triangle still shades a pixel only once (1)\n"
+        << "  --depth float|reversed|16|24  depth buffer format (float)\n"
+        << "  --perspective-span 0|8|16     perspective-correct large triangles only every that many pixels (0, every pixel)\n"
+        << "  --lighting unlit|lambert|phong\n"
+        << "                                light the textures or vertex colors with shaders (unlit)\n"
+        << "  --frame-budget MS             lower the render resolution whenever frames take longer than MS, and\n"
+        << "                                raise it back up when they are well under it\n"
+        << "  --dump DIR                    write every Nth measured frame to DIR/frame_NNNN.<format>\n"
+        << "  --dump-format ppm|png         (ppm)\n"
+        << "  --dump-interval N             (60)\n"
+        << "  --compare DIR                 compare the same frames against DIR/frame_NNNN.ppm, and\n"
+        << "                                exit with an error if any of them differ\n"
+        << "  --tolerance N                 let compared color channels be off by up to N, to bound the error of\n"
+        << "                                --perspective-span against frames dumped without it (0)\n";
+}
+
+// --------------------------------------------------------------------------
+
+bool parse_int_option(const char* value, int min_value, int& result) {
+    char* end = nullptr;
+    long parsed_value = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed_value < min_value) {
+        return false;
+    }
+
+    result = static_cast<int>(parsed_value);
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool parse_float_option(const char* value, float& result) {
+    char* end = nullptr;
+    float parsed_value = std::strtof(value, &end);
+    if (end == value || *end != '\0' || !(parsed_value > 0.0f)) {
+        return false;
+    }
+
+    result = parsed_value;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool parse_options(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+
+        if (name == "--help") {
+            print_usage();
+            std::exit(0);
+        } else if (name == "--no-texture") {
+            options.is_texturing = false;
+            continue;
+        } else if (name == "--coordinate-texture") {
+            options.is_using_coordinate_texture = true;
+            continue;
+        } else if (name == "--overdraw-heatmap") {
+            options.is_drawing_overdraw_heatmap = true;
+            continue;
+        } else if (name == "--deferred") {
+            options.is_shading_deferred = true;
+            continue;
+        } else if (name == "--unsorted") {
+            options.is_sorting_draws = false;
+            continue;
+        } else if (name == "--check-allocations") {
+            options.is_checking_allocations = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "[ERROR] unknown option or missing value: " << name << std::endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        bool is_valid = true;
+
+        if (name == "--scene") {
+            options.scene_name = value;
+            is_valid = options.scene_name == "cubes" || options.scene_name == "stress" || options.scene_name == "mesh";
+        } else if (name == "--objects") {
+            is_valid = parse_int_option(value, 1, options.object_count);
+        } else if (name == "--object-size") {
+            is_valid = parse_float_option(value, options.object_size);
+        } else if (name == "--mesh") {
+            options.mesh_path = value;
+        } else if (name == "--save-mesh") {
+            options.save_mesh_path = value;
+        } else if (name == "--lod") {
+            is_valid = parse_float_option(value, options.lod_pixel_error);
+        } else if (name == "--width") {
+            is_valid = parse_int_option(value, 1, options.width);
+        } else if (name == "--height") {
+            is_valid = parse_int_option(value, 1, options.height);
+        } else if (name == "--frames") {
+            is_valid = parse_int_option(value, 1, options.frame_count);
+        } else if (name == "--warmup") {
+            is_valid = parse_int_option(value, 0, options.warmup_frame_count);
+        } else if (name == "--kernel") {
+            options.kernel_name = value;
+            is_valid = options.kernel_name == "scalar" || options.kernel_name == "sse2" || options.kernel_name == "avx2";
+        } else if (name == "--threads") {
+            is_valid = parse_int_option(value, 1, options.thread_count);
+        } else if (name == "--texture") {
+            options.texture_path = value;
+        } else if (name == "--filter") {
+            std::string filter_name = value;
+            if (filter_name == "nearest") {
+                options.texture_filter = texture::TextureFilter::NEAREST;
+            } else if (filter_name == "bilinear") {
+                options.texture_filter = texture::TextureFilter::BILINEAR;
+            } else if (filter_name == "nearest-mipmap") {
+                options.texture_filter = texture::TextureFilter::NEAREST_MIPMAP;
+            } else if (filter_name == "trilinear") {
+                options.texture_filter = texture::TextureFilter::TRILINEAR;
+            } else {
+                is_valid = false;
+            }
+        } else if (name == "--wrap") {
+            std::string wrap_name = value;
+            if (wrap_name == "clamp") {
+                options.texture_wrap = texture::TextureWrap::CLAMP;
+            } else if (wrap_name == "repeat") {
+                options.texture_wrap = texture::TextureWrap::REPEAT;
+            } else {
+                is_valid = false;
+            }
+        } else if (name == "--msaa") {
+            is_valid = parse_int_option(value, 1, options.sample_count) && (options.sample_count == 1 || options.sample_count == 2 || options.sample_count == 4);
+        } else if (name == "--depth") {
+            std::string depth_format_name = value;
+            if (depth_format_name == "float") {
+                options.depth_format = raster_kernels::DepthFormat::FLOAT;
+            } else if (depth_format_name == "reversed") {
+                options.depth_format = raster_kernels::DepthFormat::REVERSED_FLOAT;
+            } else if (depth_format_name == "16") {
+                options.depth_format = raster_kernels::DepthFormat::UNORM16;
+            } else if (depth_format_name == "24") {
+                options.depth_format = raster_kernels::DepthFormat::UNORM24;
+            } else {
+                is_valid = false;
+            }
+        } else if (name == "--perspective-span") {
+            is_valid = parse_int_option(value, 0, options.perspective_span_length)
+                    && (options.perspective_span_length == 0 || options.perspective_span_length == 8 || options.perspective_span_length == 16);
+        } else if (name == "--lighting") {
+            std::string lighting_model_name = value;
+            if (lighting_model_name == "unlit") {
+                options.lighting_model = lighting::LightingModel::UNLIT;
+            } else if (lighting_model_name == "lambert") {
+                options.lighting_model = lighting::LightingModel::LAMBERT;
+            } else if (lighting_model_name == "phong") {
+                options.lighting_model = lighting::LightingModel::PHONG;
+            } else {
+                is_valid = false;
+            }
+        } else if (name == "--frame-budget") {
+            is_valid = parse_float_option(value, options.frame_budget_milliseconds);
+        } else if (name == "--dump") {
+            options.dump_directory = value;
+        } else if (name == "--dump-format") {
+            options.dump_format = value;
+            is_valid = options.dump_format == "ppm" || options.dump_format == "png";
+        } else if (name == "--dump-interval") {
+            is_valid = parse_int_option(value, 1, options.dump_interval);
+        } else if (name == "--compare") {
+            options.compare_directory = value;
+        } else if (name == "--tolerance") {
+            is_valid = parse_int_option(value, 0, options.compare_tolerance);
+        } else {
+            std::cerr << "[ERROR] unknown option: " << name << std::endl;
+            return false;
+        }
+
+        if (!is_valid) {
+            std::cerr << "[ERROR] invalid value for " << name << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (options.mesh_path.empty() && (options.scene_name == "mesh" || !options.save_mesh_path.empty() || options.lod_pixel_error > 0.0f)) {
+        std::cerr << "[ERROR] --scene mesh, --save-mesh and --lod need a --mesh" << std::endl;
+        return false;
+    } else if (!options.mesh_path.empty() && options.scene_name == "cubes") {
+        std::cerr << "[ERROR] --mesh goes with --scene mesh or stress" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::KernelType choose_kernel_type(const std::string& kernel_name) {
+    if (kernel_name == "scalar") {
+        return raster_kernels::KernelType::SCALAR;
+    } else if (kernel_name == "sse2") {
+        return raster_kernels::KernelType::SSE2;
+    } else if (kernel_name == "avx2") {
+        return raster_kernels::KernelType::AVX2;
+    }
+
+    return raster_kernels::best_supported_kernel_type();
+}
+
+// --------------------------------------------------------------------------
+
+std::unique_ptr<texture::Texture> load_texture(const std::string& path) {
+    SDL_Surface* surface = IMG_Load(path.c_str());
+    if (surface == nullptr) {
+        std::cerr << "[ERROR] IMG_Load error: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+
+    const SDL_PixelFormatDetails* pixel_format_details = SDL_GetPixelFormatDetails(surface->format);
+    if (pixel_format_details->bytes_per_pixel != 4) {
+        SDL_Surface* converted_surface = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA8888);
+        SDL_DestroySurface(surface);
+
+        if (converted_surface == nullptr) {
+            std::cerr << "[ERROR] SDL_ConvertSurface could not convert loaded image surface to RGBA8888 pixel format: " << SDL_GetError() << std::endl;
+            return nullptr;
+        }
+
+        surface = converted_surface;
+    }
+
+    std::unique_ptr<texture::Texture> loaded_texture(new texture::Texture(surface));
+    SDL_DestroySurface(surface);
+
+    return loaded_texture;
+}
+
+// --------------------------------------------------------------------------
+
+// Every texel's red and green channels are its column and row, so with
+// nearest filtering and clamping, how far apart two renders' channels are is
+// how far apart the texture coordinates they sampled with were, in texels.
+std::unique_ptr<texture::Texture> make_coordinate_texture() {
+    const int TEXTURE_SIZE = 256;
+
+    SDL_Surface* surface = SDL_CreateSurface(TEXTURE_SIZE, TEXTURE_SIZE, SDL_PIXELFORMAT_RGBA8888);
+    if (surface == nullptr) {
+        std::cerr << "[ERROR] SDL_CreateSurface error: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(surface->pixels) + y * surface->pitch);
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            row[x] = (static_cast<Uint32>(x) << 24) | (static_cast<Uint32>(y) << 16) | 0xFF;
+        }
+    }
+
+    std::unique_ptr<texture::Texture> coordinate_texture(new texture::Texture(surface));
+    SDL_DestroySurface(surface);
+
+    return coordinate_texture;
+}
+
+// --------------------------------------------------------------------------
+
+// Loads the mesh given with --mesh, and also writes it out in the binary
+// format when asked to.
+bool load_bench_mesh(const std::string& mesh_path, const std::string& save_mesh_path, Object& mesh) {
+    std::chrono::steady_clock::time_point load_start = std::chrono::steady_clock::now();
+    if (!mesh_io::load_mesh(mesh_path, mesh)) {
+        return false;
+    }
+    std::chrono::steady_clock::time_point load_end = std::chrono::steady_clock::now();
+
+    std::cout << "mesh: " << mesh_path << ", " << mesh.get_vertex_count() << " vertices, "
+              << mesh.get_triangle_count() << " triangles, loaded in "
+              << std::fixed << std::setprecision(3)
+              << std::chrono::duration<double, std::milli>(load_end - load_start).count() << " ms" << std::endl;
+
+    return save_mesh_path.empty() || mesh_io::save_binary_mesh(save_mesh_path, mesh);
+}
+
+// --------------------------------------------------------------------------
+
+// Centers the mesh and scales it so that it fits in a sphere of the given
+// radius, whichever way it is turned.
+glm::mat4 fit_mesh(const Object& mesh, float fitted_radius) {
+    const bounding_volumes::BoundingBox& bounds = mesh.get_bounds();
+    if (bounding_volumes::is_empty(bounds)) {
+        return glm::mat4(1.0f);
+    }
+
+    glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+    float radius = 0.5f * glm::length(bounds.max - bounds.min);
+    float scale = radius > 0.0f ? fitted_radius / radius : 1.0f;
+
+    return glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -center);
+}
+
+// --------------------------------------------------------------------------
+
+// The same two cubes the interactive renderer shows.
+void add_cubes_scene(Scene& scene, const texture::Texture* texture, std::vector<BenchObject>& bench_objects) {
+    int big_cube_id = scene.add_object(primitives::cuboid(2.0f, 2.0f, 2.0f, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f), texture, glm::mat4(1.0f));
+    int small_cube_id = scene.add_object(primitives::cuboid(0.5f, 0.5f, 0.5f, glm::vec3(1.0f, 0.0f, 0.0f), 1.0f), texture, glm::mat4(1.0f));
+
+    bench_objects.push_back({ big_cube_id, glm::vec3(-1.5f, 0.0f, 0.0f), 0.0f });
+    bench_objects.push_back({ small_cube_id, glm::vec3(1.75f, 0.0f, 0.0f), 0.0f });
+}
+
+// --------------------------------------------------------------------------
+
+// A grid of cubes filling a box in front of the camera, a little wider than
+// the view so that some of them get culled. Nearer cubes cover the farther
+// ones, so there is plenty of overdraw too. Given a mesh, every cube is
+// replaced by a copy of it, scaled down to the size of the cube.
+void add_stress_scene(Scene& scene,
+                      const texture::Texture* texture,
+                      int object_count,
+                      float object_size,
+                      const Object* mesh,
+                      std::vector<BenchObject>& bench_objects) {
+
+    glm::mat4 normalization = glm::mat4(1.0f);
+    if (mesh != nullptr) {
+        normalization = fit_mesh(*mesh, 0.5f * std::sqrt(3.0f) * object_size);
+    }
+
+    int columns = static_cast<int>(std::ceil(std::cbrt(static_cast<float>(object_count))));
+    int rows = columns;
+    int layers = (object_count + columns * rows - 1) / (columns * rows);
+
+    const float NEAREST_Z = -1.0f;
+    const float FARTHEST_Z = -25.0f;
+
+    for (int i = 0; i < object_count; i++) {
+        int column = i % columns;
+        int row = (i / columns) % rows;
+        int layer = i / (columns * rows);
+
+        // Each layer is shifted by a different fraction of a grid cell, so the
+        // layers behind don't line up exactly with the cubes in front of them.
+        float layer_shift_x = 0.618f * layer - std::floor(0.618f * layer);
+        float layer_shift_y = 0.382f * layer - std::floor(0.382f * layer);
+
+        float x_fraction = (column + layer_shift_x) / columns;
+        float y_fraction = (row + layer_shift_y) / rows;
+        float z_fraction = layers > 1 ? static_cast<float>(layer) / (layers - 1) : 0.5f;
+
+        // The box widens with distance along with the view frustum.
+        float z = NEAREST_Z + (FARTHEST_Z - NEAREST_Z) * z_fraction;
+        float half_height = 0.5f * (5.0f - z);
+        float half_width = half_height * 2.0f;
+
+        glm::vec3 position = glm::vec3((x_fraction - 0.5f) * 2.0f * half_width, (y_fraction - 0.5f) * 2.0f * half_height, z);
+        glm::vec3 color = glm::vec3(x_fraction, y_fraction, 1.0f - z_fraction);
+
+        Object object = mesh != nullptr ? *mesh : primitives::cuboid(object_size, object_size, object_size, color, 1.0f);
+        int id = scene.add_object(std::move(object), texture, glm::mat4(1.0f));
+
+        bench_objects.push_back({ id, position, i * 21.0f, normalization });
+    }
+}
+
+// --------------------------------------------------------------------------
+
+// The mesh on its own, in the same space as the big cube of the cubes scene.
+void add_mesh_scene(Scene& scene, const texture::Texture* texture, const Object& mesh, std::vector<BenchObject>& bench_objects) {
+    int id = scene.add_object(mesh, texture, glm::mat4(1.0f));
+    bench_objects.push_back({ id, glm::vec3(0.0f), 0.0f, fit_mesh(mesh, 1.75f) });
+}
+
+// --------------------------------------------------------------------------
+
+// Rotates every object the same way the interactive renderer does, offset
+// by each object's own phase.
+void animate_objects(Scene& scene, const std::vector<BenchObject>& bench_objects, float time) {
+    const float ROTATION_DEGREES_Y_PER_SECOND = 360.0f / 8.0f;
+    const float ROTATION_DEGREES_X_PER_SECOND = 360.0f / 16.0f;
+
+    for (const BenchObject& bench_object : bench_objects) {
+        float rotation_degrees_y = ROTATION_DEGREES_Y_PER_SECOND * time + bench_object.phase_degrees;
+        float rotation_degrees_x = ROTATION_DEGREES_X_PER_SECOND * time + bench_object.phase_degrees;
+
+        glm::mat4 rotation_x = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_x), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::mat4 rotation_y = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_y), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 translation = glm::translate(glm::mat4(1.0f), bench_object.position);
+
+        scene.set_model(bench_object.id, translation * rotation_x * rotation_y * bench_object.normalization);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+std::string frame_path(const std::string& directory, int frame_index, const std::string& extension) {
+    char file_name[32];
+    std::snprintf(file_name, sizeof(file_name), "frame_%04d.", frame_index);
+
+    return directory + "/" + file_name + extension;
+}
+
+// --------------------------------------------------------------------------
+
+bool write_ppm(const std::string& path, const TriangleRasterizer& triangle_rasterizer) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "[ERROR] could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    int width = triangle_rasterizer.get_buffer_width();
+    int height = triangle_rasterizer.get_buffer_height();
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    const Uint32* color_buffer = triangle_rasterizer.get_color_buffer();
+    std::vector<Uint8> row(width * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            Uint32 pixel = color_buffer[y * width + x];
+            row[x * 3 + 0] = static_cast<Uint8>(pixel >> 24);
+            row[x * 3 + 1] = static_cast<Uint8>(pixel >> 16);
+            row[x * 3 + 2] = static_cast<Uint8>(pixel >> 8);
+        }
+
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+
+    bool was_written = std::ferror(file) == 0;
+    std::fclose(file);
+
+    if (!was_written) {
+        std::cerr << "[ERROR] could not write " << path << std::endl;
+    }
+
+    return was_written;
+}
+
+// --------------------------------------------------------------------------
+
+bool write_png(const std::string& path, const TriangleRasterizer& triangle_rasterizer) {
+    int width = triangle_rasterizer.get_buffer_width();
+    int height = triangle_rasterizer.get_buffer_height();
+
+    // The surface only borrows the color buffer, which is never written to.
+    void* pixels = const_cast<Uint32*>(triangle_rasterizer.get_color_buffer());
+    SDL_Surface* surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_RGBA8888, pixels, width * sizeof(Uint32));
+    if (surface == nullptr) {
+        std::cerr << "[ERROR] SDL_CreateSurfaceFrom error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    bool was_written = IMG_SavePNG(surface, path.c_str());
+    if (!was_written) {
+        std::cerr << "[ERROR] IMG_SavePNG error: " << SDL_GetError() << std::endl;
+    }
+
+    SDL_DestroySurface(surface);
+    return was_written;
+}
+
+// --------------------------------------------------------------------------
+
+// Only reads back what write_ppm() writes: binary PPMs with 8 bits per channel.
+bool read_ppm(const std::string& path, int& width, int& height, std::vector<Uint8>& rgb) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "[ERROR] could not open " << path << std::endl;
+        return false;
+    }
+
+    int max_value = 0;
+    bool has_header = std::fscanf(file, "P6 %d %d %d", &width, &height, &max_value) == 3
+                   && max_value == 255
+                   && width > 0
+                   && height > 0
+                   && std::fgetc(file) != EOF;
+
+    bool was_read = false;
+    if (has_header) {
+        rgb.resize(width * height * 3);
+        was_read = std::fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    }
+
+    std::fclose(file);
+
+    if (!was_read) {
+        std::cerr << "[ERROR] " << path << " is not an 8-bit binary PPM" << std::endl;
+    }
+
+    return was_read;
+}
+
+// --------------------------------------------------------------------------
+
+// Returns the number of pixels that have a color channel more than the
+// tolerance away from the golden image, or -1 if it couldn't be read or has
+// a different size. The largest difference of any channel is kept as well.
+int count_pixels_differing_from_golden(const std::string& path, const TriangleRasterizer& triangle_rasterizer, int tolerance, int& max_difference) {
+    int golden_width, golden_height;
+    std::vector<Uint8> golden_rgb;
+    if (!read_ppm(path, golden_width, golden_height, golden_rgb)) {
+        return -1;
+    }
+
+    int width = triangle_rasterizer.get_buffer_width();
+    int height = triangle_rasterizer.get_buffer_height();
+    if (golden_width != width || golden_height != height) {
+        std::cerr << "[ERROR] " << path << " is " << golden_width << "x" << golden_height
+                  << " but the frame is " << width << "x" << height << std::endl;
+        return -1;
+    }
+
+    const Uint32* color_buffer = triangle_rasterizer.get_color_buffer();
+    int differing_pixel_count = 0;
+    for (int i = 0; i < width * height; i++) {
+        Uint32 pixel = color_buffer[i];
+
+        int pixel_difference = 0;
+        for (int channel = 0; channel < 3; channel++) {
+            int value = static_cast<Uint8>(pixel >> (24 - 8 * channel));
+            pixel_difference = std::max(pixel_difference, std::abs(value - golden_rgb[i * 3 + channel]));
+        }
+
+        max_difference = std::max(max_difference, pixel_difference);
+        if (pixel_difference > tolerance) {
+            differing_pixel_count++;
+        }
+    }
+
+    return differing_pixel_count;
+}
+
+// --------------------------------------------------------------------------
+
+void report_frame_times(std::vector<double> frame_milliseconds) {
+    std::sort(frame_milliseconds.begin(), frame_milliseconds.end());
+
+    double total_milliseconds = 0.0;
+    for (double milliseconds : frame_milliseconds) {
+        total_milliseconds += milliseconds;
+    }
+
+    int frame_count = static_cast<int>(frame_milliseconds.size());
+    int p99_index = static_cast<int>(std::ceil(0.99 * frame_count)) - 1;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "frame time (ms): min " << frame_milliseconds.front()
+              << "  mean " << total_milliseconds / frame_count
+              << "  p99 " << frame_milliseconds[p99_index]
+              << "  max " << frame_milliseconds.back() << "\n"
+              << "frames per second (mean): " << std::setprecision(1) << 1000.0 * frame_count / total_milliseconds << std::endl;
+}
+
+// --------------------------------------------------------------------------
+
+void report_pipeline_stats(const PipelineStats& stats, int frame_count) {
+    const raster_kernels::PixelStats& pixels = stats.pixels;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "triangles per frame: " << static_cast<double>(stats.submitted_triangles) / frame_count << " submitted, "
+              << static_cast<double>(stats.frustum_culled_triangles) / frame_count << " frustum culled, "
+              << static_cast<double>(stats.clipped_triangles) / frame_count << " clipped, "
+              << static_cast<double>(stats.back_face_culled_triangles) / frame_count << " back-face culled, "
+              << static_cast<double>(stats.zero_area_triangles) / frame_count << " zero area, "
+              << static_cast<double>(stats.rasterized_triangles) / frame_count << " rasterized\n"
+              << "pixels per frame: " << static_cast<double>(pixels.visited_pixels) / frame_count << " visited, "
+              << static_cast<double>(pixels.covered_pixels) / frame_count << " covered, "
+              << static_cast<double>(pixels.depth_rejected_pixels) / frame_count << " depth rejected, "
+              << static_cast<double>(pixels.shaded_pixels) / frame_count << " shaded, "
+              << static_cast<double>(pixels.resolved_pixels) / frame_count << " resolved" << std::endl;
+}
+
+// --------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    std::unique_ptr<texture::Texture> loaded_texture;
+    if (options.is_texturing) {
+        loaded_texture = options.is_using_coordinate_texture ? make_coordinate_texture() : load_texture(options.texture_path);
+        if (loaded_texture == nullptr) {
+            return 1;
+        }
+    }
+
+    TriangleRasterizer triangle_rasterizer(options.width, options.height);
+    triangle_rasterizer.set_overdraw_tracking(options.is_drawing_overdraw_heatmap);
+    triangle_rasterizer.set_deferred_shading(options.is_shading_deferred);
+    triangle_rasterizer.set_multisampling(options.sample_count);
+    triangle_rasterizer.set_depth_format(options.depth_format);
+    triangle_rasterizer.set_perspective_subdivision(options.perspective_span_length);
+
+    raster_kernels::KernelType kernel_type = choose_kernel_type(options.kernel_name);
+    if (!raster_kernels::is_kernel_type_supported(kernel_type)) {
+        std::cerr << "[ERROR] the " << raster_kernels::kernel_type_name(kernel_type) << " kernel is not supported on this cpu" << std::endl;
+        return 1;
+    }
+    triangle_rasterizer.set_kernel_type(kernel_type);
+
+    if (options.thread_count > 0) {
+        triangle_rasterizer.set_thread_count(options.thread_count);
+    }
+
+    Object mesh;
+    if (!options.mesh_path.empty() && !load_bench_mesh(options.mesh_path, options.save_mesh_path, mesh)) {
+        return 1;
+    }
+
+    Scene scene;
+    std::vector<BenchObject> bench_objects;
+    if (options.scene_name == "stress") {
+        const Object* stress_mesh = options.mesh_path.empty() ? nullptr : &mesh;
+        add_stress_scene(scene, loaded_texture.get(), options.object_count, options.object_size, stress_mesh, bench_objects);
+    } else if (options.scene_name == "mesh") {
+        add_mesh_scene(scene, loaded_texture.get(), mesh, bench_objects);
+    } else {
+        add_cubes_scene(scene, loaded_texture.get(), bench_objects);
+    }
+
+    // Every object is a copy of the mesh, so they can all share its levels.
+    if (options.lod_pixel_error > 0.0f) {
+        const int MIN_LOD_TRIANGLE_COUNT = 16;
+
+        std::chrono::steady_clock::time_point lod_start = std::chrono::steady_clock::now();
+        std::shared_ptr<const std::vector<mesh_simplification::LevelOfDetail>> lods =
+            std::make_shared<const std::vector<mesh_simplification::LevelOfDetail>>(mesh_simplification::build_lods(mesh, MIN_LOD_TRIANGLE_COUNT));
+        std::chrono::steady_clock::time_point lod_end = std::chrono::steady_clock::now();
+
+        std::cout << "lods: " << mesh.get_triangle_count();
+        for (const mesh_simplification::LevelOfDetail& lod : *lods) {
+            std::cout << ", " << lod.object.get_triangle_count() << " (error " << std::setprecision(4) << lod.geometric_error << ")";
+        }
+        std::cout << " triangles, built in " << std::setprecision(3)
+                  << std::chrono::duration<double, std::milli>(lod_end - lod_start).count() << " ms" << std::endl;
+
+        for (int i = 0; i < scene.get_object_count(); i++) {
+            scene.set_lods(i, lods);
+        }
+        scene.set_lod_selection(options.lod_pixel_error, options.height);
+    }
+
+    texture::SamplerState sampler_state = { options.texture_filter, options.texture_wrap };
+    for (int i = 0; i < scene.get_object_count(); i++) {
+        scene.set_sampler_state(i, sampler_state);
+    }
+
+    RenderQueue render_queue;
+    render_queue.set_sorting(options.is_sorting_draws);
+
+    const lighting::Light light = lighting::default_light();
+    RenderQueue::DrawFunction draw_function = lighting::get_draw_function(options.lighting_model);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(options.width) / options.height, 0.1f, 100.0f);
+
+    glm::vec3 camera_position = glm::vec3(0.0f, 0.0f, 5.0f);
+    glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "scene: " << options.scene_name << " (" << scene.get_object_count() << " objects), "
+              << options.width << "x" << options.height << ", "
+              << options.frame_count << " frames after " << options.warmup_frame_count << " warmup frames, "
+              << "kernel: " << raster_kernels::kernel_type_name(triangle_rasterizer.get_kernel_type()) << ", "
+              << "threads: " << triangle_rasterizer.get_thread_count() << ", "
+              << "samples: " << triangle_rasterizer.get_multisampling() << ", "
+              << "depth: " << raster_kernels::depth_format_name(triangle_rasterizer.get_depth_format()) << ", "
+              << "perspective span: " << triangle_rasterizer.get_perspective_subdivision() << ", "
+              << "lighting: " << lighting::lighting_model_name(options.lighting_model) << std::endl;
+
+    std::vector<double> frame_milliseconds;
+    frame_milliseconds.reserve(options.frame_count);
+
+    // Without a frame budget, the scale is never fed any frame times and
+    // stays at the full resolution.
+    DynamicResolution dynamic_resolution(options.frame_budget_milliseconds);
+    double scale_total = 0.0;
+    float min_scale = 1.0f;
+
+    long long visible_object_total = 0;
+    long long reduced_lod_object_total = 0;
+    int differing_frame_count = 0;
+    int max_difference = 0;
+    int allocating_frame_count = 0;
+    bool has_failed = false;
+
+    for (int frame = 0; frame < options.warmup_frame_count + options.frame_count; frame++) {
+        // The stats add up over every measured frame.
+        if (frame == options.warmup_frame_count) {
+            triangle_rasterizer.reset_pipeline_stats();
+        }
+
+        bool is_measured_frame = frame >= options.warmup_frame_count;
+        Uint64 allocation_count_before_frame = allocation_count.load();
+        is_counting_allocations = is_measured_frame;
+
+        std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+        animate_objects(scene, bench_objects, frame * FIXED_TIME_STEP);
+
+        int render_width, render_height;
+        dynamic_resolution.get_render_size(options.width, options.height, render_width, render_height);
+        triangle_rasterizer.resize_buffers(render_width, render_height);
+
+        triangle_rasterizer.clear_color_buffer(32, 32, 32);
+        triangle_rasterizer.clear_depth_buffer();
+        render_queue.begin(projection, view);
+        scene.submit(render_queue);
+        render_queue.execute(triangle_rasterizer, draw_function, &light);
+        triangle_rasterizer.flush();
+
+        if (options.is_drawing_overdraw_heatmap) {
+            triangle_rasterizer.draw_overdraw_heatmap();
+        }
+
+        std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+
+        is_counting_allocations = false;
+        if (allocation_count.load() != allocation_count_before_frame) {
+            allocating_frame_count++;
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+        if (options.frame_budget_milliseconds > 0.0f) {
+            dynamic_resolution.add_frame_time(static_cast<float>(milliseconds));
+        }
+
+        int measured_frame = frame - options.warmup_frame_count;
+        if (measured_frame < 0) {
+            continue;
+        }
+
+        frame_milliseconds.push_back(milliseconds);
+        scale_total += static_cast<float>(render_width) / options.width;
+        min_scale = std::min(min_scale, static_cast<float>(render_width) / options.width);
+        visible_object_total += scene.get_visible_object_count();
+        reduced_lod_object_total += scene.get_reduced_lod_object_count();
+
+        if (measured_frame % options.dump_interval != 0) {
+            continue;
+        }
+
+        if (!options.dump_directory.empty()) {
+            std::string path = frame_path(options.dump_directory, measured_frame, options.dump_format);
+            bool was_written = options.dump_format == "png" ? write_png(path, triangle_rasterizer) : write_ppm(path, triangle_rasterizer);
+            has_failed |= !was_written;
+        }
+
+        if (!options.compare_directory.empty()) {
+            std::string path = frame_path(options.compare_directory, measured_frame, "ppm");
+            int differing_pixel_count = count_pixels_differing_from_golden(path, triangle_rasterizer, options.compare_tolerance, max_difference);
+            if (differing_pixel_count != 0) {
+                differing_frame_count++;
+            }
+
+            if (differing_pixel_count > 0) {
+                double differing_percentage = 100.0 * differing_pixel_count / (triangle_rasterizer.get_buffer_width() * triangle_rasterizer.get_buffer_height());
+                std::cerr << "[ERROR] frame " << measured_frame << ": " << differing_pixel_count << " pixels (" << std::fixed << std::setprecision(2) << differing_percentage << "%) "
+                          << "differ from " << path << std::endl;
+            }
+        }
+    }
+
+    report_frame_times(frame_milliseconds);
+    report_pipeline_stats(triangle_rasterizer.get_pipeline_stats(), options.frame_count);
+    std::cout << "visible objects (mean): " << static_cast<double>(visible_object_total) / options.frame_count << ", "
+              << static_cast<double>(reduced_lod_object_total) / options.frame_count << " at reduced detail" << std::endl;
+
+    if (options.frame_budget_milliseconds > 0.0f) {
+        std::cout << "resolution scale: mean " << std::setprecision(3) << scale_total / options.frame_count
+                  << ", min " << min_scale << " for a " << options.frame_budget_milliseconds << " ms budget" << std::endl;
+    }
+
+    const FrameArena& frame_arena = triangle_rasterizer.get_frame_arena();
+    std::cout << "heap allocations: " << allocation_count.load() << " in " << allocating_frame_count << " measured frames, "
+              << "frame arena: " << frame_arena.get_high_water_mark() / 1024 << " KiB high water, "
+              << frame_arena.get_capacity() / 1024 << " KiB capacity" << std::endl;
+
+    if (options.is_checking_allocations && allocating_frame_count > 0) {
+        std::cerr << "[ERROR] " << allocating_frame_count << " measured frames allocated from the heap" << std::endl;
+        has_failed = true;
+    }
+
+    if (!options.compare_directory.empty()) {
+        if (max_difference > 0) {
+            std::cout << "largest color channel difference: " << max_difference << ", tolerance " << options.compare_tolerance << std::endl;
+        }
+
+        if (differing_frame_count == 0) {
+            std::cout << "every compared frame matches " << options.compare_directory << std::endl;
+        } else {
+            std::cout << differing_frame_count << " compared frames do not match " << options.compare_directory << std::endl;
+            has_failed = true;
+        }
+    }
+
+    return has_failed ? 1 : 0;
+}
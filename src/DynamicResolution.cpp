@@ -0,0 +1,121 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const int FRAMES_PER_ADJUSTMENT = 8;
+static const float MIN_SCALE = 0.25f;
+static const float MAX_SCALE = 1.0f;
+
+// A single frame this much over the target lowers the scale right away.
+static const float SPIKE_FACTOR = 1.5f;
+
+// The scale is aimed at a bit under the target, so that ordinary frame to
+// frame noise doesn't keep pushing frames over it.
+static const float TARGET_HEADROOM = 0.85f;
+
+// Raising the scale is done in small steps, and changes too small to make a
+// visible difference aren't made at all, so the resolution doesn't keep
+// going back and forth around the target.
+static const float MAX_SCALE_INCREASE = 1.1f;
+static const float MIN_SCALE_CHANGE = 0.02f;
+
+// --------------------------------------------------------------------------
+
+// The time it takes to render a frame goes roughly with its pixel count,
+// i.e. with the square of the scale.
+static float scale_for_frame_time(float scale, float frame_milliseconds, float target_milliseconds) {
+    if (frame_milliseconds <= 0.0f) {
+        return MAX_SCALE;
+    }
+
+    return scale * std::sqrt(target_milliseconds / frame_milliseconds);
+}
+
+// --------------------------------------------------------------------------
+
+DynamicResolution::DynamicResolution(float target_frame_milliseconds)
+:
+target_frame_milliseconds(target_frame_milliseconds),
+scale(MAX_SCALE),
+frame_milliseconds_sum(0.0f),
+frame_count(0) {
+
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+DynamicResolution::~DynamicResolution() {
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+void DynamicResolution::set_target_frame_time(float target_frame_milliseconds) {
+    this->target_frame_milliseconds = target_frame_milliseconds;
+    frame_milliseconds_sum = 0.0f;
+    frame_count = 0;
+}
+
+// --------------------------------------------------------------------------
+
+float DynamicResolution::get_target_frame_time() const {
+    return target_frame_milliseconds;
+}
+
+// --------------------------------------------------------------------------
+
+void DynamicResolution::add_frame_time(float frame_milliseconds) {
+    float target_milliseconds = target_frame_milliseconds * TARGET_HEADROOM;
+
+    if (frame_milliseconds > target_frame_milliseconds * SPIKE_FACTOR) {
+        float new_scale = scale_for_frame_time(scale, frame_milliseconds, target_milliseconds);
+        scale = std::clamp(new_scale, MIN_SCALE, MAX_SCALE);
+
+        // The frames before the spike were rendered at the old scale, so
+        // they say nothing about the new one.
+        frame_milliseconds_sum = 0.0f;
+        frame_count = 0;
+        return;
+    }
+
+    frame_milliseconds_sum += frame_milliseconds;
+    frame_count++;
+    if (frame_count < FRAMES_PER_ADJUSTMENT) {
+        return;
+    }
+
+    float mean_frame_milliseconds = frame_milliseconds_sum / frame_count;
+    frame_milliseconds_sum = 0.0f;
+    frame_count = 0;
+
+    float new_scale = scale_for_frame_time(scale, mean_frame_milliseconds, target_milliseconds);
+    new_scale = std::min(new_scale, scale * MAX_SCALE_INCREASE);
+    new_scale = std::clamp(new_scale, MIN_SCALE, MAX_SCALE);
+
+    if (std::fabs(new_scale - scale) >= MIN_SCALE_CHANGE || new_scale == MIN_SCALE || new_scale == MAX_SCALE) {
+        scale = new_scale;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+float DynamicResolution::get_scale() const {
+    return scale;
+}
+
+// --------------------------------------------------------------------------
+
+void DynamicResolution::get_render_size(int full_width, int full_height, int& width, int& height) const {
+    width = std::max(1, static_cast<int>(std::lround(full_width * scale)));
+    height = std::max(1, static_cast<int>(std::lround(full_height * scale)));
+}
+
+// --------------------------------------------------------------------------
+
+void DynamicResolution::reset() {
+    scale = MAX_SCALE;
+    frame_milliseconds_sum = 0.0f;
+    frame_count = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <SDL3/SDL.h>
+
+// Picks the fraction of the full resolution to render at, so that frames
+// take about as long as the target frame time. It is fed how long every
+// frame took and only changes the scale every few frames, except after a
+// frame that went well over the target, which lowers it right away: it is
+// better to drop resolution than to drop frames.
+class DynamicResolution {
+
+public:
+
+    DynamicResolution(float target_frame_milliseconds);
+    ~DynamicResolution();
+
+    void set_target_frame_time(float target_frame_milliseconds);
+    float get_target_frame_time() const;
+
+    void add_frame_time(float frame_milliseconds);
+
+    // The fraction of the full width and height to render at, in
+    // (0, 1]. It starts out at 1.
+    float get_scale() const;
+
+    // The full size scaled down, but never below one pixel.
+    void get_render_size(int full_width, int full_height, int& width, int& height) const;
+
+    // Goes back to the full resolution and forgets every frame time.
+    void reset();
+
+private:
+
+    float target_frame_milliseconds;
+    float scale;
+
+    float frame_milliseconds_sum;
+    int frame_count;
+};
+
+#endif
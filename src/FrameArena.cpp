@@ -0,0 +1,97 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+static const size_t MIN_BLOCK_SIZE = 4096;
+
+// --------------------------------------------------------------------------
+
+FrameArena::FrameArena(size_t initial_capacity)
+:
+current_block(0),
+current_offset(0),
+used_bytes(0),
+high_water_mark(0) {
+
+    add_block(std::max(initial_capacity, MIN_BLOCK_SIZE));
+}
+
+// --------------------------------------------------------------------------
+
+FrameArena::~FrameArena() {
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    size_t start = (current_offset + alignment - 1) & ~(alignment - 1);
+
+    if (start + size > blocks[current_block].size) {
+        // The rest of the current block is skipped. It doesn't count as
+        // used, since a single block big enough for everything wouldn't have
+        // had a gap there. Each new block is at least as big as all of the
+        // others together, so a frame never needs more than a few of them.
+        if (current_block + 1 == blocks.size()) {
+            add_block(std::max(size, get_capacity()));
+        }
+
+        current_block++;
+        current_offset = 0;
+        start = 0;
+    }
+
+    used_bytes += start - current_offset + size;
+    current_offset = start + size;
+    high_water_mark = std::max(high_water_mark, used_bytes);
+
+    return blocks[current_block].data.get() + start;
+}
+
+// --------------------------------------------------------------------------
+
+void FrameArena::reset() {
+    if (blocks.size() > 1) {
+        size_t new_capacity = high_water_mark + high_water_mark / 2;
+
+        blocks.clear();
+        add_block(new_capacity);
+    }
+
+    current_block = 0;
+    current_offset = 0;
+    used_bytes = 0;
+}
+
+// --------------------------------------------------------------------------
+
+size_t FrameArena::get_used_bytes() const {
+    return used_bytes;
+}
+
+// --------------------------------------------------------------------------
+
+size_t FrameArena::get_capacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks) {
+        capacity += block.size;
+    }
+
+    return capacity;
+}
+
+// --------------------------------------------------------------------------
+
+size_t FrameArena::get_high_water_mark() const {
+    return high_water_mark;
+}
+
+// --------------------------------------------------------------------------
+
+void FrameArena::add_block(size_t size) {
+    size = std::max(size, MIN_BLOCK_SIZE);
+
+    // Arrays of bytes from new are aligned for any type that fits in them.
+    Block block = { std::unique_ptr<Uint8[]>(new Uint8[size]), size };
+    blocks.push_back(std::move(block));
+}
@@ -0,0 +1,69 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <SDL3/SDL.h>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// A linear allocator for data that only lives until the end of a frame.
+// Allocating just bumps an offset into a block of memory, and reset() frees
+// everything at once by setting it back to zero, so nothing allocated from
+// it ever gets destructed. An arena is not thread safe, so every thread that
+// needs one should have its own.
+//
+// When a frame needs more than the arena holds, what doesn't fit goes into
+// extra blocks from the heap. The next reset() replaces every block with a
+// single one that fits the most any frame has needed with room to spare, so
+// frames only allocate from the heap when they need more than ever before.
+class FrameArena {
+
+public:
+
+    FrameArena(size_t initial_capacity);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // The memory is left uninitialized. The alignment has to be a power of
+    // two no bigger than alignof(std::max_align_t).
+    void* allocate(size_t size, size_t alignment);
+
+    template<typename T>
+    T* allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is freed without running any destructors");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void reset();
+
+    // How many bytes were allocated since the last reset, how many bytes the
+    // arena holds, and the most bytes that were ever allocated between two
+    // resets, which is the capacity the arena would have needed to never
+    // allocate from the heap after it was constructed.
+    size_t get_used_bytes() const;
+    size_t get_capacity() const;
+    size_t get_high_water_mark() const;
+
+private:
+
+    struct Block {
+        std::unique_ptr<Uint8[]> data;
+        size_t size;
+    };
+
+    // The first block is the arena itself, and any others are the overflow
+    // of the frame in progress, each one used up before the next.
+    std::vector<Block> blocks;
+    size_t current_block;
+    size_t current_offset;
+
+    size_t used_bytes;
+    size_t high_water_mark;
+
+    void add_block(size_t size);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+
+// --------------------------------------------------------------------------
+
+FramePipeline::FramePipeline(int frame_count, const std::function<void(RenderedFrame&)>& render_frame)
+:
+frames(new RenderedFrame[std::max(frame_count, 2)]()),
+frame_count(std::max(frame_count, 2)),
+is_stopping(false),
+render_frame(render_frame) {
+
+    free_frames.reserve(this->frame_count);
+    rendered_frames.reserve(this->frame_count);
+    for (int i = 0; i < this->frame_count; i++) {
+        free_frames.push_back(&frames[i]);
+    }
+
+    render_thread = std::thread(&FramePipeline::render_loop, this);
+}
+
+// --------------------------------------------------------------------------
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+// --------------------------------------------------------------------------
+
+int FramePipeline::get_frame_count() const {
+    return frame_count;
+}
+
+// --------------------------------------------------------------------------
+
+RenderedFrame* FramePipeline::acquire_rendered_frame(Uint32 timeout_milliseconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    bool has_rendered_frame = frame_rendered.wait_for(lock, std::chrono::milliseconds(timeout_milliseconds), [this] {
+        return !rendered_frames.empty();
+    });
+
+    if (!has_rendered_frame) {
+        return nullptr;
+    }
+
+    RenderedFrame* frame = rendered_frames.front();
+    rendered_frames.erase(rendered_frames.begin());
+    return frame;
+}
+
+// --------------------------------------------------------------------------
+
+void FramePipeline::release_frame(RenderedFrame* frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_frames.push_back(frame);
+    }
+    frame_released.notify_one();
+}
+
+// --------------------------------------------------------------------------
+
+void FramePipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopping = true;
+    }
+    frame_released.notify_one();
+
+    if (render_thread.joinable()) {
+        render_thread.join();
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void FramePipeline::render_loop() {
+    while (true) {
+        RenderedFrame* frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_released.wait(lock, [this] { return is_stopping || !free_frames.empty(); });
+            if (is_stopping) {
+                return;
+            }
+
+            frame = free_frames.front();
+            free_frames.erase(free_frames.begin());
+        }
+
+        render_frame(*frame);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendered_frames.push_back(frame);
+        }
+        frame_rendered.notify_one();
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <SDL3/SDL.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TriangleRasterizer.h"
+
+// A finished frame, along with what it took to render it.
+struct RenderedFrame {
+    std::vector<Uint32> color_buffer;
+    int width;
+    int height;
+
+    // The size the frame stands in for, which is bigger than the frame
+    // itself when it was rendered at a lower resolution to save time.
+    int full_width;
+    int full_height;
+
+    PipelineStats pipeline_stats;
+};
+
+// Renders frames on a thread of its own, while another thread presents the
+// ones that are done. There is a fixed number of frames to go around, so
+// the render thread can get at most that many frames ahead minus the one
+// being presented, and it waits for a frame to be released when it does.
+// Frames are presented in the order they were rendered in.
+class FramePipeline {
+
+public:
+
+    // Two frames makes for double buffering and three for triple buffering.
+    // render_frame is called on the render thread, over and over, to fill
+    // in the next frame until the pipeline is stopped.
+    FramePipeline(int frame_count, const std::function<void(RenderedFrame&)>& render_frame);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    int get_frame_count() const;
+
+    // Hands out the oldest rendered frame, waiting up to the timeout for one
+    // to be done, so the caller can keep handling events while rendering
+    // falls behind. Returns nullptr if none was done in time. The frame
+    // isn't rendered into again until it is released.
+    RenderedFrame* acquire_rendered_frame(Uint32 timeout_milliseconds);
+    void release_frame(RenderedFrame* frame);
+
+    // Waits for the frame being rendered, if any, to be done and stops the
+    // render thread. Frames that were rendered but never acquired are
+    // dropped. The destructor stops the pipeline too.
+    void stop();
+
+private:
+
+    std::unique_ptr<RenderedFrame[]> frames;
+    int frame_count;
+
+    // Both queues have room for every frame, so adding to them never
+    // allocates.
+    std::vector<RenderedFrame*> free_frames;
+    std::vector<RenderedFrame*> rendered_frames;
+
+    std::mutex mutex;
+    std::condition_variable frame_released;
+    std::condition_variable frame_rendered;
+    bool is_stopping;
+
+    std::function<void(RenderedFrame&)> render_frame;
+    std::thread render_thread;
+
+    void render_loop();
+};
+
+#endif
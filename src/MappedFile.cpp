@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------------------------------------------
+
+MappedFile::MappedFile(const std::string& path)
+:
+data(nullptr),
+size(0) {
+
+#if !defined(_WIN32)
+    int file_descriptor = open(path.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        std::cerr << "[ERROR] could not open " << path << std::endl;
+        return;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || file_status.st_size <= 0) {
+        std::cerr << "[ERROR] could not map " << path << ": it is empty or unreadable" << std::endl;
+        close(file_descriptor);
+        return;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<size_t>(file_status.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+    // The mapping stays valid after the file is closed.
+    close(file_descriptor);
+
+    if (mapping == MAP_FAILED) {
+        std::cerr << "[ERROR] could not map " << path << std::endl;
+        return;
+    }
+
+    data = static_cast<const Uint8*>(mapping);
+    size = static_cast<size_t>(file_status.st_size);
+#else
+    data = static_cast<const Uint8*>(SDL_LoadFile(path.c_str(), &size));
+    if (data == nullptr) {
+        std::cerr << "[ERROR] could not read " << path << ": " << SDL_GetError() << std::endl;
+        size = 0;
+    }
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+MappedFile::~MappedFile() {
+    if (data == nullptr) {
+        return;
+    }
+
+#if !defined(_WIN32)
+    munmap(const_cast<Uint8*>(data), size);
+#else
+    SDL_free(const_cast<Uint8*>(data));
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+bool MappedFile::is_open() const {
+    return data != nullptr;
+}
+
+// --------------------------------------------------------------------------
+
+const Uint8* MappedFile::get_data() const {
+    return data;
+}
+
+// --------------------------------------------------------------------------
+
+size_t MappedFile::get_size() const {
+    return size;
+}
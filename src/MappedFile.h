@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <SDL3/SDL.h>
+#include <string>
+
+// A whole file mapped read-only into memory, so its contents are only read
+// from disk as they are touched. Where memory mapping isn't available, the
+// file is read into memory up front instead.
+class MappedFile {
+
+public:
+
+    // Check is_open() to see whether it worked.
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const;
+
+    // The start of the file is aligned to at least 16 bytes.
+    const Uint8* get_data() const;
+    size_t get_size() const;
+
+private:
+
+    const Uint8* data;
+    size_t size;
+};
+
+#endif
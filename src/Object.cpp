@@ -1,15 +1,37 @@
 #include "Object.h"
 
+#include "clipping.h"
+
 // --------------------------------------------------------------------------
 
-// Linearly remap an input x in [a, b] to [u, v].
-float linear_remap(float x, float a, float b, float u, float v) {
-    return (v - u) / (b - a) * (x - a) + u;
+// The y axis points down on screen, so triangles that are counter-clockwise
+// in normalized device coordinates are clockwise here.
+static bool is_back_facing(const Triangle& triangle) {
+    const glm::vec2& p0 = triangle.v0.screen_coord;
+    const glm::vec2& p1 = triangle.v1.screen_coord;
+    const glm::vec2& p2 = triangle.v2.screen_coord;
+    float winding = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+
+    return winding > 0;
+}
+
+// --------------------------------------------------------------------------
+
+Object::Object()
+:
+external_arrays() {
+
+    // nothing to do for now
 }
 
 // --------------------------------------------------------------------------
 
-Object::Object() {
+Object::Object(const MeshArrays& arrays, const bounding_volumes::BoundingBox& bounds, std::shared_ptr<const void> storage)
+:
+bounds(bounds),
+external_storage(std::move(storage)),
+external_arrays(arrays) {
+
     // nothing to do for now
 }
 
@@ -21,53 +43,321 @@ Object::~Object() {
 
 // --------------------------------------------------------------------------
 
-void Object::add_triangle(WorldTriangle& triangle) {
-    triangles.push_back(triangle);
+Uint32 Object::add_vertex(const WorldVertex& vertex) {
+    copy_external_arrays();
+
+    positions_x.push_back(vertex.position.x);
+    positions_y.push_back(vertex.position.y);
+    positions_z.push_back(vertex.position.z);
+    colors.push_back(vertex.color);
+    tex_coords.push_back(vertex.tex_coord);
+    normals.push_back(glm::vec3(0.0f));
+    tangents.push_back(glm::vec3(0.0f));
+    bounding_volumes::grow_to_include(bounds, vertex.position);
+
+    return static_cast<Uint32>(positions_x.size() - 1);
+}
+
+// --------------------------------------------------------------------------
+
+void Object::add_triangle(Uint32 index0, Uint32 index1, Uint32 index2) {
+    copy_external_arrays();
+
+    indices.push_back(index0);
+    indices.push_back(index1);
+    indices.push_back(index2);
+
+    add_triangle_normal_and_tangent(get_arrays(), index0, index1, index2);
+}
+
+// --------------------------------------------------------------------------
+
+void Object::reserve(int vertex_count, int triangle_count) {
+    copy_external_arrays();
+
+    positions_x.reserve(vertex_count);
+    positions_y.reserve(vertex_count);
+    positions_z.reserve(vertex_count);
+    colors.reserve(vertex_count);
+    tex_coords.reserve(vertex_count);
+    normals.reserve(vertex_count);
+    tangents.reserve(vertex_count);
+    indices.reserve(3 * static_cast<size_t>(triangle_count));
+}
+
+// --------------------------------------------------------------------------
+
+int Object::get_vertex_count() const {
+    return get_arrays().vertex_count;
+}
+
+// --------------------------------------------------------------------------
+
+int Object::get_triangle_count() const {
+    return get_arrays().index_count / 3;
+}
+
+// --------------------------------------------------------------------------
+
+const bounding_volumes::BoundingBox& Object::get_bounds() const {
+    return bounds;
+}
+
+// --------------------------------------------------------------------------
+
+MeshArrays Object::get_arrays() const {
+    if (external_storage != nullptr) {
+        return external_arrays;
+    }
+
+    return {
+        positions_x.data(),
+        positions_y.data(),
+        positions_z.data(),
+        colors.data(),
+        tex_coords.data(),
+        normals.data(),
+        tangents.data(),
+        indices.data(),
+        static_cast<int>(positions_x.size()),
+        static_cast<int>(indices.size()),
+    };
+}
+
+// --------------------------------------------------------------------------
+
+void Object::copy_external_arrays() {
+    if (external_storage == nullptr) {
+        return;
+    }
+
+    const MeshArrays& arrays = external_arrays;
+    positions_x.assign(arrays.positions_x, arrays.positions_x + arrays.vertex_count);
+    positions_y.assign(arrays.positions_y, arrays.positions_y + arrays.vertex_count);
+    positions_z.assign(arrays.positions_z, arrays.positions_z + arrays.vertex_count);
+    colors.assign(arrays.colors, arrays.colors + arrays.vertex_count);
+    tex_coords.assign(arrays.tex_coords, arrays.tex_coords + arrays.vertex_count);
+    normals.assign(arrays.normals, arrays.normals + arrays.vertex_count);
+    tangents.assign(arrays.tangents, arrays.tangents + arrays.vertex_count);
+    indices.assign(arrays.indices, arrays.indices + arrays.index_count);
+
+    external_storage = nullptr;
+    external_arrays = MeshArrays();
+}
+
+// --------------------------------------------------------------------------
+
+void Object::add_triangle_normal_and_tangent(const MeshArrays& arrays, Uint32 index0, Uint32 index1, Uint32 index2) {
+    glm::vec3 p0 = glm::vec3(arrays.positions_x[index0], arrays.positions_y[index0], arrays.positions_z[index0]);
+    glm::vec3 p1 = glm::vec3(arrays.positions_x[index1], arrays.positions_y[index1], arrays.positions_z[index1]);
+    glm::vec3 p2 = glm::vec3(arrays.positions_x[index2], arrays.positions_y[index2], arrays.positions_z[index2]);
+
+    // Front faces are counter-clockwise, so this points out of them.
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    normals[index0] += normal;
+    normals[index1] += normal;
+    normals[index2] += normal;
+
+    // This is the tangent from solving p - p0 = tangent * (u - u0) +
+    // bitangent * (v - v0), times the determinant of the texture coordinate
+    // edges, which is twice the triangle's area in the texture. Mirrored
+    // texture mappings have a negative determinant, so their tangents are
+    // flipped back to point the way u grows.
+    glm::vec2 tex_coord_edge1 = arrays.tex_coords[index1] - arrays.tex_coords[index0];
+    glm::vec2 tex_coord_edge2 = arrays.tex_coords[index2] - arrays.tex_coords[index0];
+    float determinant = tex_coord_edge1.x * tex_coord_edge2.y - tex_coord_edge2.x * tex_coord_edge1.y;
+
+    glm::vec3 tangent = (p1 - p0) * tex_coord_edge2.y - (p2 - p0) * tex_coord_edge1.y;
+    if (determinant < 0.0f) {
+        tangent = -tangent;
+    }
+    tangents[index0] += tangent;
+    tangents[index1] += tangent;
+    tangents[index2] += tangent;
 }
 
 // --------------------------------------------------------------------------
 
 void Object::rasterize(TriangleRasterizer& triangle_rasterizer,
-                       SDL_Renderer* renderer,
-                       SDL_Surface* texture_surface,
-                       glm::mat4& projection,
-                       glm::mat4& view,
-                       glm::mat4& model) {
-
-    int render_width, render_height;
-    SDL_GetCurrentRenderOutputSize(renderer, &render_width, &render_height);
-
-    for (WorldTriangle world_triangle : triangles) {
-        glm::mat4 mv_matrix = view * model;
-        glm::vec4 p0_view = mv_matrix * glm::vec4(world_triangle.p0.position, 1.0f);
-        glm::vec4 p1_view = mv_matrix * glm::vec4(world_triangle.p1.position, 1.0f);
-        glm::vec4 p2_view = mv_matrix * glm::vec4(world_triangle.p2.position, 1.0f);
-
-        glm::vec4 p0 = projection * p0_view;
-        glm::vec4 p1 = projection * p1_view;
-        glm::vec4 p2 = projection * p2_view;
-
-        p0 /= p0.w;
-        p1 /= p1.w;
-        p2 /= p2.w;
-
-        // Back face culling
-        float winding = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
-        if (winding < 0) {
+                       const texture::Texture* texture,
+                       const glm::mat4& projection,
+                       const glm::mat4& view,
+                       const glm::mat4& model) const {
+
+    rasterize_triangles(triangle_rasterizer, texture, nullptr, projection, view, model);
+}
+
+// --------------------------------------------------------------------------
+
+void Object::rasterize(TriangleRasterizer& triangle_rasterizer,
+                       const ShaderDraw& shader_draw,
+                       const glm::mat4& projection,
+                       const glm::mat4& view,
+                       const glm::mat4& model) const {
+
+    rasterize_triangles(triangle_rasterizer, nullptr, &shader_draw, projection, view, model);
+}
+
+// --------------------------------------------------------------------------
+
+void Object::rasterize_triangles(TriangleRasterizer& triangle_rasterizer,
+                                 const texture::Texture* texture,
+                                 const ShaderDraw* shader_draw,
+                                 const glm::mat4& projection,
+                                 const glm::mat4& view,
+                                 const glm::mat4& model) const {
+
+    // Every vertex is transformed exactly once per draw, and the triangles
+    // then pick their transformed vertices out of the results by index.
+    glm::mat4 mv_matrix = view * model;
+    glm::mat4 mvp_matrix = projection * mv_matrix;
+
+    triangle_rasterizer.set_depth_projection(projection);
+
+    vertex_stage::Viewport viewport = vertex_stage::make_viewport(triangle_rasterizer.get_buffer_width(),
+                                                                  triangle_rasterizer.get_buffer_height());
+
+    MeshArrays arrays = get_arrays();
+
+    vertex_stage::PositionStreams positions = { arrays.positions_x, arrays.positions_y, arrays.positions_z, arrays.vertex_count };
+    vertex_stage::TransformedVertices& transformed_vertices = triangle_rasterizer.get_transformed_vertices();
+    vertex_stage::transform_positions(positions, mvp_matrix, mv_matrix, viewport, transformed_vertices);
+
+    const Uint8* clip_flags = transformed_vertices.clip_flags.data();
+
+    PipelineStats& pipeline_stats = triangle_rasterizer.get_pipeline_stats();
+    pipeline_stats.submitted_triangles += arrays.index_count / 3;
+
+    for (int i = 0; i + 2 < arrays.index_count; i += 3) {
+        Uint32 index0 = arrays.indices[i];
+        Uint32 index1 = arrays.indices[i + 1];
+        Uint32 index2 = arrays.indices[i + 2];
+
+        // A triangle whose vertices are all outside the same side of the view
+        // frustum can't be seen at all.
+        if ((clip_flags[index0] & clip_flags[index1] & clip_flags[index2] & vertex_stage::CLIP_FRUSTUM) != 0) {
+            pipeline_stats.frustum_culled_triangles++;
             continue;
         }
 
-        glm::vec2 screen_p0 = glm::vec2(linear_remap(p0.x, -1.0f, 1.0f, 0, render_width - 1.0f), linear_remap(p0.y, -1.0f, 1.0f, render_height - 1.0f, 0.0f));
-        glm::vec2 screen_p1 = glm::vec2(linear_remap(p1.x, -1.0f, 1.0f, 0, render_width - 1.0f), linear_remap(p1.y, -1.0f, 1.0f, render_height - 1.0f, 0.0f));
-        glm::vec2 screen_p2 = glm::vec2(linear_remap(p2.x, -1.0f, 1.0f, 0, render_width - 1.0f), linear_remap(p2.y, -1.0f, 1.0f, render_height - 1.0f, 0.0f));
-
+        // Triangles that only stick out of the sides of the viewport are
+        // trimmed by the rasterizer, so clipping is only needed for the ones
+        // that cross the near or far plane or reach past the guard band.
+        Uint8 combined_clip_flags = clip_flags[index0] | clip_flags[index1] | clip_flags[index2];
+        if ((combined_clip_flags & (vertex_stage::CLIP_NEAR | vertex_stage::CLIP_FAR | vertex_stage::CLIP_GUARD_BAND)) != 0) {
+            pipeline_stats.clipped_triangles++;
+            rasterize_clipped_triangle(triangle_rasterizer,
+                                       texture,
+                                       shader_draw,
+                                       arrays,
+                                       transformed_vertices,
+                                       viewport,
+                                       index0,
+                                       index1,
+                                       index2,
+                                       combined_clip_flags);
+            continue;
+        }
 
         Triangle triangle = {
-            { screen_p0, world_triangle.p0.color, world_triangle.p0.tex_coord, p0.z, p0_view.z },
-            { screen_p1, world_triangle.p1.color, world_triangle.p1.tex_coord, p1.z, p1_view.z },
-            { screen_p2, world_triangle.p2.color, world_triangle.p2.tex_coord, p2.z, p2_view.z },
+            assemble_vertex(arrays, transformed_vertices, index0),
+            assemble_vertex(arrays, transformed_vertices, index1),
+            assemble_vertex(arrays, transformed_vertices, index2),
         };
 
-        triangle_rasterizer.rasterize(renderer, triangle, texture_surface);
+        if (is_back_facing(triangle)) {
+            pipeline_stats.back_face_culled_triangles++;
+            continue;
+        }
+
+        if (shader_draw != nullptr) {
+            const float* varyings = transformed_vertices.varyings.data();
+            int varying_count = shader_draw->varying_count;
+            const float* triangle_varyings[3] = {
+                varyings + index0 * varying_count,
+                varyings + index1 * varying_count,
+                varyings + index2 * varying_count,
+            };
+
+            triangle_rasterizer.rasterize(triangle, triangle_varyings, *shader_draw);
+        } else {
+            triangle_rasterizer.rasterize(triangle, texture);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void Object::rasterize_clipped_triangle(TriangleRasterizer& triangle_rasterizer,
+                                        const texture::Texture* texture,
+                                        const ShaderDraw* shader_draw,
+                                        const MeshArrays& arrays,
+                                        const vertex_stage::TransformedVertices& transformed_vertices,
+                                        const vertex_stage::Viewport& viewport,
+                                        Uint32 index0,
+                                        Uint32 index1,
+                                        Uint32 index2,
+                                        Uint8 clip_flags) const {
+
+    clipping::ClipVertex triangle[3];
+    Uint32 triangle_indices[3] = { index0, index1, index2 };
+    for (int i = 0; i < 3; i++) {
+        Uint32 index = triangle_indices[i];
+        triangle[i].clip_position = glm::vec4(transformed_vertices.clip_x[index],
+                                              transformed_vertices.clip_y[index],
+                                              transformed_vertices.clip_z[index],
+                                              transformed_vertices.clip_w[index]);
+        triangle[i].vertex = assemble_vertex(arrays, transformed_vertices, index);
+        triangle[i].weights = glm::vec3(0.0f);
+        triangle[i].weights[i] = 1.0f;
+    }
+
+    clipping::ClipVertex polygon[clipping::MAX_POLYGON_VERTICES];
+    int vertex_count = clipping::clip_triangle(triangle, clip_flags, viewport, polygon);
+
+    // Varyings are linear in clip space, just like the vertex colors, so the
+    // clipped vertices' varyings are the same blend of the original ones.
+    float polygon_varyings[clipping::MAX_POLYGON_VERTICES][raster_kernels::MAX_VARYING_COUNT];
+    if (shader_draw != nullptr) {
+        int varying_count = shader_draw->varying_count;
+        const float* varyings[3];
+        for (int i = 0; i < 3; i++) {
+            varyings[i] = transformed_vertices.varyings.data() + triangle_indices[i] * varying_count;
+        }
+
+        for (int i = 0; i < vertex_count; i++) {
+            const glm::vec3& weights = polygon[i].weights;
+            for (int j = 0; j < varying_count; j++) {
+                polygon_varyings[i][j] = weights[0] * varyings[0][j] + weights[1] * varyings[1][j] + weights[2] * varyings[2][j];
+            }
+        }
     }
+
+    // The clipped polygon is convex, so it can be drawn as a fan.
+    for (int i = 1; i + 1 < vertex_count; i++) {
+        Triangle fan_triangle = { polygon[0].vertex, polygon[i].vertex, polygon[i + 1].vertex };
+        if (is_back_facing(fan_triangle)) {
+            triangle_rasterizer.get_pipeline_stats().back_face_culled_triangles++;
+            continue;
+        }
+
+        if (shader_draw != nullptr) {
+            const float* fan_varyings[3] = { polygon_varyings[0], polygon_varyings[i], polygon_varyings[i + 1] };
+            triangle_rasterizer.rasterize(fan_triangle, fan_varyings, *shader_draw);
+        } else {
+            triangle_rasterizer.rasterize(fan_triangle, texture);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+Vertex Object::assemble_vertex(const MeshArrays& arrays, const vertex_stage::TransformedVertices& transformed_vertices, Uint32 index) const {
+    return {
+        glm::vec2(transformed_vertices.screen_x[index], transformed_vertices.screen_y[index]),
+        arrays.colors[index],
+        arrays.tex_coords[index],
+        transformed_vertices.ndc_z[index],
+        transformed_vertices.view_z[index],
+    };
 }
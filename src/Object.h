@@ -2,10 +2,14 @@
 #define OBJECT_H
 
 #include <SDL3/SDL.h>
+#include <memory>
 #include <vector>
 #include <glm/glm.hpp>
 
 #include "TriangleRasterizer.h"
+#include "bounding_volumes.h"
+#include "texture.h"
+#include "vertex_stage.h"
 
 struct WorldVertex {
     glm::vec3 position;
@@ -13,10 +17,24 @@ struct WorldVertex {
     glm::vec2 tex_coord;
 };
 
-struct WorldTriangle {
-    WorldVertex p0;
-    WorldVertex p1;
-    WorldVertex p2;
+// Where an object's vertices and triangle indices are, three indices per
+// triangle. The normals aren't normalized: each one is the sum of the
+// normals of the triangles around its vertex, each as long as twice the
+// triangle's area, so bigger triangles count for more. The tangents point
+// the way the u texture coordinate grows along the surface, for normal
+// maps, and are summed up the same way, each triangle's weighted by how much
+// of the texture it covers.
+struct MeshArrays {
+    const float* positions_x;
+    const float* positions_y;
+    const float* positions_z;
+    const glm::vec3* colors;
+    const glm::vec2* tex_coords;
+    const glm::vec3* normals;
+    const glm::vec3* tangents;
+    const Uint32* indices;
+    int vertex_count;
+    int index_count;
 };
 
 class Object {
@@ -26,17 +44,95 @@ public:
     Object();
     ~Object();
 
-    void add_triangle(WorldTriangle& triangle);
+    // Meshes can be big, so they are moved around rather than copied
+    // whenever possible.
+    Object(const Object& other) = default;
+    Object(Object&& other) = default;
+    Object& operator=(const Object& other) = default;
+    Object& operator=(Object&& other) = default;
+
+    // Uses arrays that live somewhere else, like in a memory-mapped mesh
+    // file, without copying them. The storage keeps them alive for as long
+    // as the object needs them, and every index must refer to a vertex.
+    Object(const MeshArrays& arrays, const bounding_volumes::BoundingBox& bounds, std::shared_ptr<const void> storage);
+
+    // Vertices are shared between triangles, which refer to them by the
+    // index that add_vertex() returns. Adding to an object that uses
+    // someone else's arrays copies them first.
+    Uint32 add_vertex(const WorldVertex& vertex);
+    void add_triangle(Uint32 index0, Uint32 index1, Uint32 index2);
+
+    // Makes room up front, for when the final size is known.
+    void reserve(int vertex_count, int triangle_count);
+
+    int get_vertex_count() const;
+    int get_triangle_count() const;
+
+    // The box around every vertex, in object space.
+    const bounding_volumes::BoundingBox& get_bounds() const;
+
+    // Only valid until the object is changed.
+    MeshArrays get_arrays() const;
+
+    void rasterize(TriangleRasterizer& triangle_rasterizer,
+                   const texture::Texture* texture,
+                   const glm::mat4& projection,
+                   const glm::mat4& view,
+                   const glm::mat4& model) const;
+
+    // Draws with a fragment shader, from the varyings that the draw's vertex
+    // shader already left in the rasterizer's transformed vertices.
+    // shader_pipeline::draw() does both.
     void rasterize(TriangleRasterizer& triangle_rasterizer,
-                   SDL_Renderer* renderer,
-                   SDL_Surface* texture_surface,
-                   glm::mat4& projection,
-                   glm::mat4& view,
-                   glm::mat4& model);
+                   const ShaderDraw& shader_draw,
+                   const glm::mat4& projection,
+                   const glm::mat4& view,
+                   const glm::mat4& model) const;
 
 private:
 
-    std::vector<WorldTriangle> triangles;
+    // Positions are stored one component per array for the vertex stage,
+    // while the other attributes are only looked up per triangle.
+    std::vector<float> positions_x;
+    std::vector<float> positions_y;
+    std::vector<float> positions_z;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> tangents;
+
+    std::vector<Uint32> indices;
+
+    bounding_volumes::BoundingBox bounds;
+
+    // Set when the object uses someone else's arrays instead of the ones
+    // above, which are then empty.
+    std::shared_ptr<const void> external_storage;
+    MeshArrays external_arrays;
+
+    void copy_external_arrays();
+
+    void add_triangle_normal_and_tangent(const MeshArrays& arrays, Uint32 index0, Uint32 index1, Uint32 index2);
+
+    // The shader draw is null for draws without a fragment shader.
+    void rasterize_triangles(TriangleRasterizer& triangle_rasterizer,
+                             const texture::Texture* texture,
+                             const ShaderDraw* shader_draw,
+                             const glm::mat4& projection,
+                             const glm::mat4& view,
+                             const glm::mat4& model) const;
+
+    Vertex assemble_vertex(const MeshArrays& arrays, const vertex_stage::TransformedVertices& transformed_vertices, Uint32 index) const;
+    void rasterize_clipped_triangle(TriangleRasterizer& triangle_rasterizer,
+                                    const texture::Texture* texture,
+                                    const ShaderDraw* shader_draw,
+                                    const MeshArrays& arrays,
+                                    const vertex_stage::TransformedVertices& transformed_vertices,
+                                    const vertex_stage::Viewport& viewport,
+                                    Uint32 index0,
+                                    Uint32 index1,
+                                    Uint32 index2,
+                                    Uint8 clip_flags) const;
 };
 
 #endif
@@ -0,0 +1,182 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+// The sort key, from its most to its least significant bits: the depth band,
+// the sampler state and the texture id. Depth bands are the top bits of the
+// depth as a float, i.e. its exponent and the first few bits of its
+// mantissa, which splits every doubling of the distance into the same
+// number of bands. Draws only get grouped by state within a band.
+static const int DEPTH_BAND_MANTISSA_BITS = 4;
+static const int DEPTH_BAND_BITS = 8 + DEPTH_BAND_MANTISSA_BITS;
+static const int SAMPLER_STATE_BITS = 3;
+static const int TEXTURE_ID_BITS = 16;
+
+static const int TEXTURE_ID_SHIFT = 0;
+static const int SAMPLER_STATE_SHIFT = TEXTURE_ID_SHIFT + TEXTURE_ID_BITS;
+static const int DEPTH_BAND_SHIFT = SAMPLER_STATE_SHIFT + SAMPLER_STATE_BITS;
+
+static const Uint32 MAX_TEXTURE_ID = (1 << TEXTURE_ID_BITS) - 1;
+
+static_assert(DEPTH_BAND_SHIFT + DEPTH_BAND_BITS <= 64, "the sort key doesn't fit in 64 bits");
+
+// --------------------------------------------------------------------------
+
+static Uint64 depth_band(float view_depth) {
+    // Positive floats sort the same way as their bits do. Anything behind
+    // the camera, and NaNs, go in the nearest band.
+    float depth = view_depth > 0.0f ? view_depth : 0.0f;
+
+    Uint32 depth_bits;
+    std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+    return depth_bits >> (23 - DEPTH_BAND_MANTISSA_BITS);
+}
+
+// --------------------------------------------------------------------------
+
+// The texture's own id, wrapped around to fit in the sort key, which only
+// makes draws of every 65535th texture share a group. Zero is for
+// untextured draws.
+static Uint64 texture_sort_id(const texture::Texture* texture) {
+    if (texture == nullptr) {
+        return 0;
+    }
+
+    return (texture->get_id() - 1) % MAX_TEXTURE_ID + 1;
+}
+
+// --------------------------------------------------------------------------
+
+static bool is_same_sampler_state(const texture::SamplerState& a, const texture::SamplerState& b) {
+    return a.filter == b.filter && a.wrap == b.wrap;
+}
+
+// --------------------------------------------------------------------------
+
+RenderQueue::RenderQueue()
+:
+projection(1.0f),
+view(1.0f),
+is_sorting(true),
+sampler_change_count(0) {
+
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+RenderQueue::~RenderQueue() {
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+void RenderQueue::begin(const glm::mat4& projection, const glm::mat4& view) {
+    this->projection = projection;
+    this->view = view;
+
+    commands.clear();
+}
+
+// --------------------------------------------------------------------------
+
+const glm::mat4& RenderQueue::get_projection() const {
+    return projection;
+}
+
+// --------------------------------------------------------------------------
+
+const glm::mat4& RenderQueue::get_view() const {
+    return view;
+}
+
+// --------------------------------------------------------------------------
+
+void RenderQueue::submit(const Object& object,
+                         const glm::mat4& model,
+                         const texture::Texture* texture,
+                         const texture::SamplerState& sampler_state) {
+
+    const bounding_volumes::BoundingBox& bounds = object.get_bounds();
+    glm::vec3 center = bounding_volumes::is_empty(bounds) ? glm::vec3(0.0f) : (bounds.min + bounds.max) * 0.5f;
+    glm::vec4 view_center = view * model * glm::vec4(center, 1.0f);
+
+    // The camera looks down the negative z axis.
+    DrawCommand command = { &object, model, texture, sampler_state, -view_center.z };
+    commands.push_back(command);
+}
+
+// --------------------------------------------------------------------------
+
+int RenderQueue::get_command_count() const {
+    return static_cast<int>(commands.size());
+}
+
+// --------------------------------------------------------------------------
+
+void RenderQueue::set_sorting(bool is_sorting) {
+    this->is_sorting = is_sorting;
+}
+
+// --------------------------------------------------------------------------
+
+bool RenderQueue::get_sorting() const {
+    return is_sorting;
+}
+
+// --------------------------------------------------------------------------
+
+void RenderQueue::execute(TriangleRasterizer& triangle_rasterizer) {
+    execute(triangle_rasterizer, nullptr, nullptr);
+}
+
+// --------------------------------------------------------------------------
+
+void RenderQueue::execute(TriangleRasterizer& triangle_rasterizer, DrawFunction draw, const void* context) {
+    sort_entries.clear();
+    for (size_t i = 0; i < commands.size(); i++) {
+        SortEntry sort_entry = { is_sorting ? make_sort_key(commands[i]) : 0, static_cast<Uint32>(i) };
+        sort_entries.push_back(sort_entry);
+    }
+
+    if (is_sorting) {
+        std::sort(sort_entries.begin(), sort_entries.end(), [](const SortEntry& a, const SortEntry& b) {
+            return a.key != b.key ? a.key < b.key : a.command_index < b.command_index;
+        });
+    }
+
+    sampler_change_count = 0;
+    for (size_t i = 0; i < sort_entries.size(); i++) {
+        const DrawCommand& command = commands[sort_entries[i].command_index];
+
+        if (i == 0 || !is_same_sampler_state(command.sampler_state, commands[sort_entries[i - 1].command_index].sampler_state)) {
+            triangle_rasterizer.set_texture_filter(command.sampler_state.filter);
+            triangle_rasterizer.set_texture_wrap(command.sampler_state.wrap);
+            sampler_change_count++;
+        }
+
+        if (draw != nullptr) {
+            draw(triangle_rasterizer, *command.object, command.texture, projection, view, command.model, context);
+        } else {
+            command.object->rasterize(triangle_rasterizer, command.texture, projection, view, command.model);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+int RenderQueue::get_sampler_change_count() const {
+    return sampler_change_count;
+}
+
+// --------------------------------------------------------------------------
+
+Uint64 RenderQueue::make_sort_key(const DrawCommand& command) const {
+    Uint64 sampler_state = (static_cast<Uint64>(command.sampler_state.filter) << 1) | static_cast<Uint64>(command.sampler_state.wrap);
+
+    return (depth_band(command.view_depth) << DEPTH_BAND_SHIFT)
+         | (sampler_state << SAMPLER_STATE_SHIFT)
+         | (texture_sort_id(command.texture) << TEXTURE_ID_SHIFT);
+}
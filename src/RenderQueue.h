@@ -0,0 +1,99 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Object.h"
+#include "TriangleRasterizer.h"
+#include "texture.h"
+
+// A list of draws for one frame. Recording the draws and executing them are
+// separate steps, and execute() reorders the draws before rasterizing them:
+// nearest first, so that more of what is behind gets rejected by the depth
+// test, and draws at about the same depth grouped by sampler state and
+// texture, so the rasterizer's state changes as rarely as possible.
+//
+// The queue only keeps pointers to the objects and textures, so they must
+// outlive it and stay unchanged until it is executed. Other than that, one
+// queue can be recorded while another one is being executed.
+class RenderQueue {
+
+public:
+
+    RenderQueue();
+    ~RenderQueue();
+
+    // Starts recording a new frame seen through the given camera, and
+    // forgets every draw of the previous one.
+    void begin(const glm::mat4& projection, const glm::mat4& view);
+
+    const glm::mat4& get_projection() const;
+    const glm::mat4& get_view() const;
+
+    void submit(const Object& object,
+                const glm::mat4& model,
+                const texture::Texture* texture,
+                const texture::SamplerState& sampler_state);
+
+    int get_command_count() const;
+
+    // With sorting off, the draws are executed in the order they were
+    // submitted in. It is on by default.
+    void set_sorting(bool is_sorting);
+    bool get_sorting() const;
+
+    // Rasterizes every draw, leaving the rasterizer with the sampler state
+    // of the last one. Nothing is flushed.
+    void execute(TriangleRasterizer& triangle_rasterizer);
+
+    // Draws an object some other way than Object::rasterize() does, like
+    // with shaders. The context is whatever execute() was handed along
+    // with the function.
+    typedef void (*DrawFunction)(TriangleRasterizer& triangle_rasterizer,
+                                 const Object& object,
+                                 const texture::Texture* texture,
+                                 const glm::mat4& projection,
+                                 const glm::mat4& view,
+                                 const glm::mat4& model,
+                                 const void* context);
+
+    // Like above, but every draw goes through the draw function instead.
+    void execute(TriangleRasterizer& triangle_rasterizer, DrawFunction draw, const void* context);
+
+    // How many times the last execute() had to change the sampler state.
+    int get_sampler_change_count() const;
+
+private:
+
+    struct DrawCommand {
+        const Object* object;
+        glm::mat4 model;
+        const texture::Texture* texture;
+        texture::SamplerState sampler_state;
+
+        // How far in front of the camera the center of the object is.
+        float view_depth;
+    };
+
+    // Sorting by the key and then by submission order keeps draws with the
+    // same key in the order they were submitted in.
+    struct SortEntry {
+        Uint64 key;
+        Uint32 command_index;
+    };
+
+    glm::mat4 projection;
+    glm::mat4 view;
+
+    std::vector<DrawCommand> commands;
+    std::vector<SortEntry> sort_entries;
+
+    bool is_sorting;
+    int sampler_change_count;
+
+    Uint64 make_sort_key(const DrawCommand& command) const;
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+// --------------------------------------------------------------------------
+
+Scene::Scene()
+:
+is_bvh_stale(false),
+are_bounds_stale(false),
+max_lod_pixel_error(0.0f),
+lod_viewport_height(0),
+reduced_lod_object_count(0) {
+
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+Scene::~Scene() {
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+int Scene::add_object(Object object, const texture::Texture* texture, const glm::mat4& model) {
+    texture::SamplerState sampler_state = { texture::TextureFilter::NEAREST, texture::TextureWrap::CLAMP };
+    SceneObject scene_object = { std::move(object), texture, sampler_state, model, bounding_volumes::BoundingBox(), nullptr };
+    objects.push_back(std::move(scene_object));
+
+    is_bvh_stale = true;
+    are_bounds_stale = true;
+
+    return static_cast<int>(objects.size() - 1);
+}
+
+// --------------------------------------------------------------------------
+
+int Scene::get_object_count() const {
+    return static_cast<int>(objects.size());
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::set_model(int object_id, const glm::mat4& model) {
+    objects[object_id].model = model;
+    are_bounds_stale = true;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::set_texture(int object_id, const texture::Texture* texture) {
+    objects[object_id].texture = texture;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::set_sampler_state(int object_id, const texture::SamplerState& sampler_state) {
+    objects[object_id].sampler_state = sampler_state;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::set_lods(int object_id, std::shared_ptr<const std::vector<mesh_simplification::LevelOfDetail>> lods) {
+    objects[object_id].lods = std::move(lods);
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::set_lod_selection(float max_pixel_error, int viewport_height) {
+    max_lod_pixel_error = max_pixel_error;
+    lod_viewport_height = viewport_height;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::submit(RenderQueue& render_queue) {
+    if (is_bvh_stale) {
+        build_bvh();
+    } else if (are_bounds_stale) {
+        refit_bvh();
+    }
+
+    visible_object_ids.clear();
+    reduced_lod_object_count = 0;
+    if (bvh_nodes.empty()) {
+        return;
+    }
+
+    bounding_volumes::Frustum frustum = bounding_volumes::extract_frustum(render_queue.get_projection() * render_queue.get_view());
+
+    // Each node is visited along with the frustum planes that its parent
+    // wasn't already entirely inside of.
+    int node_stack[MAX_BVH_DEPTH];
+    int plane_mask_stack[MAX_BVH_DEPTH];
+    int stack_size = 0;
+
+    node_stack[stack_size] = 0;
+    plane_mask_stack[stack_size] = bounding_volumes::ALL_FRUSTUM_PLANES;
+    stack_size++;
+
+    while (stack_size > 0) {
+        stack_size--;
+        const BvhNode& node = bvh_nodes[node_stack[stack_size]];
+        int plane_mask = plane_mask_stack[stack_size];
+
+        if (!bounding_volumes::intersects_frustum(frustum, node.bounds, plane_mask)) {
+            continue;
+        }
+
+        if (node.object_count == 0) {
+            for (int i = 0; i < 2; i++) {
+                node_stack[stack_size] = node.first_child + i;
+                plane_mask_stack[stack_size] = plane_mask;
+                stack_size++;
+            }
+
+            continue;
+        }
+
+        for (int i = node.first_object; i < node.first_object + node.object_count; i++) {
+            int object_id = bvh_object_ids[i];
+            int object_plane_mask = plane_mask;
+            if (bounding_volumes::intersects_frustum(frustum, objects[object_id].world_bounds, object_plane_mask)) {
+                visible_object_ids.push_back(object_id);
+            }
+        }
+    }
+
+    // The tree visits the objects in no particular order, but they should
+    // still be submitted in the order they were added, so that a queue that
+    // doesn't sort draws them in that order too.
+    std::sort(visible_object_ids.begin(), visible_object_ids.end());
+
+    for (int object_id : visible_object_ids) {
+        const SceneObject& scene_object = objects[object_id];
+        const Object& object = select_lod(scene_object, render_queue.get_view(), render_queue.get_projection());
+        if (&object != &scene_object.object) {
+            reduced_lod_object_count++;
+        }
+
+        render_queue.submit(object, scene_object.model, scene_object.texture, scene_object.sampler_state);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+int Scene::get_visible_object_count() const {
+    return static_cast<int>(visible_object_ids.size());
+}
+
+// --------------------------------------------------------------------------
+
+int Scene::get_reduced_lod_object_count() const {
+    return reduced_lod_object_count;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::build_bvh() {
+    bvh_object_ids.clear();
+    for (int i = 0; i < get_object_count(); i++) {
+        objects[i].world_bounds = bounding_volumes::transform_box(objects[i].object.get_bounds(), objects[i].model);
+
+        // Objects without any vertices can never be seen.
+        if (!bounding_volumes::is_empty(objects[i].world_bounds)) {
+            bvh_object_ids.push_back(i);
+        }
+    }
+
+    bvh_nodes.clear();
+    if (!bvh_object_ids.empty()) {
+        bvh_nodes.push_back(BvhNode());
+        build_bvh_node(0, 0, static_cast<int>(bvh_object_ids.size()));
+    }
+
+    is_bvh_stale = false;
+    are_bounds_stale = false;
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::build_bvh_node(int node_index, int first_object, int object_count) {
+    bounding_volumes::BoundingBox bounds;
+    bounding_volumes::BoundingBox center_bounds;
+    for (int i = first_object; i < first_object + object_count; i++) {
+        const bounding_volumes::BoundingBox& object_bounds = objects[bvh_object_ids[i]].world_bounds;
+        bounding_volumes::grow_to_include(bounds, object_bounds);
+        bounding_volumes::grow_to_include(center_bounds, (object_bounds.min + object_bounds.max) * 0.5f);
+    }
+
+    BvhNode node;
+    node.bounds = bounds;
+    node.first_child = -1;
+    node.first_object = first_object;
+    node.object_count = object_count;
+
+    if (object_count <= MAX_LEAF_OBJECT_COUNT) {
+        bvh_nodes[node_index] = node;
+        return;
+    }
+
+    // Split at the median object along the axis where the objects' centers
+    // are the most spread out, which keeps the tree balanced.
+    glm::vec3 center_extents = center_bounds.max - center_bounds.min;
+    int split_axis = 0;
+    if (center_extents.y > center_extents[split_axis]) {
+        split_axis = 1;
+    }
+    if (center_extents.z > center_extents[split_axis]) {
+        split_axis = 2;
+    }
+
+    int first_object_count = object_count / 2;
+    std::vector<int>::iterator first = bvh_object_ids.begin() + first_object;
+    std::nth_element(first, first + first_object_count, first + object_count, [this, split_axis](int a, int b) {
+        const bounding_volumes::BoundingBox& a_bounds = objects[a].world_bounds;
+        const bounding_volumes::BoundingBox& b_bounds = objects[b].world_bounds;
+        return a_bounds.min[split_axis] + a_bounds.max[split_axis] < b_bounds.min[split_axis] + b_bounds.max[split_axis];
+    });
+
+    node.first_child = static_cast<int>(bvh_nodes.size());
+    node.object_count = 0;
+    bvh_nodes[node_index] = node;
+    bvh_nodes.push_back(BvhNode());
+    bvh_nodes.push_back(BvhNode());
+
+    build_bvh_node(node.first_child, first_object, first_object_count);
+    build_bvh_node(node.first_child + 1, first_object + first_object_count, object_count - first_object_count);
+}
+
+// --------------------------------------------------------------------------
+
+void Scene::refit_bvh() {
+    for (int object_id : bvh_object_ids) {
+        objects[object_id].world_bounds = bounding_volumes::transform_box(objects[object_id].object.get_bounds(), objects[object_id].model);
+    }
+
+    // Children always come after their parents, so going backwards means
+    // every node's children are refitted before the node itself.
+    for (int i = static_cast<int>(bvh_nodes.size()) - 1; i >= 0; i--) {
+        BvhNode& node = bvh_nodes[i];
+        node.bounds = bounding_volumes::BoundingBox();
+
+        if (node.object_count == 0) {
+            bounding_volumes::grow_to_include(node.bounds, bvh_nodes[node.first_child].bounds);
+            bounding_volumes::grow_to_include(node.bounds, bvh_nodes[node.first_child + 1].bounds);
+        } else {
+            for (int j = node.first_object; j < node.first_object + node.object_count; j++) {
+                bounding_volumes::grow_to_include(node.bounds, objects[bvh_object_ids[j]].world_bounds);
+            }
+        }
+    }
+
+    are_bounds_stale = false;
+}
+
+// --------------------------------------------------------------------------
+
+const Object& Scene::select_lod(const SceneObject& scene_object, const glm::mat4& view, const glm::mat4& projection) const {
+    if (scene_object.lods == nullptr || scene_object.lods->empty() || !(max_lod_pixel_error > 0.0f)) {
+        return scene_object.object;
+    }
+
+    // Errors are measured in object space, so they grow along with the
+    // model's largest scale.
+    float model_scale = std::max(std::max(glm::length(glm::vec3(scene_object.model[0])),
+                                          glm::length(glm::vec3(scene_object.model[1]))),
+                                 glm::length(glm::vec3(scene_object.model[2])));
+
+    // The error is projected at the nearest depth any part of the object
+    // could be at, which is never less than what it really looks like.
+    const bounding_volumes::BoundingBox& bounds = scene_object.world_bounds;
+    glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+    float radius = 0.5f * glm::length(bounds.max - bounds.min);
+    float nearest_depth = -(view * glm::vec4(center, 1.0f)).z - radius;
+    if (!(nearest_depth > 0.0f)) {
+        return scene_object.object;
+    }
+
+    // A perspective projection scales y by projection[1][1] before the
+    // divide by depth, and the viewport maps the resulting -1 to 1 onto its
+    // height.
+    float pixels_per_unit = 0.5f * lod_viewport_height * projection[1][1] / nearest_depth;
+
+    const Object* selected_object = &scene_object.object;
+    for (const mesh_simplification::LevelOfDetail& lod : *scene_object.lods) {
+        if (lod.geometric_error * model_scale * pixels_per_unit > max_lod_pixel_error) {
+            break;
+        }
+
+        selected_object = &lod.object;
+    }
+
+    return *selected_object;
+}
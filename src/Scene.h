@@ -0,0 +1,107 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "Object.h"
+#include "RenderQueue.h"
+#include "bounding_volumes.h"
+#include "mesh_simplification.h"
+#include "texture.h"
+
+class Scene {
+
+public:
+
+    Scene();
+    ~Scene();
+
+    // The scene takes over the object and hands back an id for it, which
+    // stays valid for as long as the scene is around.
+    int add_object(Object object, const texture::Texture* texture, const glm::mat4& model);
+    int get_object_count() const;
+
+    void set_model(int object_id, const glm::mat4& model);
+    void set_texture(int object_id, const texture::Texture* texture);
+
+    // Objects sample their textures with NEAREST filtering and CLAMP
+    // wrapping until told otherwise.
+    void set_sampler_state(int object_id, const texture::SamplerState& sampler_state);
+
+    // Coarser versions of an object, ordered from the most detailed to the
+    // least, which objects built from the same mesh can all share.
+    void set_lods(int object_id, std::shared_ptr<const std::vector<mesh_simplification::LevelOfDetail>> lods);
+
+    // Each submitted object uses its coarsest level whose geometric error,
+    // projected onto a viewport that many pixels high, is at most
+    // max_pixel_error pixels at the object's nearest possible depth. With
+    // no error allowed, which is the default, objects are always submitted
+    // at full detail.
+    void set_lod_selection(float max_pixel_error, int viewport_height);
+
+    // Culls the objects against the view frustum of the render queue's
+    // camera, a whole subtree of the bounding volume hierarchy at a time, and
+    // submits a draw for each object that is left, in the order they were
+    // added. The queue decides the order they are drawn in.
+    void submit(RenderQueue& render_queue);
+
+    // How many objects made it past culling in the last call to submit().
+    int get_visible_object_count() const;
+
+    // How many of those were submitted at less than full detail.
+    int get_reduced_lod_object_count() const;
+
+private:
+
+    // Nodes stop being split once they hold this many objects or fewer.
+    static const int MAX_LEAF_OBJECT_COUNT = 4;
+
+    // Every split halves a node's objects, so the tree can never get
+    // anywhere near this deep.
+    static const int MAX_BVH_DEPTH = 64;
+
+    struct SceneObject {
+        Object object;
+        const texture::Texture* texture;
+        texture::SamplerState sampler_state;
+        glm::mat4 model;
+        bounding_volumes::BoundingBox world_bounds;
+        std::shared_ptr<const std::vector<mesh_simplification::LevelOfDetail>> lods;
+    };
+
+    // Leaves refer to a range of bvh_object_ids. Interior nodes have no
+    // objects of their own, and their two children sit next to each other
+    // after them in bvh_nodes.
+    struct BvhNode {
+        bounding_volumes::BoundingBox bounds;
+        int first_child;
+        int first_object;
+        int object_count;
+    };
+
+    std::vector<SceneObject> objects;
+
+    // The tree is rebuilt when objects are added, but when they only move
+    // around its node bounds are just refitted to their new positions.
+    std::vector<BvhNode> bvh_nodes;
+    std::vector<int> bvh_object_ids;
+    bool is_bvh_stale;
+    bool are_bounds_stale;
+
+    std::vector<int> visible_object_ids;
+
+    float max_lod_pixel_error;
+    int lod_viewport_height;
+    int reduced_lod_object_count;
+
+    void build_bvh();
+    void build_bvh_node(int node_index, int first_object, int object_count);
+    void refit_bvh();
+
+    const Object& select_lod(const SceneObject& scene_object, const glm::mat4& view, const glm::mat4& projection) const;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+
+ThreadPool::ThreadPool(int thread_count)
+:
+thread_count(std::max(thread_count, 1)),
+task_ranges(new TaskRange[std::max(thread_count, 1)]),
+current_task(nullptr),
+generation(0),
+busy_thread_count(0),
+is_shutting_down(false) {
+
+    for (int thread_index = 1; thread_index < this->thread_count; thread_index++) {
+        threads.emplace_back(&ThreadPool::worker_loop, this, thread_index);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_shutting_down = true;
+    }
+    work_available.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// --------------------------------------------------------------------------
+
+int ThreadPool::get_thread_count() const {
+    return thread_count;
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::run(int task_count, const std::function<void(int, int)>& task) {
+    if (task_count <= 0) {
+        return;
+    }
+
+    for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+        task_ranges[thread_index].next = static_cast<int>(static_cast<Sint64>(task_count) * thread_index / thread_count);
+        task_ranges[thread_index].end = static_cast<int>(static_cast<Sint64>(task_count) * (thread_index + 1) / thread_count);
+    }
+
+    if (threads.empty()) {
+        run_tasks(0, task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_task = &task;
+        busy_thread_count = static_cast<int>(threads.size());
+        generation++;
+    }
+    work_available.notify_all();
+
+    run_tasks(0, task);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_finished.wait(lock, [this] { return busy_thread_count == 0; });
+    current_task = nullptr;
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::worker_loop(int thread_index) {
+    Uint64 last_generation = 0;
+
+    while (true) {
+        const std::function<void(int, int)>* task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this, last_generation] { return is_shutting_down || generation != last_generation; });
+            if (is_shutting_down) {
+                return;
+            }
+
+            last_generation = generation;
+            task = current_task;
+        }
+
+        run_tasks(thread_index, *task);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy_thread_count--;
+        }
+        work_finished.notify_one();
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void ThreadPool::run_tasks(int thread_index, const std::function<void(int, int)>& task) {
+    for (int i = 0; i < thread_count; i++) {
+        TaskRange& task_range = task_ranges[(thread_index + i) % thread_count];
+
+        int task_index = task_range.next.fetch_add(1);
+        while (task_index < task_range.end) {
+            task(task_index, thread_index);
+            task_index = task_range.next.fetch_add(1);
+        }
+    }
+}
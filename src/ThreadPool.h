@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+
+public:
+
+    // The thread count includes the thread calling run(), so a pool with a
+    // thread count of one never starts any threads of its own.
+    ThreadPool(int thread_count);
+    ~ThreadPool();
+
+    int get_thread_count() const;
+
+    // Calls task(task_index, thread_index) once for every task index in
+    // [0, task_count), spread across all of the pool's threads, and returns
+    // once every task is done. The calling thread is always thread 0.
+    void run(int task_count, const std::function<void(int, int)>& task);
+
+private:
+
+    // Each thread starts out with its own contiguous range of tasks, and
+    // once that runs dry it steals from the other threads' ranges. Both just
+    // bump the same atomic counter, so no task is ever handed out twice.
+    struct TaskRange {
+        std::atomic<int> next;
+        int end;
+    };
+
+    int thread_count;
+    std::vector<std::thread> threads;
+    std::unique_ptr<TaskRange[]> task_ranges;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+    const std::function<void(int, int)>* current_task;
+    Uint64 generation;
+    int busy_thread_count;
+    bool is_shutting_down;
+
+    void worker_loop(int thread_index);
+    void run_tasks(int thread_index, const std::function<void(int, int)>& task);
+};
+
+#endif
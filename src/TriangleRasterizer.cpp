@@ -1,148 +1,1055 @@
 #include "TriangleRasterizer.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "texture.h"
 
+// Screen coordinates are snapped to a 28.4 fixed point grid before any
+// coverage is computed, i.e. there are 16 subpixel steps per pixel.
+static const int SUBPIXEL_BITS = 4;
+static const int SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;
+static const int HALF_PIXEL = SUBPIXEL_STEPS / 2;
+
+// Anything this far off screen is garbage anyway, and clamping it keeps the
+// 64-bit edge function products from overflowing.
+static const float MAX_SUBPIXEL_COORD = static_cast<float>(1 << 24);
+
+// How far below the vertex depths a pixel's depth can end up, relative to
+// the magnitude of the terms that went into evaluating it.
+static const float DEPTH_ROUNDING_MARGIN = 1e-6f;
+
+// Overdraw heatmap colors for pixels shaded 0, 1, 2, ... times. Anything
+// shaded more often than that gets the last color.
+static const Uint32 OVERDRAW_HEATMAP_COLORS[] = {
+    0x000000FF,
+    0x1E3C96FF,
+    0x1E96C8FF,
+    0x32B432FF,
+    0xDCDC1EFF,
+    0xF08C1EFF,
+    0xDC1E1EFF,
+    0xFFFFFFFF,
+};
+static const int OVERDRAW_HEATMAP_COLOR_COUNT = sizeof(OVERDRAW_HEATMAP_COLORS) / sizeof(OVERDRAW_HEATMAP_COLORS[0]);
+
+// Enough for a few thousand triangles. The arena grows to fit bigger flushes.
+static const size_t INITIAL_FRAME_ARENA_SIZE = 1 << 20;
+
+// The chunk table starts out with room for this many chunks.
+static const Uint32 INITIAL_BINNED_TRIANGLE_CHUNK_CAPACITY = 16;
+
+// Interpolating an attribute linearly across a subspan of perspective
+// subdivision puts it off by up to about a quarter of the subspan length
+// times how much it changes per pixel, times how much 1/z changes across the
+// subspan relative to itself. Large triangles whose 1/z changes by more than
+// this fraction across a subspan, which are the ones seen nearly edge on,
+// are corrected at every pixel instead, which keeps the error under a pixel's
+// worth of change for subspans of up to 16 pixels.
+static const float MAX_SUBSPAN_INVERSE_Z_CHANGE = 1.0f / 16.0f;
+
+// The shared parts of solving for an attribute's screen-space plane.
+struct PlaneBasis {
+    float x10;
+    float y10;
+    float x20;
+    float y20;
+    float inverse_determinant;
+    float origin_offset_x;
+    float origin_offset_y;
+};
+
+// --------------------------------------------------------------------------
+
+static Sint64 to_fixed_point(float coord) {
+    float subpixel_coord = std::clamp(coord * SUBPIXEL_STEPS, -MAX_SUBPIXEL_COORD, MAX_SUBPIXEL_COORD);
+    return static_cast<Sint64>(std::lround(subpixel_coord));
+}
+
 // --------------------------------------------------------------------------
 
-TriangleRasterizer::TriangleRasterizer(int depth_buffer_width, int depth_buffer_height)
+// The first pixel whose center is at or after the fixed point coordinate.
+static int pixel_at_or_after(Sint64 fixed_point_coord) {
+    return static_cast<int>((fixed_point_coord - HALF_PIXEL + SUBPIXEL_STEPS - 1) >> SUBPIXEL_BITS);
+}
+
+// --------------------------------------------------------------------------
+
+// The last pixel whose center is at or before the fixed point coordinate.
+static int pixel_at_or_before(Sint64 fixed_point_coord) {
+    return static_cast<int>((fixed_point_coord - HALF_PIXEL) >> SUBPIXEL_BITS);
+}
+
+// --------------------------------------------------------------------------
+
+static void setup_edge(Sint64 ax, Sint64 ay, Sint64 bx, Sint64 by, Sint64 origin_x, Sint64 origin_y, EdgeFunction& edge) {
+    Sint64 dx = bx - ax;
+    Sint64 dy = by - ay;
+
+    // This is the 2d cross product, which gives the signed area of the
+    // parallelogram formed by the vectors ab and ap.
+    edge.value = (origin_x - ax) * dy - (origin_y - ay) * dx;
+    edge.step_x = dy * SUBPIXEL_STEPS;
+    edge.step_y = -dx * SUBPIXEL_STEPS;
+
+    // Top-left fill rule: a pixel center lying exactly on an edge belongs to
+    // the triangle only if that edge is a left edge (the inside is to its right)
+    // or a flat top edge (the inside is below it). Biasing every other edge by
+    // one subpixel unit excludes those pixels, so triangles sharing an edge
+    // never draw the same pixel twice and never leave a gap between them.
+    bool is_left_edge = dy > 0;
+    bool is_top_edge = dy == 0 && dx < 0;
+    if (!is_left_edge && !is_top_edge) {
+        edge.value -= 1;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+static void setup_attribute_plane(const PlaneBasis& basis, float a0, float a1, float a2, AttributePlane& plane) {
+    float a10 = a1 - a0;
+    float a20 = a2 - a0;
+
+    plane.step_x = (a10 * basis.y20 - a20 * basis.y10) * basis.inverse_determinant;
+    plane.step_y = (a20 * basis.x10 - a10 * basis.x20) * basis.inverse_determinant;
+    plane.value = a0 + plane.step_x * basis.origin_offset_x + plane.step_y * basis.origin_offset_y;
+}
+
+// --------------------------------------------------------------------------
+
+// The depth of the far plane, which is what the depth buffer is cleared to.
+static float get_far_depth(const raster_kernels::DepthFormat depth_format) {
+    using raster_kernels::DepthFormat;
+    using raster_kernels::DepthTraits;
+
+    switch (depth_format) {
+        case DepthFormat::REVERSED_FLOAT:
+            return 0.0f;
+
+        case DepthFormat::UNORM16:
+            return static_cast<float>(DepthTraits<DepthFormat::UNORM16>::MAX_VALUE);
+
+        case DepthFormat::UNORM24:
+            return static_cast<float>(DepthTraits<DepthFormat::UNORM24>::MAX_VALUE);
+
+        default:
+            return 1.0f;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+template<raster_kernels::DepthFormat DEPTH_FORMAT>
+static void fill_depths(Uint8* depth_buffer, int first_index, int count, float depth) {
+    typedef typename raster_kernels::DepthTraits<DEPTH_FORMAT>::Value DepthValue;
+
+    DepthValue* first_depth = reinterpret_cast<DepthValue*>(depth_buffer) + first_index;
+    std::fill(first_depth, first_depth + count, raster_kernels::DepthTraits<DEPTH_FORMAT>::to_stored(depth));
+}
+
+// --------------------------------------------------------------------------
+
+TriangleRasterizer::TriangleRasterizer(int buffer_width, int buffer_height)
 :
-depth_buffer_width(0),
-depth_buffer_height(0),
+buffer_width(0),
+buffer_height(0),
+depth_format(raster_kernels::DepthFormat::FLOAT),
+reversed_depth_offset(1.0f),
+reversed_depth_scale(0.0f),
+block_columns(0),
+block_rows(0),
 texture_filter(texture::TextureFilter::NEAREST),
-texture_wrap(texture::TextureWrap::CLAMP) {
+texture_wrap(texture::TextureWrap::CLAMP),
+is_depth_tested(true),
+is_depth_written(true),
+perspective_span_length(0),
+subdivided_untextured_kernel(nullptr),
+subdivided_textured_kernel(nullptr),
+tile_columns(0),
+tile_rows(0),
+frame_arena(INITIAL_FRAME_ARENA_SIZE),
+binned_triangle_chunks(nullptr),
+binned_triangle_chunk_capacity(0),
+binned_triangle_count(0),
+pipeline_stats(),
+is_tracking_overdraw(false),
+is_shading_deferred(false),
+sample_count(1) {
 
-    resize_depth_buffer(depth_buffer_width, depth_buffer_height);
+    set_kernel_type(raster_kernels::best_supported_kernel_type());
+    set_thread_count(SDL_GetNumLogicalCPUCores());
+    resize_buffers(buffer_width, buffer_height);
 }
 
 // --------------------------------------------------------------------------
 
 TriangleRasterizer::~TriangleRasterizer() {
-    // nothing to do for now
+    flush();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::rasterize(const Triangle& triangle, const texture::Texture* texture) {
+    TriangleSetup setup;
+    if (!setup_triangle(triangle, nullptr, 0, setup, nullptr)) {
+        return;
+    }
+
+    BinnedTriangle& binned_triangle = bin_triangle(setup);
+    binned_triangle.texture = texture;
+    binned_triangle.kernel = texture != nullptr ? textured_kernel : untextured_kernel;
+
+    int bounding_box_pixels = (setup.max_x - setup.min_x + 1) * (setup.max_y - setup.min_y + 1);
+    raster_kernels::TriangleKernel subdivided_kernel = texture != nullptr ? subdivided_textured_kernel : subdivided_untextured_kernel;
+    if (subdivided_kernel != nullptr && bounding_box_pixels >= LARGE_TRIANGLE_MIN_PIXELS) {
+        float max_view_distance = std::max({ std::abs(triangle.v0.view_z), std::abs(triangle.v1.view_z), std::abs(triangle.v2.view_z) });
+        float subspan_inverse_z_change = std::abs(setup.inverse_z.step_x) * perspective_span_length;
+        if (subspan_inverse_z_change * max_view_distance <= MAX_SUBSPAN_INVERSE_Z_CHANGE) {
+            binned_triangle.kernel = subdivided_kernel;
+        }
+    }
+
+    binned_triangle.resolve_shader = texture != nullptr ? textured_resolve_shader : untextured_resolve_shader;
 }
 
 // --------------------------------------------------------------------------
 
-void TriangleRasterizer::rasterize(SDL_Renderer* renderer, const Triangle& triangle, SDL_Surface* texture) {
-    const SDL_PixelFormatDetails* pixel_format_details;
-    if (texture != nullptr) {
-        pixel_format_details = SDL_GetPixelFormatDetails(texture->format);
+void TriangleRasterizer::rasterize(const Triangle& triangle, const float* const (&varyings)[3], const ShaderDraw& shader_draw) {
+    TriangleSetup setup;
+    AttributePlane varying_planes[raster_kernels::MAX_VARYING_COUNT];
+    if (!setup_triangle(triangle, varyings, shader_draw.varying_count, setup, varying_planes)) {
+        return;
+    }
+
+    AttributePlane* binned_varying_planes = frame_arena.allocate_array<AttributePlane>(shader_draw.varying_count);
+    std::copy(varying_planes, varying_planes + shader_draw.varying_count, binned_varying_planes);
+
+    BinnedTriangle& binned_triangle = bin_triangle(setup);
+    binned_triangle.texture = nullptr;
+    binned_triangle.kernel = untextured_kernel;
+    binned_triangle.resolve_shader = untextured_resolve_shader;
+    binned_triangle.shader_binding.varying_planes = binned_varying_planes;
+    binned_triangle.shader_binding.fragment_shader = shader_draw.fragment_shader;
+    binned_triangle.shader_resolve_shader = shader_draw.resolve_shader;
+
+    bool is_only_counting_or_recording = is_tracking_overdraw || (is_shading_deferred && sample_count == 1);
+    if (!is_only_counting_or_recording) {
+        binned_triangle.shader_kernel = shader_draw.kernel;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+TriangleRasterizer::BinnedTriangle& TriangleRasterizer::bin_triangle(const TriangleSetup& setup) {
+    pipeline_stats.rasterized_triangles++;
+
+    Uint32 triangle_index = binned_triangle_count;
+    BinnedTriangle& binned_triangle = add_binned_triangle();
+    binned_triangle.setup = setup;
+    binned_triangle.shader_binding.varying_planes = nullptr;
+    binned_triangle.shader_binding.fragment_shader = nullptr;
+    binned_triangle.shader_kernel = nullptr;
+    binned_triangle.shader_resolve_shader = nullptr;
+    binned_triangle.is_depth_tested = is_depth_tested;
+
+    for (int tile_y = setup.min_y / TILE_SIZE; tile_y <= setup.max_y / TILE_SIZE; tile_y++) {
+        for (int tile_x = setup.min_x / TILE_SIZE; tile_x <= setup.max_x / TILE_SIZE; tile_x++) {
+            add_to_tile_bin(tile_bins[tile_y * tile_columns + tile_x], triangle_index);
+        }
     }
 
-    int bounding_box_min_x = std::min({ triangle.v0.screen_coord.x, triangle.v1.screen_coord.x, triangle.v2.screen_coord.x });
-    int bounding_box_max_x = std::max({ triangle.v0.screen_coord.x, triangle.v1.screen_coord.x, triangle.v2.screen_coord.x });
-    int bounding_box_min_y = std::min({ triangle.v0.screen_coord.y, triangle.v1.screen_coord.y, triangle.v2.screen_coord.y });
-    int bounding_box_max_y = std::max({ triangle.v0.screen_coord.y, triangle.v1.screen_coord.y, triangle.v2.screen_coord.y });
+    return binned_triangle;
+}
 
-    // We'll be more efficient here by limiting the bounding box to the viewable area.
-    int render_width, render_height;
-    SDL_GetCurrentRenderOutputSize(renderer, &render_width, &render_height);
-    bounding_box_min_x = std::clamp(bounding_box_min_x, 0, render_width - 1);
-    bounding_box_max_x = std::clamp(bounding_box_max_x, 0, render_width - 1);
-    bounding_box_min_y = std::clamp(bounding_box_min_y, 0, render_height - 1);
-    bounding_box_max_y = std::clamp(bounding_box_max_y, 0, render_height - 1);
+// --------------------------------------------------------------------------
 
-    float area = edge(triangle.v0.screen_coord, triangle.v1.screen_coord, triangle.v2.screen_coord);
-    if (area == 0) {
+void TriangleRasterizer::flush() {
+    if (binned_triangle_count == 0) {
         return;
     }
 
-    if (texture != nullptr) {
-        SDL_LockSurface(texture);
+    raster_kernels::RenderTarget target = {
+        color_buffer.data(),
+        depth_buffer.data(),
+        block_max_depth.data(),
+        buffer_width,
+        buffer_height,
+        block_columns,
+        is_tracking_overdraw ? shade_counts.data() : nullptr,
+        is_shading_deferred && sample_count == 1 ? visibility_buffer.data() : nullptr,
+        sample_count,
+        sample_count > 1 ? sample_colors.data() : nullptr
+    };
+
+    thread_pool->run(tile_columns * tile_rows, [this, &target](int tile_index, int) {
+        rasterize_tile(tile_index, target);
+    });
+
+    for (int i = 0; i < tile_columns * tile_rows; i++) {
+        raster_kernels::add_pixel_stats(pipeline_stats.pixels, tile_pixel_stats[i]);
     }
 
-    for (int y = bounding_box_min_y; y <= bounding_box_max_y; y++) {
-        for (int x = bounding_box_min_x; x <= bounding_box_max_x; x++) {
-            glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f);
+    for (TileBin& tile_bin : tile_bins) {
+        tile_bin.first = nullptr;
+        tile_bin.last = nullptr;
+    }
 
-            float w0 = edge(triangle.v1.screen_coord, triangle.v2.screen_coord, p);
-            float w1 = edge(triangle.v2.screen_coord, triangle.v0.screen_coord, p);
-            float w2 = edge(triangle.v0.screen_coord, triangle.v1.screen_coord, p);
+    binned_triangle_chunks = nullptr;
+    binned_triangle_chunk_capacity = 0;
+    binned_triangle_count = 0;
+    frame_arena.reset();
+}
 
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                // Normalize to barycentric coordinates.
-                w0 /= area;
-                w1 /= area;
-                w2 /= area;
+// --------------------------------------------------------------------------
 
-                float depth = triangle.v0.ndc_z * w0 + triangle.v1.ndc_z * w1 + triangle.v2.ndc_z * w2;
-                int depth_buffer_index = y * depth_buffer_width + x;
-                if (depth > depth_buffer[depth_buffer_index]) {
-                    continue;
-                } else {
-                    depth_buffer[depth_buffer_index] = depth;
-                }
+void TriangleRasterizer::rasterize_tile(int tile_index, const raster_kernels::RenderTarget& target) {
+    int tile_x = tile_index % tile_columns;
+    int tile_y = tile_index / tile_columns;
 
-                float inverse_z0 = 1.0f / triangle.v0.view_z;
-                float inverse_z1 = 1.0f / triangle.v1.view_z;
-                float inverse_z2 = 1.0f / triangle.v2.view_z;
-                float interpolated_inverse_z = inverse_z0 * w0 + inverse_z1 * w1 + inverse_z2 * w2;
+    raster_kernels::PixelRect tile_rect;
+    tile_rect.min_x = tile_x * TILE_SIZE;
+    tile_rect.min_y = tile_y * TILE_SIZE;
+    tile_rect.max_x = std::min(tile_rect.min_x + TILE_SIZE, buffer_width) - 1;
+    tile_rect.max_y = std::min(tile_rect.min_y + TILE_SIZE, buffer_height) - 1;
 
-                glm::vec3 color;
-                if (texture == nullptr) {
-                    glm::vec3 color_projected0 = triangle.v0.color * inverse_z0;
-                    glm::vec3 color_projected1 = triangle.v1.color * inverse_z1;
-                    glm::vec3 color_projected2 = triangle.v2.color * inverse_z2;
+    raster_kernels::PixelStats pixel_stats = {};
 
-                    color = (color_projected0 * w0 + color_projected1 * w1 + color_projected2 * w2) / interpolated_inverse_z;
-                    color = glm::clamp(color, 0.0f, 1.0f);
-                } else {
-                    glm::vec2 uv_projected0 = triangle.v0.tex_coord * inverse_z0;
-                    glm::vec2 uv_projected1 = triangle.v1.tex_coord * inverse_z1;
-                    glm::vec2 uv_projected2 = triangle.v2.tex_coord * inverse_z2;
+    if (is_tile_depth_clear_pending[tile_index] && tile_bins[tile_index].first != nullptr) {
+        clear_tile_depth(tile_rect);
+        is_tile_depth_clear_pending[tile_index] = false;
+    }
 
-                    glm::vec2 interpolated_perspective_corrected_uv =
-                        (uv_projected0 * w0 + uv_projected1 * w1 + uv_projected2 * w2) / interpolated_inverse_z;
+    float tile_max_depth = max_depth_in_tile(tile_rect);
+    for (const TileBinChunk* chunk = tile_bins[tile_index].first; chunk != nullptr; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            Uint32 triangle_index = chunk->triangle_indices[i];
+            const BinnedTriangle& binned_triangle = get_binned_triangle(triangle_index);
+            if (binned_triangle.is_depth_tested && binned_triangle.setup.min_depth > tile_max_depth) {
+                continue;
+            }
 
-                    color = texture::sample_locked_surface(texture, pixel_format_details, interpolated_perspective_corrected_uv, texture_filter, texture_wrap);
-                }
+            bool has_written_depth;
+            if (binned_triangle.shader_kernel != nullptr) {
+                has_written_depth = binned_triangle.shader_kernel(binned_triangle.setup, binned_triangle.shader_binding, tile_rect, target, pixel_stats);
+            } else {
+                has_written_depth = binned_triangle.kernel(binned_triangle.setup, tile_rect, target, binned_triangle.texture, triangle_index, pixel_stats);
+            }
 
-                SDL_SetRenderDrawColor(renderer, color.r * 255, color.g * 255, color.b * 255, 255);
-                SDL_RenderPoint(renderer, x, y);
+            if (has_written_depth) {
+                tile_max_depth = max_depth_in_tile(tile_rect);
             }
         }
     }
 
-    if (texture != nullptr) {
-        SDL_UnlockSurface(texture);
+    // Tiles that nothing was drawn in still hold what they were resolved to
+    // before.
+    if (sample_count > 1) {
+        if (tile_bins[tile_index].first != nullptr) {
+            resolve_samples(tile_rect);
+        }
+    } else if (is_shading_deferred && !is_tracking_overdraw) {
+        resolve_tile(tile_rect, target, pixel_stats);
     }
+
+    tile_pixel_stats[tile_index] = pixel_stats;
 }
 
 // --------------------------------------------------------------------------
 
-float TriangleRasterizer::edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p) {
-    // This is the 2d cross product, which gives the signed area of the
-    // parallelogram formed by the vectors ab and ap.
-    return (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x);
+void TriangleRasterizer::resolve_tile(const raster_kernels::PixelRect& tile_rect,
+                                      const raster_kernels::RenderTarget& target,
+                                      raster_kernels::PixelStats& pixel_stats) {
+
+    // Neighboring pixels usually show the same triangle, so each run of them
+    // is shaded with a single call.
+    for (int y = tile_rect.min_y; y <= tile_rect.max_y; y++) {
+        Uint32* visibility_row = target.visibility_buffer + y * target.width;
+
+        int x = tile_rect.min_x;
+        while (x <= tile_rect.max_x) {
+            Uint32 visible_id = visibility_row[x];
+            if (visible_id == 0) {
+                x++;
+                continue;
+            }
+
+            int run_min_x = x;
+            while (x <= tile_rect.max_x && visibility_row[x] == visible_id) {
+                visibility_row[x] = 0;
+                x++;
+            }
+
+            const BinnedTriangle& binned_triangle = get_binned_triangle(visible_id - 1);
+            if (binned_triangle.shader_resolve_shader != nullptr) {
+                binned_triangle.shader_resolve_shader(binned_triangle.setup, binned_triangle.shader_binding, target, y, run_min_x, x - 1);
+            } else {
+                binned_triangle.resolve_shader(binned_triangle.setup, binned_triangle.texture, target, y, run_min_x, x - 1);
+            }
+            pixel_stats.resolved_pixels += x - run_min_x;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::resolve_samples(const raster_kernels::PixelRect& tile_rect) {
+    for (int y = tile_rect.min_y; y <= tile_rect.max_y; y++) {
+        for (int x = tile_rect.min_x; x <= tile_rect.max_x; x++) {
+            int pixel_index = y * buffer_width + x;
+            const Uint32* samples = sample_colors.data() + pixel_index * sample_count;
+
+            Uint32 sums[3] = { 0, 0, 0 };
+            for (int s = 0; s < sample_count; s++) {
+                sums[0] += samples[s] >> 24;
+                sums[1] += (samples[s] >> 16) & 0xFF;
+                sums[2] += (samples[s] >> 8) & 0xFF;
+            }
+
+            // Rounded to the nearest value, so a pixel whose samples all
+            // have the same color keeps exactly that color.
+            Uint32 half_sample_count = sample_count / 2;
+            Uint32 r = (sums[0] + half_sample_count) / sample_count;
+            Uint32 g = (sums[1] + half_sample_count) / sample_count;
+            Uint32 b = (sums[2] + half_sample_count) / sample_count;
+
+            color_buffer[pixel_index] = (r << 24) | (g << 16) | (b << 8) | 0xFF;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::clear_tile_depth(const raster_kernels::PixelRect& tile_rect) {
+    using raster_kernels::DepthFormat;
+    using raster_kernels::DEPTH_BLOCK_SIZE;
+
+    float far_depth = get_far_depth(depth_format);
+    int row_length = (tile_rect.max_x - tile_rect.min_x + 1) * sample_count;
+    for (int y = tile_rect.min_y; y <= tile_rect.max_y; y++) {
+        int row_index = (y * buffer_width + tile_rect.min_x) * sample_count;
+        switch (depth_format) {
+            case DepthFormat::UNORM16:
+                fill_depths<DepthFormat::UNORM16>(depth_buffer.data(), row_index, row_length, far_depth);
+                break;
+
+            case DepthFormat::UNORM24:
+                fill_depths<DepthFormat::UNORM24>(depth_buffer.data(), row_index, row_length, far_depth);
+                break;
+
+            default:
+                fill_depths<DepthFormat::FLOAT>(depth_buffer.data(), row_index, row_length, far_depth);
+                break;
+        }
+    }
+
+    for (int block_y = tile_rect.min_y / DEPTH_BLOCK_SIZE; block_y <= tile_rect.max_y / DEPTH_BLOCK_SIZE; block_y++) {
+        for (int block_x = tile_rect.min_x / DEPTH_BLOCK_SIZE; block_x <= tile_rect.max_x / DEPTH_BLOCK_SIZE; block_x++) {
+            block_max_depth[block_y * block_columns + block_x] = far_depth;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+float TriangleRasterizer::max_depth_in_tile(const raster_kernels::PixelRect& tile_rect) const {
+    using raster_kernels::DEPTH_BLOCK_SIZE;
+
+    float max_depth = -INFINITY;
+    for (int block_y = tile_rect.min_y / DEPTH_BLOCK_SIZE; block_y <= tile_rect.max_y / DEPTH_BLOCK_SIZE; block_y++) {
+        for (int block_x = tile_rect.min_x / DEPTH_BLOCK_SIZE; block_x <= tile_rect.max_x / DEPTH_BLOCK_SIZE; block_x++) {
+            max_depth = std::max(max_depth, block_max_depth[block_y * block_columns + block_x]);
+        }
+    }
+
+    return max_depth;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::select_kernels() {
+    raster_kernels::RenderState render_state = get_render_state();
+    render_state.is_textured = false;
+    if (sample_count > 1) {
+        untextured_kernel = raster_kernels::get_multisample_kernel(sample_count, render_state);
+    } else {
+        untextured_kernel = raster_kernels::get_kernel(kernel_type, render_state);
+    }
+    untextured_resolve_shader = raster_kernels::get_resolve_shader(render_state);
+
+    render_state.is_textured = true;
+    if (sample_count > 1) {
+        textured_kernel = raster_kernels::get_multisample_kernel(sample_count, render_state);
+    } else {
+        textured_kernel = raster_kernels::get_kernel(kernel_type, render_state);
+    }
+    textured_resolve_shader = raster_kernels::get_resolve_shader(render_state);
+
+    subdivided_untextured_kernel = nullptr;
+    subdivided_textured_kernel = nullptr;
+    if (perspective_span_length > 0 && sample_count == 1 && !is_tracking_overdraw && !is_shading_deferred) {
+        render_state.is_textured = false;
+        subdivided_untextured_kernel = raster_kernels::get_subdivided_kernel(kernel_type, perspective_span_length, render_state);
+
+        render_state.is_textured = true;
+        subdivided_textured_kernel = raster_kernels::get_subdivided_kernel(kernel_type, perspective_span_length, render_state);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+TriangleRasterizer::BinnedTriangle& TriangleRasterizer::add_binned_triangle() {
+    Uint32 chunk_index = binned_triangle_count >> BINNED_TRIANGLE_CHUNK_BITS;
+    Uint32 index_in_chunk = binned_triangle_count & (BINNED_TRIANGLE_CHUNK_SIZE - 1);
+
+    if (index_in_chunk == 0) {
+        // The old table is left behind in the arena when it grows, which
+        // wastes less memory than a single chunk.
+        if (chunk_index == binned_triangle_chunk_capacity) {
+            Uint32 new_capacity = std::max(binned_triangle_chunk_capacity * 2, INITIAL_BINNED_TRIANGLE_CHUNK_CAPACITY);
+            BinnedTriangle** new_chunks = frame_arena.allocate_array<BinnedTriangle*>(new_capacity);
+            std::copy(binned_triangle_chunks, binned_triangle_chunks + binned_triangle_chunk_capacity, new_chunks);
+
+            binned_triangle_chunks = new_chunks;
+            binned_triangle_chunk_capacity = new_capacity;
+        }
+
+        binned_triangle_chunks[chunk_index] = frame_arena.allocate_array<BinnedTriangle>(BINNED_TRIANGLE_CHUNK_SIZE);
+    }
+
+    binned_triangle_count++;
+    return binned_triangle_chunks[chunk_index][index_in_chunk];
+}
+
+// --------------------------------------------------------------------------
+
+const TriangleRasterizer::BinnedTriangle& TriangleRasterizer::get_binned_triangle(Uint32 triangle_index) const {
+    return binned_triangle_chunks[triangle_index >> BINNED_TRIANGLE_CHUNK_BITS][triangle_index & (BINNED_TRIANGLE_CHUNK_SIZE - 1)];
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::add_to_tile_bin(TileBin& tile_bin, Uint32 triangle_index) {
+    if (tile_bin.last == nullptr || tile_bin.last->count == TILE_BIN_CHUNK_SIZE) {
+        TileBinChunk* chunk = frame_arena.allocate_array<TileBinChunk>(1);
+        chunk->next = nullptr;
+        chunk->count = 0;
+
+        if (tile_bin.last == nullptr) {
+            tile_bin.first = chunk;
+        } else {
+            tile_bin.last->next = chunk;
+        }
+        tile_bin.last = chunk;
+    }
+
+    tile_bin.last->triangle_indices[tile_bin.last->count++] = triangle_index;
+}
+
+// --------------------------------------------------------------------------
+
+bool TriangleRasterizer::setup_triangle(const Triangle& triangle,
+                                        const float* const* varyings,
+                                        int varying_count,
+                                        TriangleSetup& setup,
+                                        AttributePlane* varying_planes) {
+
+    Sint64 x0 = to_fixed_point(triangle.v0.screen_coord.x);
+    Sint64 y0 = to_fixed_point(triangle.v0.screen_coord.y);
+    Sint64 x1 = to_fixed_point(triangle.v1.screen_coord.x);
+    Sint64 y1 = to_fixed_point(triangle.v1.screen_coord.y);
+    Sint64 x2 = to_fixed_point(triangle.v2.screen_coord.x);
+    Sint64 y2 = to_fixed_point(triangle.v2.screen_coord.y);
+
+    // This is the same cross product as the edge functions use, so triangles
+    // that are counter-clockwise on screen have a positive area.
+    // Back-facing triangles were already culled, so whatever is left here
+    // has collapsed to nothing once snapped to the subpixel grid.
+    Sint64 area = (x2 - x0) * (y1 - y0) - (y2 - y0) * (x1 - x0);
+    if (area <= 0) {
+        pipeline_stats.zero_area_triangles++;
+        return false;
+    }
+
+    // A pixel is a candidate if its center, or any of its samples when
+    // multisampling, lies within the snapped vertices' extents, and we only
+    // care about the candidates that are on screen. The sample positions
+    // are on the same subpixel grid as the vertices.
+    Sint64 sample_reach = sample_count > 1 ? raster_kernels::MAX_SAMPLE_OFFSET : 0;
+    setup.min_x = std::max(pixel_at_or_after(std::min({ x0, x1, x2 }) - sample_reach), 0);
+    setup.min_y = std::max(pixel_at_or_after(std::min({ y0, y1, y2 }) - sample_reach), 0);
+    setup.max_x = std::min(pixel_at_or_before(std::max({ x0, x1, x2 }) + sample_reach), buffer_width - 1);
+    setup.max_y = std::min(pixel_at_or_before(std::max({ y0, y1, y2 }) + sample_reach), buffer_height - 1);
+    if (setup.min_x > setup.max_x || setup.min_y > setup.max_y) {
+        pipeline_stats.frustum_culled_triangles++;
+        return false;
+    }
+
+    Sint64 origin_x = (static_cast<Sint64>(setup.min_x) << SUBPIXEL_BITS) + HALF_PIXEL;
+    Sint64 origin_y = (static_cast<Sint64>(setup.min_y) << SUBPIXEL_BITS) + HALF_PIXEL;
+
+    setup_edge(x1, y1, x2, y2, origin_x, origin_y, setup.edges[0]);
+    setup_edge(x2, y2, x0, y0, origin_x, origin_y, setup.edges[1]);
+    setup_edge(x0, y0, x1, y1, origin_x, origin_y, setup.edges[2]);
+
+    // The attribute planes are built from the snapped vertices as well, so
+    // that they agree with the coverage computed from the edge functions.
+    PlaneBasis basis;
+    basis.x10 = static_cast<float>(x1 - x0) / SUBPIXEL_STEPS;
+    basis.y10 = static_cast<float>(y1 - y0) / SUBPIXEL_STEPS;
+    basis.x20 = static_cast<float>(x2 - x0) / SUBPIXEL_STEPS;
+    basis.y20 = static_cast<float>(y2 - y0) / SUBPIXEL_STEPS;
+    basis.inverse_determinant = -static_cast<float>(SUBPIXEL_STEPS * SUBPIXEL_STEPS) / area;
+    basis.origin_offset_x = static_cast<float>(origin_x - x0) / SUBPIXEL_STEPS;
+    basis.origin_offset_y = static_cast<float>(origin_y - y0) / SUBPIXEL_STEPS;
+
+    float inverse_z0 = 1.0f / triangle.v0.view_z;
+    float inverse_z1 = 1.0f / triangle.v1.view_z;
+    float inverse_z2 = 1.0f / triangle.v2.view_z;
+
+    float depth0 = get_vertex_depth(triangle.v0);
+    float depth1 = get_vertex_depth(triangle.v1);
+    float depth2 = get_vertex_depth(triangle.v2);
+    setup_attribute_plane(basis, depth0, depth1, depth2, setup.depth);
+
+    // Every covered pixel's depth is a blend of the vertex depths, give or
+    // take the rounding error of evaluating the plane, which can't be more
+    // than a few ulps of the largest term that goes into it.
+    float largest_depth_term = std::abs(setup.depth.value)
+                             + std::abs(setup.depth.step_x) * (setup.max_x - setup.min_x)
+                             + std::abs(setup.depth.step_y) * (setup.max_y - setup.min_y);
+    setup.min_depth = std::min({ depth0, depth1, depth2 }) - (largest_depth_term + 1.0f) * DEPTH_ROUNDING_MARGIN;
+
+    // Integer depths can round down by half a step, and anything past the
+    // far plane is stored as the far plane.
+    if (depth_format == raster_kernels::DepthFormat::UNORM16 || depth_format == raster_kernels::DepthFormat::UNORM24) {
+        setup.min_depth = std::min(setup.min_depth - 0.5f, get_far_depth(depth_format));
+    }
+
+    setup_attribute_plane(basis, inverse_z0, inverse_z1, inverse_z2, setup.inverse_z);
+
+    if (varyings != nullptr) {
+        for (int i = 0; i < varying_count; i++) {
+            setup_attribute_plane(basis,
+                                  varyings[0][i] * inverse_z0,
+                                  varyings[1][i] * inverse_z1,
+                                  varyings[2][i] * inverse_z2,
+                                  varying_planes[i]);
+        }
+
+        return true;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        setup_attribute_plane(basis,
+                              triangle.v0.color[i] * inverse_z0,
+                              triangle.v1.color[i] * inverse_z1,
+                              triangle.v2.color[i] * inverse_z2,
+                              setup.color_over_z[i]);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        setup_attribute_plane(basis,
+                              triangle.v0.tex_coord[i] * inverse_z0,
+                              triangle.v1.tex_coord[i] * inverse_z1,
+                              triangle.v2.tex_coord[i] * inverse_z2,
+                              setup.tex_coord_over_z[i]);
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+float TriangleRasterizer::get_vertex_depth(const Vertex& vertex) const {
+    switch (depth_format) {
+        case raster_kernels::DepthFormat::REVERSED_FLOAT:
+            return -(reversed_depth_offset + reversed_depth_scale / vertex.view_z);
+
+        case raster_kernels::DepthFormat::UNORM16:
+        case raster_kernels::DepthFormat::UNORM24:
+            return (vertex.ndc_z * 0.5f + 0.5f) * get_far_depth(depth_format);
+
+        default:
+            return vertex.ndc_z;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::clear_color_buffer(Uint8 r, Uint8 g, Uint8 b) {
+    flush();
+
+    Uint32 packed_color = (r << 24) | (g << 16) | (b << 8) | 0xFF;
+    std::fill(color_buffer.begin(), color_buffer.end(), packed_color);
+    std::fill(sample_colors.begin(), sample_colors.end(), packed_color);
+
+    if (is_tracking_overdraw) {
+        std::fill(shade_counts.begin(), shade_counts.end(), 0);
+    }
 }
 
 // --------------------------------------------------------------------------
 
 void TriangleRasterizer::clear_depth_buffer() {
-    std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+    flush();
+
+    std::fill(is_tile_depth_clear_pending.begin(), is_tile_depth_clear_pending.end(), true);
 }
 
 // --------------------------------------------------------------------------
 
-void TriangleRasterizer::resize_depth_buffer(int new_width, int new_height) {
-    if (depth_buffer_width == new_width && depth_buffer_height == new_height) {
+void TriangleRasterizer::resize_buffers(int new_width, int new_height) {
+    if (buffer_width == new_width && buffer_height == new_height) {
         return;
     }
 
-    depth_buffer_width = new_width;
-    depth_buffer_height = new_height;
-    depth_buffer.resize(depth_buffer_width * depth_buffer_height);
+    flush();
+
+    buffer_width = new_width;
+    buffer_height = new_height;
+    color_buffer.resize(buffer_width * buffer_height);
+    depth_buffer.resize(buffer_width * buffer_height * sample_count * raster_kernels::depth_format_size(depth_format));
+
+    if (sample_count > 1) {
+        sample_colors.resize(buffer_width * buffer_height * sample_count);
+    }
+
+    if (is_tracking_overdraw) {
+        shade_counts.assign(buffer_width * buffer_height, 0);
+    }
+
+    if (is_shading_deferred) {
+        visibility_buffer.assign(buffer_width * buffer_height, 0);
+    }
+
+    block_columns = (buffer_width + raster_kernels::DEPTH_BLOCK_SIZE - 1) / raster_kernels::DEPTH_BLOCK_SIZE;
+    block_rows = (buffer_height + raster_kernels::DEPTH_BLOCK_SIZE - 1) / raster_kernels::DEPTH_BLOCK_SIZE;
+
+    // Whatever is left in the depth buffer no longer lines up with the
+    // blocks, so nothing can be rejected until it is cleared again.
+    block_max_depth.assign(block_columns * block_rows, INFINITY);
+
+    tile_columns = (buffer_width + TILE_SIZE - 1) / TILE_SIZE;
+    tile_rows = (buffer_height + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Bins past the ones in use are kept, empty, along with the memory they
+    // grew to, so that going back up to a bigger size doesn't start them
+    // all over again.
+    if (static_cast<int>(tile_bins.size()) < tile_columns * tile_rows) {
+        tile_bins.resize(tile_columns * tile_rows, TileBin());
+        tile_pixel_stats.resize(tile_columns * tile_rows);
+    }
+
+    is_tile_depth_clear_pending.resize(tile_columns * tile_rows);
+    std::fill(is_tile_depth_clear_pending.begin(), is_tile_depth_clear_pending.end(), false);
 }
 
 // --------------------------------------------------------------------------
 
 void TriangleRasterizer::set_texture_filter(const texture::TextureFilter texture_filter) {
     this->texture_filter = texture_filter;
+    select_kernels();
 }
 
 // --------------------------------------------------------------------------
 
 void TriangleRasterizer::set_texture_wrap(const texture::TextureWrap texture_wrap) {
     this->texture_wrap = texture_wrap;
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_depth_test(bool is_depth_tested) {
+    this->is_depth_tested = is_depth_tested;
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_depth_write(bool is_depth_written) {
+    this->is_depth_written = is_depth_written;
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_depth_format(const raster_kernels::DepthFormat depth_format) {
+    if (this->depth_format == depth_format) {
+        return;
+    }
+
+    flush();
+
+    this->depth_format = depth_format;
+    depth_buffer.resize(buffer_width * buffer_height * sample_count * raster_kernels::depth_format_size(depth_format));
+
+    // Just like after resizing, nothing can be rejected until the depth
+    // buffer is cleared again.
+    std::fill(block_max_depth.begin(), block_max_depth.end(), INFINITY);
+    std::fill(is_tile_depth_clear_pending.begin(), is_tile_depth_clear_pending.end(), false);
+
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::DepthFormat TriangleRasterizer::get_depth_format() const {
+    return depth_format;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_depth_projection(const glm::mat4& projection) {
+    // A perspective projection's depth is -P[2][2] - P[3][2] / view z in
+    // normalized device coordinates, from -1 at the near plane to 1 at the
+    // far plane, and reversed depth is half of one minus that.
+    reversed_depth_offset = (1.0f + projection[2][2]) * 0.5f;
+    reversed_depth_scale = projection[3][2] * 0.5f;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_kernel_type(const raster_kernels::KernelType kernel_type) {
+    if (raster_kernels::is_kernel_type_supported(kernel_type)) {
+        this->kernel_type = kernel_type;
+    } else {
+        this->kernel_type = raster_kernels::KernelType::SCALAR;
+    }
+
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::RenderState TriangleRasterizer::get_render_state() const {
+    raster_kernels::RenderState render_state;
+    render_state.is_textured = false;
+    render_state.texture_filter = texture_filter;
+    render_state.texture_wrap = texture_wrap;
+    render_state.is_depth_tested = is_depth_tested;
+    render_state.is_depth_written = is_depth_written;
+    render_state.is_counting_overdraw = is_tracking_overdraw;
+    render_state.is_shading_deferred = is_shading_deferred && sample_count == 1;
+    render_state.depth_format = depth_format;
+
+    return render_state;
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::KernelType TriangleRasterizer::get_kernel_type() const {
+    return kernel_type;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_thread_count(int thread_count) {
+    thread_count = std::max(thread_count, 1);
+    if (thread_pool != nullptr && thread_pool->get_thread_count() == thread_count) {
+        return;
+    }
+
+    flush();
+    thread_pool = std::make_unique<ThreadPool>(thread_count);
+}
+
+// --------------------------------------------------------------------------
+
+int TriangleRasterizer::get_thread_count() const {
+    return thread_pool->get_thread_count();
+}
+
+// --------------------------------------------------------------------------
+
+int TriangleRasterizer::get_buffer_width() const {
+    return buffer_width;
+}
+
+// --------------------------------------------------------------------------
+
+int TriangleRasterizer::get_buffer_height() const {
+    return buffer_height;
+}
+
+// --------------------------------------------------------------------------
+
+const Uint32* TriangleRasterizer::get_color_buffer() const {
+    return color_buffer.data();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::swap_color_buffer(std::vector<Uint32>& buffer) {
+    flush();
+
+    buffer.resize(color_buffer.size());
+    color_buffer.swap(buffer);
+}
+
+// --------------------------------------------------------------------------
+
+vertex_stage::TransformedVertices& TriangleRasterizer::get_transformed_vertices() {
+    return transformed_vertices;
+}
+
+// --------------------------------------------------------------------------
+
+const PipelineStats& TriangleRasterizer::get_pipeline_stats() const {
+    return pipeline_stats;
+}
+
+// --------------------------------------------------------------------------
+
+PipelineStats& TriangleRasterizer::get_pipeline_stats() {
+    return pipeline_stats;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::reset_pipeline_stats() {
+    flush();
+    pipeline_stats = PipelineStats();
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_overdraw_tracking(bool is_tracking_overdraw) {
+    if (this->is_tracking_overdraw == is_tracking_overdraw) {
+        return;
+    }
+
+    flush();
+
+    this->is_tracking_overdraw = is_tracking_overdraw;
+    if (is_tracking_overdraw) {
+        shade_counts.assign(buffer_width * buffer_height, 0);
+    } else {
+        shade_counts = std::vector<Uint16>();
+    }
+
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+bool TriangleRasterizer::get_overdraw_tracking() const {
+    return is_tracking_overdraw;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_deferred_shading(bool is_shading_deferred) {
+    if (this->is_shading_deferred == is_shading_deferred) {
+        return;
+    }
+
+    // Triangles that were already binned must be resolved with the
+    // visibility buffer they were drawn into.
+    flush();
+
+    this->is_shading_deferred = is_shading_deferred;
+    if (is_shading_deferred) {
+        visibility_buffer.assign(buffer_width * buffer_height, 0);
+    } else {
+        visibility_buffer = std::vector<Uint32>();
+    }
+
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+bool TriangleRasterizer::get_deferred_shading() const {
+    return is_shading_deferred;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_multisampling(int sample_count) {
+    if (sample_count != 2 && sample_count != 4) {
+        sample_count = 1;
+    }
+
+    if (this->sample_count == sample_count) {
+        return;
+    }
+
+    flush();
+
+    // Every sample starts out with what its pixel had, and going back to a
+    // single sample keeps each pixel's first one. Either way, no depth ends
+    // up farther than before, so the depth blocks stay valid.
+    int pixel_count = buffer_width * buffer_height;
+    int depth_size = raster_kernels::depth_format_size(depth_format);
+    std::vector<Uint8> new_depth_buffer(pixel_count * sample_count * depth_size);
+    for (int i = 0; i < pixel_count; i++) {
+        for (int s = 0; s < sample_count; s++) {
+            std::memcpy(&new_depth_buffer[(i * sample_count + s) * depth_size], &depth_buffer[i * this->sample_count * depth_size], depth_size);
+        }
+    }
+    depth_buffer.swap(new_depth_buffer);
+
+    if (sample_count > 1) {
+        sample_colors.resize(pixel_count * sample_count);
+        for (int i = 0; i < pixel_count; i++) {
+            std::fill(sample_colors.begin() + i * sample_count, sample_colors.begin() + (i + 1) * sample_count, color_buffer[i]);
+        }
+    } else {
+        sample_colors = std::vector<Uint32>();
+    }
+
+    this->sample_count = sample_count;
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+int TriangleRasterizer::get_multisampling() const {
+    return sample_count;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::set_perspective_subdivision(int span_length) {
+    if (span_length != 8 && span_length != 16) {
+        span_length = 0;
+    }
+
+    perspective_span_length = span_length;
+    select_kernels();
+}
+
+// --------------------------------------------------------------------------
+
+int TriangleRasterizer::get_perspective_subdivision() const {
+    return perspective_span_length;
+}
+
+// --------------------------------------------------------------------------
+
+const FrameArena& TriangleRasterizer::get_frame_arena() const {
+    return frame_arena;
+}
+
+// --------------------------------------------------------------------------
+
+FrameArena& TriangleRasterizer::get_frame_arena() {
+    return frame_arena;
+}
+
+// --------------------------------------------------------------------------
+
+void TriangleRasterizer::draw_overdraw_heatmap() {
+    if (!is_tracking_overdraw) {
+        return;
+    }
+
+    flush();
+
+    for (size_t i = 0; i < color_buffer.size(); i++) {
+        int color_index = std::min(static_cast<int>(shade_counts[i]), OVERDRAW_HEATMAP_COLOR_COUNT - 1);
+        color_buffer[i] = OVERDRAW_HEATMAP_COLORS[color_index];
+    }
 }
@@ -3,9 +3,14 @@
 
 #include <SDL3/SDL.h>
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 
+#include "FrameArena.h"
+#include "ThreadPool.h"
+#include "raster_kernels.h"
 #include "texture.h"
+#include "vertex_stage.h"
 
 struct Vertex {
     glm::vec2 screen_coord;
@@ -21,29 +26,297 @@ struct Triangle {
     Vertex v2;
 };
 
+// A draw whose pixels are shaded by a fragment shader instead of with the
+// vertex colors or a texture. Each vertex of its triangles carries
+// varying_count floats of varyings, which are interpolated perspective
+// correctly for the shader. The kernels only know what type the shader is,
+// and shader_pipeline.h picks them for the rasterizer's render state.
+struct ShaderDraw {
+    int varying_count;
+    const void* fragment_shader;
+    raster_kernels::ShaderKernel kernel;
+    raster_kernels::ShaderSpanShader resolve_shader;
+};
+
+// Counts of what happened to the triangles and pixels that went through a
+// rasterizer since its stats were last reset. Clipping can split a triangle
+// into several, which are then culled or rasterized one by one, so more
+// triangles can be rasterized than were submitted. Frustum culled triangles
+// include the few that only turn out to be off screen once they are set up.
+struct PipelineStats {
+    Uint64 submitted_triangles;
+    Uint64 frustum_culled_triangles;
+    Uint64 clipped_triangles;
+    Uint64 back_face_culled_triangles;
+    Uint64 zero_area_triangles;
+    Uint64 rasterized_triangles;
+
+    raster_kernels::PixelStats pixels;
+};
+
 class TriangleRasterizer {
 
 public:
 
-    TriangleRasterizer(int depth_buffer_width, int depth_buffer_height);
+    TriangleRasterizer(int buffer_width, int buffer_height);
     ~TriangleRasterizer();
 
-    void rasterize(SDL_Renderer* renderer, const Triangle& triangle, SDL_Surface* texture);
+    // Triangles are only set up and sorted into screen tiles here. Nothing is
+    // drawn until flush() rasterizes every tile in parallel, each tile drawing
+    // its triangles in the order they were submitted.
+    void rasterize(const Triangle& triangle, const texture::Texture* texture);
+    void flush();
+
+    // Like above, but the triangle is shaded the way the draw says, from
+    // the varyings of each of its vertices, and the vertex colors and
+    // texture coordinates are ignored. The fragment shader has to stay
+    // alive until the triangle is flushed.
+    void rasterize(const Triangle& triangle, const float* const (&varyings)[3], const ShaderDraw& shader_draw);
+
+    // Clearing and resizing flush any pending triangles first, so they
+    // still happen in the order they were called. Shrinking the buffers
+    // keeps their memory, so resizing back up to any size they have had
+    // before doesn't allocate, which is what lets the render resolution
+    // change every few frames. Resized buffers must be cleared before use.
+    // Clearing the depth buffer only marks every tile as cleared, and each
+    // tile is actually cleared the next time a triangle is drawn in it.
+    void clear_color_buffer(Uint8 r, Uint8 g, Uint8 b);
     void clear_depth_buffer();
-    void resize_depth_buffer(int new_width, int new_height);
+    void resize_buffers(int new_width, int new_height);
     void set_texture_filter(const texture::TextureFilter texture_filter);
     void set_texture_wrap(const texture::TextureWrap texture_wrap);
 
+    // Both are on by default. Turning off the depth test draws triangles in
+    // the order they were submitted, and turning off depth writes keeps them
+    // from hiding the triangles drawn after them.
+    void set_depth_test(bool is_depth_tested);
+    void set_depth_write(bool is_depth_written);
+
+    // Changing the depth format flushes, and the depth buffer must be
+    // cleared again before it is used. Reversed float depth is computed
+    // from the view space depths and the projection they were projected
+    // with, which draws have to pass in before submitting their triangles.
+    void set_depth_format(const raster_kernels::DepthFormat depth_format);
+    raster_kernels::DepthFormat get_depth_format() const;
+    void set_depth_projection(const glm::mat4& projection);
+
+    // How triangles submitted right now are drawn, which is what the kernels
+    // of draws with a fragment shader are picked for.
+    raster_kernels::RenderState get_render_state() const;
+
+    void set_kernel_type(const raster_kernels::KernelType kernel_type);
+    raster_kernels::KernelType get_kernel_type() const;
+    void set_thread_count(int thread_count);
+    int get_thread_count() const;
+
+    int get_buffer_width() const;
+    int get_buffer_height() const;
+
+    // The color buffer holds one packed RGBA8888 pixel per element, row by row,
+    // so it can be uploaded as-is to an SDL_PIXELFORMAT_RGBA8888 texture.
+    // Call flush() first to make sure every triangle has been drawn.
+    const Uint32* get_color_buffer() const;
+
+    // Trades the color buffer for the given one, which is resized to match
+    // it first, so a finished frame can be handed off without a copy. The
+    // buffer the rasterizer gets back must be cleared before drawing again.
+    void swap_color_buffer(std::vector<Uint32>& buffer);
+
+    // Scratch space for the vertex stage, shared by every draw that goes
+    // through this rasterizer.
+    vertex_stage::TransformedVertices& get_transformed_vertices();
+
+    // The stats keep adding up until they are reset, usually once a frame.
+    // Pixels are only counted when their tiles are rasterized, so call
+    // flush() before reading them. Draws count the triangles they cull
+    // before they get here through the non-const overload.
+    const PipelineStats& get_pipeline_stats() const;
+    PipelineStats& get_pipeline_stats();
+    void reset_pipeline_stats();
+
+    // While overdraw tracking is on, triangles don't shade any colors and
+    // only count how many times every pixel would have been shaded between
+    // clears of the color buffer. draw_overdraw_heatmap() turns those counts
+    // into colors.
+    void set_overdraw_tracking(bool is_tracking_overdraw);
+    bool get_overdraw_tracking() const;
+    void draw_overdraw_heatmap();
+
+    // With deferred shading, triangles only write their depth and which
+    // triangle is visible in each pixel to a visibility buffer. Every tile
+    // then shades each visible pixel exactly once, from the triangle's
+    // interpolated attributes, so hidden pixels never sample a texture. The
+    // pixels end up the same either way. Overdraw tracking takes precedence.
+    void set_deferred_shading(bool is_shading_deferred);
+    bool get_deferred_shading() const;
+
+    // With 2 or 4 samples per pixel, coverage and depth are tested at every
+    // sample, but each triangle still shades a pixel only once, and the
+    // samples are averaged into the color buffer when they are flushed.
+    // Multisampling always uses the scalar kernels, and puts deferred
+    // shading on hold. Any other sample count turns it back off.
+    void set_multisampling(int sample_count);
+    int get_multisampling() const;
+
+    // With a span length of 8 or 16, large triangles only get their colors
+    // and texture coordinates perspective-corrected every that many pixels
+    // along each row, and interpolated linearly in between, which is close
+    // enough to exact unless a triangle is both close and steeply inclined.
+    // Smaller triangles, triangles seen nearly edge on, multisampling,
+    // deferred shading, overdraw tracking and fragment shaders always
+    // correct every pixel. Any other length
+    // turns it off, which is the default.
+    void set_perspective_subdivision(int span_length);
+    int get_perspective_subdivision() const;
+
+    // Binned triangles and the tile bins only live until the next flush, so
+    // they come from an arena that is reset once every tile is rasterized.
+    // Its high water mark is the most memory any single flush has needed.
+    // Draws keep anything their triangles need until then in it too,
+    // through the non-const overload.
+    const FrameArena& get_frame_arena() const;
+    FrameArena& get_frame_arena();
+
 private:
 
-    int depth_buffer_width;
-    int depth_buffer_height;
-    std::vector<float> depth_buffer;
+    // Tiles are a multiple of every kernel's span width, so no span ever
+    // crosses from one tile into another.
+    static const int TILE_SIZE = 64;
+
+    // Triangles whose bounding boxes have at least this many pixels go
+    // through the subdivided kernels, when they are on.
+    static const int LARGE_TRIANGLE_MIN_PIXELS = 32 * 32;
+
+    // State can change between draws without a flush, so every triangle
+    // keeps the kernel it was submitted with. Triangles drawn with a
+    // fragment shader have a shader kernel instead, unless they are only
+    // counting overdraw or recording visibility, which the usual kernels do
+    // just as well. The shader resolve shader is null for every other
+    // triangle.
+    struct BinnedTriangle {
+        TriangleSetup setup;
+        const texture::Texture* texture;
+        raster_kernels::TriangleKernel kernel;
+        raster_kernels::SpanShader resolve_shader;
+        raster_kernels::ShaderBinding shader_binding;
+        raster_kernels::ShaderKernel shader_kernel;
+        raster_kernels::ShaderSpanShader shader_resolve_shader;
+        bool is_depth_tested;
+    };
+
+    // Binned triangles are kept in chunks, found through a table of chunks
+    // that doubles in size when it runs out, so a triangle's index keeps
+    // finding it no matter how many are added after it.
+    static const int BINNED_TRIANGLE_CHUNK_BITS = 8;
+    static const Uint32 BINNED_TRIANGLE_CHUNK_SIZE = 1 << BINNED_TRIANGLE_CHUNK_BITS;
+
+    // Each tile bin is a list of chunks of triangle indices, in the order
+    // the triangles were submitted in.
+    static const int TILE_BIN_CHUNK_SIZE = 60;
+
+    struct TileBinChunk {
+        TileBinChunk* next;
+        int count;
+        Uint32 triangle_indices[TILE_BIN_CHUNK_SIZE];
+    };
+
+    struct TileBin {
+        TileBinChunk* first;
+        TileBinChunk* last;
+    };
+
+    int buffer_width;
+    int buffer_height;
+    std::vector<Uint32> color_buffer;
+
+    // Each depth takes up as many bytes as the depth format needs.
+    raster_kernels::DepthFormat depth_format;
+    std::vector<Uint8> depth_buffer;
+
+    // Reversed depth is offset + scale / view z, which goes from 1 at the
+    // near plane to 0 at the far plane.
+    float reversed_depth_offset;
+    float reversed_depth_scale;
+
+    // The farthest depth in each of the depth buffer's blocks, kept up to
+    // date by the kernels, so hidden triangles can be skipped a block or a
+    // whole tile at a time.
+    int block_columns;
+    int block_rows;
+    std::vector<float> block_max_depth;
 
     texture::TextureFilter texture_filter;
     texture::TextureWrap texture_wrap;
+    bool is_depth_tested;
+    bool is_depth_written;
+
+    // The kernels for the current state, picked again whenever it changes.
+    raster_kernels::KernelType kernel_type;
+    raster_kernels::TriangleKernel untextured_kernel;
+    raster_kernels::TriangleKernel textured_kernel;
+    raster_kernels::SpanShader untextured_resolve_shader;
+    raster_kernels::SpanShader textured_resolve_shader;
+
+    // Null unless large triangles are drawn with perspective subdivision.
+    int perspective_span_length;
+    raster_kernels::TriangleKernel subdivided_untextured_kernel;
+    raster_kernels::TriangleKernel subdivided_textured_kernel;
+
+    // Each tile only ever touches its own pixels of the color and depth
+    // buffers, so the tiles can be rasterized in parallel without locking.
+    int tile_columns;
+    int tile_rows;
+    FrameArena frame_arena;
+    BinnedTriangle** binned_triangle_chunks;
+    Uint32 binned_triangle_chunk_capacity;
+    Uint32 binned_triangle_count;
+    std::vector<TileBin> tile_bins;
+
+    // Each tile counts its own pixels, and the counts are added up once
+    // every tile is done.
+    std::vector<raster_kernels::PixelStats> tile_pixel_stats;
+
+    // Tiles whose depth still has to be cleared before anything is drawn in
+    // them. Every tile only ever touches its own flag.
+    std::vector<Uint8> is_tile_depth_clear_pending;
+    PipelineStats pipeline_stats;
+
+    bool is_tracking_overdraw;
+    std::vector<Uint16> shade_counts;
+
+    // Every pixel is back to zero once its tile has been resolved, so the
+    // ids only ever refer to the triangles of the flush in progress.
+    bool is_shading_deferred;
+    std::vector<Uint32> visibility_buffer;
+
+    // The depth buffer holds one depth per sample, and each sample's color
+    // is kept here until it is averaged into the color buffer.
+    int sample_count;
+    std::vector<Uint32> sample_colors;
+
+    std::unique_ptr<ThreadPool> thread_pool;
+
+    vertex_stage::TransformedVertices transformed_vertices;
+
+    void select_kernels();
+    BinnedTriangle& add_binned_triangle();
+    const BinnedTriangle& get_binned_triangle(Uint32 triangle_index) const;
+    void add_to_tile_bin(TileBin& tile_bin, Uint32 triangle_index);
+    BinnedTriangle& bin_triangle(const TriangleSetup& setup);
 
-    float edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p);
+    // The varyings are only set up for triangles drawn with a fragment
+    // shader, in place of the vertex colors and texture coordinates.
+    bool setup_triangle(const Triangle& triangle,
+                        const float* const* varyings,
+                        int varying_count,
+                        TriangleSetup& setup,
+                        AttributePlane* varying_planes);
+    float get_vertex_depth(const Vertex& vertex) const;
+    void clear_tile_depth(const raster_kernels::PixelRect& tile_rect);
+    void rasterize_tile(int tile_index, const raster_kernels::RenderTarget& target);
+    void resolve_tile(const raster_kernels::PixelRect& tile_rect, const raster_kernels::RenderTarget& target, raster_kernels::PixelStats& pixel_stats);
+    void resolve_samples(const raster_kernels::PixelRect& tile_rect);
+    float max_depth_in_tile(const raster_kernels::PixelRect& tile_rect) const;
 };
 
 #endif
\ No newline at end of file
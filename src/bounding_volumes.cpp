@@ -0,0 +1,98 @@
+#include "bounding_volumes.h"
+
+// --------------------------------------------------------------------------
+
+bool bounding_volumes::is_empty(const BoundingBox& box) {
+    return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+// --------------------------------------------------------------------------
+
+void bounding_volumes::grow_to_include(BoundingBox& box, const glm::vec3& point) {
+    box.min = glm::min(box.min, point);
+    box.max = glm::max(box.max, point);
+}
+
+// --------------------------------------------------------------------------
+
+void bounding_volumes::grow_to_include(BoundingBox& box, const BoundingBox& other) {
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+// --------------------------------------------------------------------------
+
+bounding_volumes::BoundingBox bounding_volumes::transform_box(const BoundingBox& box, const glm::mat4& matrix) {
+    if (is_empty(box)) {
+        return box;
+    }
+
+    // Each matrix column contributes to the result's extents independently,
+    // so the new box can be built up from the old one's corners one axis at
+    // a time instead of transforming all eight of them.
+    BoundingBox result;
+    result.min = glm::vec3(matrix[3]);
+    result.max = glm::vec3(matrix[3]);
+
+    for (int column = 0; column < 3; column++) {
+        glm::vec3 axis = glm::vec3(matrix[column]);
+        glm::vec3 a = axis * box.min[column];
+        glm::vec3 b = axis * box.max[column];
+
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+
+bounding_volumes::Frustum bounding_volumes::extract_frustum(const glm::mat4& view_projection) {
+    // A point is inside the frustum when -w <= x, y, z <= w in clip space,
+    // and each of those six inequalities is a plane in the original space.
+    glm::vec4 row_x = glm::vec4(view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]);
+    glm::vec4 row_y = glm::vec4(view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]);
+    glm::vec4 row_z = glm::vec4(view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]);
+    glm::vec4 row_w = glm::vec4(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row_w + row_x;
+    frustum.planes[1] = row_w - row_x;
+    frustum.planes[2] = row_w + row_y;
+    frustum.planes[3] = row_w - row_y;
+    frustum.planes[4] = row_w + row_z;
+    frustum.planes[5] = row_w - row_z;
+
+    return frustum;
+}
+
+// --------------------------------------------------------------------------
+
+bool bounding_volumes::intersects_frustum(const Frustum& frustum, const BoundingBox& box, int& plane_mask) {
+    for (int i = 0; i < 6; i++) {
+        if ((plane_mask & (1 << i)) == 0) {
+            continue;
+        }
+
+        const glm::vec4& plane = frustum.planes[i];
+
+        // The corners that are farthest along and against the plane's normal.
+        glm::vec3 farthest_corner = glm::vec3(plane.x >= 0.0f ? box.max.x : box.min.x,
+                                              plane.y >= 0.0f ? box.max.y : box.min.y,
+                                              plane.z >= 0.0f ? box.max.z : box.min.z);
+        glm::vec3 nearest_corner = glm::vec3(plane.x >= 0.0f ? box.min.x : box.max.x,
+                                             plane.y >= 0.0f ? box.min.y : box.max.y,
+                                             plane.z >= 0.0f ? box.min.z : box.max.z);
+
+        if (glm::dot(glm::vec3(plane), farthest_corner) + plane.w < 0.0f) {
+            return false;
+        }
+
+        if (glm::dot(glm::vec3(plane), nearest_corner) + plane.w >= 0.0f) {
+            plane_mask &= ~(1 << i);
+        }
+    }
+
+    return true;
+}
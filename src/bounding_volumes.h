@@ -0,0 +1,41 @@
+#ifndef BOUNDING_VOLUMES_H
+#define BOUNDING_VOLUMES_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+namespace bounding_volumes {
+    // An axis-aligned bounding box. A default constructed box is empty, with
+    // its minimum above its maximum, so that growing it to include a point
+    // just works.
+    struct BoundingBox {
+        glm::vec3 min = glm::vec3(INFINITY);
+        glm::vec3 max = glm::vec3(-INFINITY);
+    };
+
+    // The six planes of a view frustum, each given as the coefficients of a
+    // signed distance dot(plane, vec4(position, 1)) that is negative outside.
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Every plane of the frustum in its own bit, all of them set.
+    static const int ALL_FRUSTUM_PLANES = (1 << 6) - 1;
+
+    bool is_empty(const BoundingBox& box);
+    void grow_to_include(BoundingBox& box, const glm::vec3& point);
+    void grow_to_include(BoundingBox& box, const BoundingBox& other);
+
+    // The box around the transformed box, which is usually somewhat bigger.
+    BoundingBox transform_box(const BoundingBox& box, const glm::mat4& matrix);
+
+    Frustum extract_frustum(const glm::mat4& view_projection);
+
+    // Tests the box against the planes whose bits are set in plane_mask.
+    // Returns false if the box is entirely outside any one of them, and
+    // otherwise clears the bits of the planes it is entirely inside of, since
+    // anything within the box doesn't need to be tested against those again.
+    bool intersects_frustum(const Frustum& frustum, const BoundingBox& box, int& plane_mask);
+};
+
+#endif
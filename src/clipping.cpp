@@ -0,0 +1,116 @@
+#include "clipping.h"
+
+#include <algorithm>
+
+// A clip space plane, given as the coefficients of the signed distance
+// dot(plane, position). Positions with a negative distance are outside.
+typedef glm::vec4 ClipPlane;
+
+// --------------------------------------------------------------------------
+
+static float distance_to_plane(const ClipPlane& plane, const glm::vec4& position) {
+    return plane.x * position.x + plane.y * position.y + plane.z * position.z + plane.w * position.w;
+}
+
+// --------------------------------------------------------------------------
+
+// The point where the edge from the inside vertex to the outside vertex
+// crosses the plane. Always going from the inside vertex means that two
+// triangles sharing an edge get the exact same new vertex on it.
+static clipping::ClipVertex intersect_edge(const clipping::ClipVertex& inside,
+                                           const clipping::ClipVertex& outside,
+                                           float inside_distance,
+                                           float outside_distance,
+                                           const vertex_stage::Viewport& viewport) {
+
+    float t = inside_distance / (inside_distance - outside_distance);
+
+    // Everything that is linear in clip space can be interpolated along the
+    // edge as-is. The screen-space quantities have to be projected again.
+    clipping::ClipVertex result;
+    result.clip_position = inside.clip_position + (outside.clip_position - inside.clip_position) * t;
+    result.vertex.color = inside.vertex.color + (outside.vertex.color - inside.vertex.color) * t;
+    result.vertex.tex_coord = inside.vertex.tex_coord + (outside.vertex.tex_coord - inside.vertex.tex_coord) * t;
+    result.vertex.view_z = inside.vertex.view_z + (outside.vertex.view_z - inside.vertex.view_z) * t;
+    result.weights = inside.weights + (outside.weights - inside.weights) * t;
+
+    vertex_stage::project_to_viewport(result.clip_position, viewport, result.vertex.screen_coord, result.vertex.ndc_z);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+
+// One step of Sutherland-Hodgman: keeps the part of the polygon that is on
+// the inside of the plane, and returns how many vertices that took.
+static int clip_polygon_to_plane(const clipping::ClipVertex* input,
+                                 int input_count,
+                                 const ClipPlane& plane,
+                                 const vertex_stage::Viewport& viewport,
+                                 clipping::ClipVertex* output) {
+
+    int output_count = 0;
+
+    for (int i = 0; i < input_count; i++) {
+        const clipping::ClipVertex& current = input[i];
+        const clipping::ClipVertex& next = input[(i + 1) % input_count];
+
+        float current_distance = distance_to_plane(plane, current.clip_position);
+        float next_distance = distance_to_plane(plane, next.clip_position);
+        bool is_current_inside = current_distance >= 0.0f;
+        bool is_next_inside = next_distance >= 0.0f;
+
+        if (is_current_inside) {
+            output[output_count++] = current;
+        }
+
+        if (is_current_inside && !is_next_inside) {
+            output[output_count++] = intersect_edge(current, next, current_distance, next_distance, viewport);
+        } else if (!is_current_inside && is_next_inside) {
+            output[output_count++] = intersect_edge(next, current, next_distance, current_distance, viewport);
+        }
+    }
+
+    return output_count;
+}
+
+// --------------------------------------------------------------------------
+
+int clipping::clip_triangle(const ClipVertex (&triangle)[3],
+                            Uint8 clip_flags,
+                            const vertex_stage::Viewport& viewport,
+                            ClipVertex (&polygon)[MAX_POLYGON_VERTICES]) {
+
+    // The near plane has to come first, since projecting the new vertices
+    // only makes sense once everything behind the camera is gone.
+    ClipPlane planes[6];
+    int plane_count = 0;
+
+    planes[plane_count++] = ClipPlane(0.0f, 0.0f, 1.0f, 1.0f);
+    planes[plane_count++] = ClipPlane(0.0f, 0.0f, -1.0f, 1.0f);
+
+    if ((clip_flags & vertex_stage::CLIP_GUARD_BAND) != 0) {
+        planes[plane_count++] = ClipPlane(1.0f, 0.0f, 0.0f, viewport.guard_band_x);
+        planes[plane_count++] = ClipPlane(-1.0f, 0.0f, 0.0f, viewport.guard_band_x);
+        planes[plane_count++] = ClipPlane(0.0f, 1.0f, 0.0f, viewport.guard_band_y);
+        planes[plane_count++] = ClipPlane(0.0f, -1.0f, 0.0f, viewport.guard_band_y);
+    }
+
+    ClipVertex scratch[MAX_POLYGON_VERTICES];
+    ClipVertex* input = polygon;
+    ClipVertex* output = scratch;
+
+    std::copy(triangle, triangle + 3, polygon);
+    int vertex_count = 3;
+
+    for (int i = 0; i < plane_count && vertex_count >= 3; i++) {
+        vertex_count = clip_polygon_to_plane(input, vertex_count, planes[i], viewport, output);
+        std::swap(input, output);
+    }
+
+    if (input != polygon) {
+        std::copy(input, input + vertex_count, polygon);
+    }
+
+    return vertex_count;
+}
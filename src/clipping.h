@@ -0,0 +1,37 @@
+#ifndef CLIPPING_H
+#define CLIPPING_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+
+#include "TriangleRasterizer.h"
+#include "vertex_stage.h"
+
+namespace clipping {
+    // A vertex's clip space position along with everything the rasterizer
+    // needs from it. Vertices that make it through the clipper untouched keep
+    // their screen coordinates, and the ones it creates get projected anew.
+    // The weights say how much of each of the original triangle's vertices
+    // went into it, so anything else the vertices carry, like the varyings
+    // of a fragment shader, can be blended the same way afterwards.
+    struct ClipVertex {
+        glm::vec4 clip_position;
+        Vertex vertex;
+        glm::vec3 weights;
+    };
+
+    // Each plane can add at most one vertex to the polygon, and a triangle
+    // is clipped against at most six of them.
+    static const int MAX_POLYGON_VERTICES = 3 + 6;
+
+    // Clips the triangle against the near and far planes, and also against
+    // the guard band if clip_flags has CLIP_GUARD_BAND set. The result is a
+    // convex polygon with the same winding, and the number of vertices in it
+    // is returned. Anything less than three means nothing is left to draw.
+    int clip_triangle(const ClipVertex (&triangle)[3],
+                      Uint8 clip_flags,
+                      const vertex_stage::Viewport& viewport,
+                      ClipVertex (&polygon)[MAX_POLYGON_VERTICES]);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "lighting.h"
+
+// --------------------------------------------------------------------------
+
+static glm::mat3 make_normal_matrix(const glm::mat4& model_view) {
+    return glm::transpose(glm::inverse(glm::mat3(model_view)));
+}
+
+// --------------------------------------------------------------------------
+
+static glm::vec3 to_light_in_view_space(const lighting::Light& light, const glm::mat4& view) {
+    return glm::normalize(glm::mat3(view) * -light.direction);
+}
+
+// --------------------------------------------------------------------------
+
+// Calls draw_lit() with the surface for the draw's texture and the
+// rasterizer's sampler state, which instantiates the lit shaders for every
+// one of them.
+template<texture::TextureFilter FILTER, typename LitDraw>
+static void draw_with_texture_surface(const texture::Texture* texture, const texture::TextureWrap texture_wrap, LitDraw draw_lit) {
+    if (texture_wrap == texture::TextureWrap::CLAMP) {
+        draw_lit(lighting::TextureSurface<FILTER, texture::TextureWrap::CLAMP>{ texture });
+    } else {
+        draw_lit(lighting::TextureSurface<FILTER, texture::TextureWrap::REPEAT>{ texture });
+    }
+}
+
+// --------------------------------------------------------------------------
+
+template<typename LitDraw>
+static void draw_with_surface(const TriangleRasterizer& triangle_rasterizer, const texture::Texture* texture, LitDraw draw_lit) {
+    if (texture == nullptr) {
+        draw_lit(lighting::VertexColorSurface());
+        return;
+    }
+
+    raster_kernels::RenderState render_state = triangle_rasterizer.get_render_state();
+    switch (render_state.texture_filter) {
+        case texture::TextureFilter::BILINEAR:
+            draw_with_texture_surface<texture::TextureFilter::BILINEAR>(texture, render_state.texture_wrap, draw_lit);
+            break;
+
+        case texture::TextureFilter::NEAREST_MIPMAP:
+            draw_with_texture_surface<texture::TextureFilter::NEAREST_MIPMAP>(texture, render_state.texture_wrap, draw_lit);
+            break;
+
+        case texture::TextureFilter::TRILINEAR:
+            draw_with_texture_surface<texture::TextureFilter::TRILINEAR>(texture, render_state.texture_wrap, draw_lit);
+            break;
+
+        default:
+            draw_with_texture_surface<texture::TextureFilter::NEAREST>(texture, render_state.texture_wrap, draw_lit);
+            break;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+static void draw_lambert(TriangleRasterizer& triangle_rasterizer,
+                         const Object& object,
+                         const texture::Texture* texture,
+                         const glm::mat4& projection,
+                         const glm::mat4& view,
+                         const glm::mat4& model,
+                         const void* context) {
+
+    const lighting::Light& light = *static_cast<const lighting::Light*>(context);
+
+    lighting::LambertVertexShader vertex_shader;
+    vertex_shader.normal_matrix = make_normal_matrix(view * model);
+
+    draw_with_surface(triangle_rasterizer, texture, [&](auto surface) {
+        lighting::LambertFragmentShader<decltype(surface)> fragment_shader;
+        fragment_shader.surface = surface;
+        fragment_shader.to_light = to_light_in_view_space(light, view);
+        fragment_shader.light_color = light.color;
+        fragment_shader.ambient_color = light.ambient_color;
+
+        shader_pipeline::draw(triangle_rasterizer, object, vertex_shader, fragment_shader, projection, view, model);
+    });
+}
+
+// --------------------------------------------------------------------------
+
+static void draw_phong(TriangleRasterizer& triangle_rasterizer,
+                       const Object& object,
+                       const texture::Texture* texture,
+                       const glm::mat4& projection,
+                       const glm::mat4& view,
+                       const glm::mat4& model,
+                       const void* context) {
+
+    const lighting::Light& light = *static_cast<const lighting::Light*>(context);
+
+    lighting::PhongVertexShader vertex_shader;
+    vertex_shader.model_view = view * model;
+    vertex_shader.normal_matrix = make_normal_matrix(vertex_shader.model_view);
+
+    draw_with_surface(triangle_rasterizer, texture, [&](auto surface) {
+        lighting::PhongFragmentShader<decltype(surface)> fragment_shader;
+        fragment_shader.surface = surface;
+        fragment_shader.to_light = to_light_in_view_space(light, view);
+        fragment_shader.light_color = light.color;
+        fragment_shader.ambient_color = light.ambient_color;
+        fragment_shader.specular_strength = light.specular_strength;
+        fragment_shader.shininess = light.shininess;
+
+        shader_pipeline::draw(triangle_rasterizer, object, vertex_shader, fragment_shader, projection, view, model);
+    });
+}
+
+// --------------------------------------------------------------------------
+
+lighting::Light lighting::default_light() {
+    Light light;
+    light.direction = glm::vec3(-0.4f, -1.0f, -0.6f);
+    light.color = glm::vec3(0.85f);
+    light.ambient_color = glm::vec3(0.15f);
+    light.specular_strength = 0.5f;
+    light.shininess = 32.0f;
+
+    return light;
+}
+
+// --------------------------------------------------------------------------
+
+const char* lighting::lighting_model_name(const LightingModel lighting_model) {
+    switch (lighting_model) {
+        case LightingModel::LAMBERT:
+            return "Lambert";
+
+        case LightingModel::PHONG:
+            return "Phong";
+
+        default:
+            return "unlit";
+    }
+}
+
+// --------------------------------------------------------------------------
+
+RenderQueue::DrawFunction lighting::get_draw_function(const LightingModel lighting_model) {
+    switch (lighting_model) {
+        case LightingModel::LAMBERT:
+            return draw_lambert;
+
+        case LightingModel::PHONG:
+            return draw_phong;
+
+        default:
+            return nullptr;
+    }
+}
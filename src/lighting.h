@@ -0,0 +1,152 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "RenderQueue.h"
+#include "shader_pipeline.h"
+#include "texture.h"
+
+// Lambert and Phong lighting as shaders for shader_pipeline.h, with a single
+// directional light. Everything is lit in view space, where the camera is
+// at the origin. Like in unlit draws, surfaces are the color of the draw's
+// texture, sampled with the rasterizer's sampler state, or of their
+// vertices when the draw has no texture.
+namespace lighting {
+    enum class LightingModel {
+        UNLIT,
+        LAMBERT,
+        PHONG,
+    };
+
+    // The direction is the one the light travels in, in world space. The
+    // ambient light reaches every surface from everywhere, and only Phong
+    // lighting has highlights.
+    struct Light {
+        glm::vec3 direction;
+        glm::vec3 color;
+        glm::vec3 ambient_color;
+        float specular_strength;
+        float shininess;
+    };
+
+    Light default_light();
+
+    const char* lighting_model_name(const LightingModel lighting_model);
+
+    // Draws for RenderQueue::execute(), which take a const Light* as their
+    // context. Unlit draws are the queue's own, so there is none for them.
+    RenderQueue::DrawFunction get_draw_function(const LightingModel lighting_model);
+
+    // ----------------------------------------------------------------------
+
+    // What color a surface is before it is lit, from the varyings' color and
+    // tex_coord. The texture's filter and wrap mode are template arguments,
+    // like they are in the kernels.
+    struct VertexColorSurface {
+        template<typename Varyings>
+        glm::vec3 operator()(const Varyings& varyings, const shader_pipeline::Fragment&) const {
+            return varyings.color;
+        }
+    };
+
+    template<texture::TextureFilter FILTER, texture::TextureWrap WRAP>
+    struct TextureSurface {
+        const texture::Texture* texture;
+
+        template<typename Varyings>
+        glm::vec3 operator()(const Varyings& varyings, const shader_pipeline::Fragment& fragment) const {
+            float lod = 0.0f;
+            if constexpr (FILTER == texture::TextureFilter::NEAREST_MIPMAP || FILTER == texture::TextureFilter::TRILINEAR) {
+                lod = shader_pipeline::texture_lod(fragment, *texture, offsetof(Varyings, tex_coord) / sizeof(float));
+            }
+
+            return texture->sample<FILTER, WRAP>(varyings.tex_coord, lod);
+        }
+    };
+
+    // ----------------------------------------------------------------------
+
+    struct LambertVaryings {
+        glm::vec3 normal;
+        glm::vec3 color;
+        glm::vec2 tex_coord;
+    };
+
+    struct LambertVertexShader {
+        typedef LambertVaryings Varyings;
+
+        // Takes normals from object space to view space.
+        glm::mat3 normal_matrix;
+
+        Varyings operator()(const shader_pipeline::VertexInput& input) const {
+            return { normal_matrix * input.normal, input.color, input.tex_coord };
+        }
+    };
+
+    template<typename Surface>
+    struct LambertFragmentShader {
+        typedef LambertVaryings Varyings;
+
+        Surface surface;
+
+        // Normalized, and pointing from the surfaces towards the light.
+        glm::vec3 to_light;
+        glm::vec3 light_color;
+        glm::vec3 ambient_color;
+
+        glm::vec3 operator()(const Varyings& varyings, const shader_pipeline::Fragment& fragment) const {
+            glm::vec3 normal = glm::normalize(varyings.normal);
+            float diffuse = std::max(glm::dot(normal, to_light), 0.0f);
+
+            return surface(varyings, fragment) * (ambient_color + light_color * diffuse);
+        }
+    };
+
+    struct PhongVaryings {
+        glm::vec3 normal;
+        glm::vec3 view_position;
+        glm::vec3 color;
+        glm::vec2 tex_coord;
+    };
+
+    struct PhongVertexShader {
+        typedef PhongVaryings Varyings;
+
+        glm::mat3 normal_matrix;
+        glm::mat4 model_view;
+
+        Varyings operator()(const shader_pipeline::VertexInput& input) const {
+            return { normal_matrix * input.normal, glm::vec3(model_view * glm::vec4(input.position, 1.0f)), input.color, input.tex_coord };
+        }
+    };
+
+    template<typename Surface>
+    struct PhongFragmentShader {
+        typedef PhongVaryings Varyings;
+
+        Surface surface;
+
+        glm::vec3 to_light;
+        glm::vec3 light_color;
+        glm::vec3 ambient_color;
+        float specular_strength;
+        float shininess;
+
+        glm::vec3 operator()(const Varyings& varyings, const shader_pipeline::Fragment& fragment) const {
+            glm::vec3 normal = glm::normalize(varyings.normal);
+            float diffuse = std::max(glm::dot(normal, to_light), 0.0f);
+
+            glm::vec3 to_camera = glm::normalize(-varyings.view_position);
+            glm::vec3 reflected_light = glm::reflect(-to_light, normal);
+            float specular = diffuse > 0.0f ? std::pow(std::max(glm::dot(reflected_light, to_camera), 0.0f), shininess) : 0.0f;
+
+            return surface(varyings, fragment) * (ambient_color + light_color * diffuse) + light_color * (specular_strength * specular);
+        }
+    };
+};
+
+#endif
@@ -3,18 +3,49 @@
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
 
+#include "DynamicResolution.h"
+#include "FramePipeline.h"
+#include "RenderQueue.h"
+#include "Scene.h"
 #include "TriangleRasterizer.h"
+#include "lighting.h"
 #include "primitives.h"
 #include "texture.h"
 
 SDL_Window* window = nullptr;
 SDL_Renderer* renderer = nullptr;
-SDL_Texture* target_texture = nullptr;
+SDL_Texture* framebuffer_texture = nullptr;
 SDL_Surface* texture_surface = nullptr;
 
+// Everything the render thread needs to know from the main thread to render
+// a frame. The main thread updates it as keys are pressed, and the render
+// thread takes a copy of it at the start of every frame.
+struct DemoSettings {
+    bool is_paused;
+    bool is_rasterizing_textures;
+    bool is_upscaling;
+    texture::TextureFilter texture_filter;
+    texture::TextureWrap texture_wrap;
+    raster_kernels::KernelType kernel_type;
+    int thread_count;
+    bool is_tracking_overdraw;
+    bool is_shading_deferred;
+    int sample_count;
+    raster_kernels::DepthFormat depth_format;
+    int perspective_span_length;
+    lighting::LightingModel lighting_model;
+    bool is_scaling_resolution;
+    int window_width;
+    int window_height;
+};
+
 // --------------------------------------------------------------------------
 
 void fit_inner_rect_within_outer_rect(const SDL_FRect& inner_rect, const SDL_FRect& outer_rect, SDL_FRect& result) {
@@ -40,13 +71,84 @@ void fit_inner_rect_within_outer_rect(const SDL_FRect& inner_rect, const SDL_FRe
 
 // --------------------------------------------------------------------------
 
+// The texture only gets recreated when it's too small, since with dynamic
+// resolution the rendered size can change every few frames. Only the
+// top left corner of it is used then.
+bool recreate_framebuffer_texture(int width, int height) {
+    if (framebuffer_texture != nullptr) {
+        if (framebuffer_texture->w >= width && framebuffer_texture->h >= height) {
+            return true;
+        }
+
+        width = std::max(width, framebuffer_texture->w);
+        height = std::max(height, framebuffer_texture->h);
+
+        SDL_DestroyTexture(framebuffer_texture);
+    }
+
+    framebuffer_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (framebuffer_texture == nullptr) {
+        std::cerr << "[ERROR] SDL_CreateTexture error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+void upload_color_buffer(const RenderedFrame& frame) {
+    const Uint32* color_buffer = frame.color_buffer.data();
+    int buffer_width = frame.width;
+    int buffer_height = frame.height;
+
+    // When the color buffer is smaller than the texture, its last column and
+    // row are copied once more past its edges, so that filtering while
+    // upscaling doesn't blend in whatever an older, bigger frame left there.
+    bool is_padding_column = buffer_width < framebuffer_texture->w;
+    bool is_padding_row = buffer_height < framebuffer_texture->h;
+
+    SDL_Rect locked_rect = { 0, 0, buffer_width + (is_padding_column ? 1 : 0), buffer_height + (is_padding_row ? 1 : 0) };
+    void* texture_pixels;
+    int texture_pitch;
+    if (!SDL_LockTexture(framebuffer_texture, &locked_rect, &texture_pixels, &texture_pitch)) {
+        std::cerr << "[ERROR] SDL_LockTexture error: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    // The texture rows may be padded, so we can only do one big copy
+    // when the pitch matches the color buffer's row size exactly.
+    int row_size = buffer_width * sizeof(Uint32);
+    if (texture_pitch == row_size) {
+        std::memcpy(texture_pixels, color_buffer, row_size * buffer_height);
+    } else {
+        for (int y = 0; y < buffer_height; y++) {
+            Uint32* texture_row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(texture_pixels) + y * texture_pitch);
+            std::memcpy(texture_row, color_buffer + y * buffer_width, row_size);
+
+            if (is_padding_column) {
+                texture_row[buffer_width] = texture_row[buffer_width - 1];
+            }
+        }
+    }
+
+    if (is_padding_row) {
+        Uint8* last_row = static_cast<Uint8*>(texture_pixels) + (buffer_height - 1) * texture_pitch;
+        std::memcpy(last_row + texture_pitch, last_row, locked_rect.w * sizeof(Uint32));
+    }
+
+    SDL_UnlockTexture(framebuffer_texture);
+}
+
+// --------------------------------------------------------------------------
+
 void cleanup() {
     if (texture_surface != nullptr) {
         SDL_DestroySurface(texture_surface);
     }
 
-    if (target_texture != nullptr) {
-        SDL_DestroyTexture(target_texture);
+    if (framebuffer_texture != nullptr) {
+        SDL_DestroyTexture(framebuffer_texture);
     }
 
     if (renderer != nullptr) {
@@ -89,9 +191,7 @@ int main() {
         return 1;
     }
 
-    target_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT);
-    if (target_texture == nullptr) {
-        std::cerr << "[ERROR] SDL_CreateTexture error: " << SDL_GetError() << std::endl;
+    if (!recreate_framebuffer_texture(INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT)) {
         cleanup();
         return 1;
     }
@@ -116,38 +216,197 @@ int main() {
         }
     }
 
+    // The pixels are decoded once here, so the surface isn't needed after this.
+    texture::Texture test_texture(texture_surface);
+    SDL_DestroySurface(texture_surface);
+    texture_surface = nullptr;
+
     SDL_SetRenderVSync(renderer, 1);
 
     TriangleRasterizer triangle_rasterizer(INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT);
 
-    Object big_cube = primitives::cuboid(2.0f, 2.0f, 2.0f, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f);
-    Object small_cube = primitives::cuboid(0.5f, 0.5f, 0.5f, glm::vec3(1.0f, 0.0f, 0.0f), 1.0f);
+    Scene scene;
+    int big_cube_id = scene.add_object(primitives::cuboid(2.0f, 2.0f, 2.0f, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f), &test_texture, glm::mat4(1.0f));
+    int small_cube_id = scene.add_object(primitives::cuboid(0.5f, 0.5f, 0.5f, glm::vec3(1.0f, 0.0f, 0.0f), 1.0f), &test_texture, glm::mat4(1.0f));
+
+    RenderQueue render_queue;
 
     glm::vec3 camera_position = glm::vec3(0.0f, 0.0f, 5.0f);
 
     const bool* keyboard_state = SDL_GetKeyboardState(nullptr);
 
-    bool is_paused = false;
-    bool previous_toggle_pause_key_state = false;
+    DemoSettings settings;
+    settings.is_paused = false;
+    settings.is_rasterizing_textures = true;
+    settings.is_upscaling = true;
+    settings.texture_filter = texture::TextureFilter::NEAREST;
+    settings.texture_wrap = texture::TextureWrap::REPEAT;
+    settings.kernel_type = triangle_rasterizer.get_kernel_type();
+    settings.thread_count = triangle_rasterizer.get_thread_count();
+    settings.is_tracking_overdraw = false;
+    settings.is_shading_deferred = false;
+    settings.sample_count = 1;
+    settings.depth_format = raster_kernels::DepthFormat::FLOAT;
+    settings.perspective_span_length = 0;
+    settings.lighting_model = lighting::LightingModel::UNLIT;
+    settings.is_scaling_resolution = false;
+    settings.window_width = INITIAL_WINDOW_WIDTH;
+    settings.window_height = INITIAL_WINDOW_HEIGHT;
+
+    // The render thread's copy of the settings, as of the last time the main
+    // thread handled its input.
+    DemoSettings shared_settings = settings;
+    std::mutex settings_mutex;
 
-    bool is_rasterizing_textures = true;
+    bool previous_toggle_pause_key_state = false;
     bool previous_texture_rasterization_toggle_key_state = false;
-
-    bool is_upscaling = true;
     bool previous_upscale_toggle_key_state = false;
-    SDL_FRect target_texture_rect = { 0, 0, INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT };
-
-    texture::TextureFilter texture_filter = texture::TextureFilter::NEAREST;
     bool previous_change_texture_filter_key_state = false;
-
-    texture::TextureWrap texture_wrap = texture::TextureWrap::REPEAT;
     bool previous_change_texture_wrap_key_state = false;
+    bool previous_change_kernel_key_state = false;
+    bool previous_toggle_overdraw_heatmap_key_state = false;
+    bool previous_toggle_deferred_shading_key_state = false;
+    bool previous_change_multisampling_key_state = false;
+    bool previous_change_depth_format_key_state = false;
+    bool previous_change_perspective_subdivision_key_state = false;
+    bool previous_change_lighting_key_state = false;
+    bool previous_toggle_dynamic_resolution_key_state = false;
+
+    const int MAX_THREAD_COUNT = triangle_rasterizer.get_thread_count();
+    bool previous_toggle_multithreading_key_state = false;
+
+    // --- render thread ---
+
+    // Everything in here is only touched by the render thread once the
+    // pipeline has started, apart from the settings it copies.
+    const float TARGET_FRAME_MILLISECONDS = 1000.0f / 60.0f;
+    DynamicResolution dynamic_resolution(TARGET_FRAME_MILLISECONDS);
+    bool was_scaling_resolution = false;
 
     const float ROTATION_DEGREES_Y_PER_SECOND = 360.0f / 8.0f;
     const float ROTATION_DEGREES_X_PER_SECOND = 360.0f / 16.0f;
     float rotation_degrees_y = 0.0f;
     float rotation_degrees_x = 0.0f;
 
+    const lighting::Light light = lighting::default_light();
+
+    Uint64 previous_render_timestamp = SDL_GetTicks();
+
+    std::function<void(RenderedFrame&)> render_frame = [&](RenderedFrame& frame) {
+        DemoSettings frame_settings;
+        {
+            std::lock_guard<std::mutex> lock(settings_mutex);
+            frame_settings = shared_settings;
+        }
+
+        Uint64 current_timestamp = SDL_GetTicks();
+        float delta_time = (current_timestamp - previous_render_timestamp) / 1000.0f;
+        previous_render_timestamp = current_timestamp;
+
+        if (!frame_settings.is_paused) {
+            rotation_degrees_y += ROTATION_DEGREES_Y_PER_SECOND * delta_time;
+            rotation_degrees_x += ROTATION_DEGREES_X_PER_SECOND * delta_time;
+        }
+
+        // Only the time spent rendering counts towards the frame time, since
+        // waiting for a frame to be presented would make every frame look
+        // like it took as long as the whole refresh interval.
+        Uint64 render_start_counter = SDL_GetPerformanceCounter();
+
+        if (frame_settings.kernel_type != triangle_rasterizer.get_kernel_type()) {
+            triangle_rasterizer.set_kernel_type(frame_settings.kernel_type);
+        }
+        triangle_rasterizer.set_thread_count(frame_settings.thread_count);
+        triangle_rasterizer.set_overdraw_tracking(frame_settings.is_tracking_overdraw);
+        triangle_rasterizer.set_deferred_shading(frame_settings.is_shading_deferred);
+        triangle_rasterizer.set_multisampling(frame_settings.sample_count);
+        triangle_rasterizer.set_depth_format(frame_settings.depth_format);
+        triangle_rasterizer.set_perspective_subdivision(frame_settings.perspective_span_length);
+
+        if (frame_settings.is_scaling_resolution != was_scaling_resolution) {
+            dynamic_resolution.reset();
+            was_scaling_resolution = frame_settings.is_scaling_resolution;
+        }
+
+        int full_render_width = std::max(frame_settings.window_width, 1);
+        int full_render_height = std::max(frame_settings.window_height, 1);
+        if (frame_settings.is_upscaling) {
+            full_render_width = INITIAL_WINDOW_WIDTH;
+            full_render_height = INITIAL_WINDOW_HEIGHT;
+        }
+
+        int render_width, render_height;
+        dynamic_resolution.get_render_size(full_render_width, full_render_height, render_width, render_height);
+
+        // The aspect ratio is the full size's, since rounding the scaled
+        // down size would make the picture wobble as the scale changes.
+        glm::mat4 projection = glm::perspective(
+            glm::radians(45.0f),
+            static_cast<float>(full_render_width) / full_render_height,
+            0.1f,
+            100.0f
+        );
+
+        glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        glm::mat4 rotation_x = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_x), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::mat4 rotation_y = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_y), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 model_rotation = rotation_x * rotation_y;
+
+        glm::mat4 big_cube_translation = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 0.0f, 0.0f));
+        scene.set_model(big_cube_id, big_cube_translation * model_rotation);
+
+        glm::mat4 small_cube_translation = glm::translate(glm::mat4(1.0), glm::vec3(1.75f, 0.0f, 0.0f));
+        scene.set_model(small_cube_id, small_cube_translation * model_rotation);
+
+        const texture::Texture* render_texture = nullptr;
+        if (frame_settings.is_rasterizing_textures) {
+            render_texture = &test_texture;
+        }
+
+        scene.set_texture(big_cube_id, render_texture);
+        scene.set_texture(small_cube_id, render_texture);
+
+        texture::SamplerState sampler_state = { frame_settings.texture_filter, frame_settings.texture_wrap };
+        scene.set_sampler_state(big_cube_id, sampler_state);
+        scene.set_sampler_state(small_cube_id, sampler_state);
+
+        triangle_rasterizer.resize_buffers(render_width, render_height);
+        triangle_rasterizer.reset_pipeline_stats();
+        triangle_rasterizer.clear_color_buffer(32, 32, 32);
+        triangle_rasterizer.clear_depth_buffer();
+
+        render_queue.begin(projection, view);
+        scene.submit(render_queue);
+        render_queue.execute(triangle_rasterizer, lighting::get_draw_function(frame_settings.lighting_model), &light);
+        triangle_rasterizer.flush();
+
+        if (triangle_rasterizer.get_overdraw_tracking()) {
+            triangle_rasterizer.draw_overdraw_heatmap();
+        }
+
+        triangle_rasterizer.swap_color_buffer(frame.color_buffer);
+        frame.width = render_width;
+        frame.height = render_height;
+        frame.full_width = full_render_width;
+        frame.full_height = full_render_height;
+        frame.pipeline_stats = triangle_rasterizer.get_pipeline_stats();
+
+        if (frame_settings.is_scaling_resolution) {
+            Uint64 render_counter_ticks = SDL_GetPerformanceCounter() - render_start_counter;
+            dynamic_resolution.add_frame_time(render_counter_ticks * 1000.0f / SDL_GetPerformanceFrequency());
+        }
+    };
+
+    // With three frames, one can be rendered while another one waits to be
+    // presented after the one being presented now.
+    const int FRAMES_IN_FLIGHT = 3;
+    FramePipeline frame_pipeline(FRAMES_IN_FLIGHT, render_frame);
+
+    // How long the main thread waits for a frame before it goes back to
+    // handling events, so the window stays responsive when rendering is slow.
+    const Uint32 FRAME_WAIT_TIMEOUT_MILLISECONDS = 10;
+
     Uint64 previous_timestamp = SDL_GetTicks();
 
     float seconds_left_until_fps_report = 1.0f;
@@ -158,19 +417,6 @@ int main() {
     bool running = true;
     SDL_Event event;
     while (running) {
-        Uint64 current_timestamp = SDL_GetTicks();
-        float delta_time = (current_timestamp - previous_timestamp) / 1000.0f;
-        previous_timestamp = current_timestamp;
-
-        frame_count++;
-        seconds_left_until_fps_report -= delta_time;
-        if (seconds_left_until_fps_report <= 0.0f) {
-            SDL_SetWindowTitle(window, (WINDOW_TITLE + std::string(" | FPS: ") + std::to_string(frame_count)).c_str());
-
-            seconds_left_until_fps_report = 1.0f;
-            frame_count = 0;
-        }
-
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_EVENT_QUIT) {
                 running = false;
@@ -181,117 +427,218 @@ int main() {
 
         const bool current_toggle_pause_key_state = keyboard_state[SDL_SCANCODE_SPACE];
         if (!previous_toggle_pause_key_state && current_toggle_pause_key_state) {
-            is_paused = !is_paused;
+            settings.is_paused = !settings.is_paused;
         }
         previous_toggle_pause_key_state = current_toggle_pause_key_state;
 
         const bool current_texture_rasterization_toggle_key_state = keyboard_state[SDL_SCANCODE_T];
         if (!previous_texture_rasterization_toggle_key_state && current_texture_rasterization_toggle_key_state) {
-            is_rasterizing_textures = !is_rasterizing_textures;
+            settings.is_rasterizing_textures = !settings.is_rasterizing_textures;
         }
         previous_texture_rasterization_toggle_key_state = current_texture_rasterization_toggle_key_state;
 
         const bool current_upscale_toggle_key_state = keyboard_state[SDL_SCANCODE_U];
         if (!previous_upscale_toggle_key_state && current_upscale_toggle_key_state) {
-            is_upscaling = !is_upscaling;
+            settings.is_upscaling = !settings.is_upscaling;
         }
         previous_upscale_toggle_key_state = current_upscale_toggle_key_state;
 
         const bool current_change_texture_filter_key_state = keyboard_state[SDL_SCANCODE_F];
         if (!previous_change_texture_filter_key_state && current_change_texture_filter_key_state) {
-            if (texture_filter == texture::TextureFilter::NEAREST) {
-                texture_filter = texture::TextureFilter::BILINEAR;
+            if (settings.texture_filter == texture::TextureFilter::NEAREST) {
+                settings.texture_filter = texture::TextureFilter::BILINEAR;
+            } else if (settings.texture_filter == texture::TextureFilter::BILINEAR) {
+                settings.texture_filter = texture::TextureFilter::NEAREST_MIPMAP;
+            } else if (settings.texture_filter == texture::TextureFilter::NEAREST_MIPMAP) {
+                settings.texture_filter = texture::TextureFilter::TRILINEAR;
             } else {
-                texture_filter = texture::TextureFilter::NEAREST;
+                settings.texture_filter = texture::TextureFilter::NEAREST;
             }
         }
         previous_change_texture_filter_key_state = current_change_texture_filter_key_state;
 
         const bool current_change_texture_wrap_key_state = keyboard_state[SDL_SCANCODE_W];
         if (!previous_change_texture_wrap_key_state && current_change_texture_wrap_key_state) {
-            if (texture_wrap == texture::TextureWrap::CLAMP) {
-                texture_wrap = texture::TextureWrap::REPEAT;
+            if (settings.texture_wrap == texture::TextureWrap::CLAMP) {
+                settings.texture_wrap = texture::TextureWrap::REPEAT;
             } else {
-                texture_wrap = texture::TextureWrap::CLAMP;
+                settings.texture_wrap = texture::TextureWrap::CLAMP;
             }
         }
         previous_change_texture_wrap_key_state = current_change_texture_wrap_key_state;
 
-        if (is_upscaling) {
-            // Since we're going to maintain the original aspect ratio, filling the window
-            // with black before rendering the target texture will give us "black bars"
-            // around any space not covered by the target texture due to aspect ratio
-            // misalignment.
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderClear(renderer);
+        const bool current_change_kernel_key_state = keyboard_state[SDL_SCANCODE_K];
+        if (!previous_change_kernel_key_state && current_change_kernel_key_state) {
+            // Cycle through the kernels this cpu supports, ending with the
+            // scalar reference kernel before wrapping back around.
+            raster_kernels::KernelType kernel_type = settings.kernel_type;
+            if (kernel_type == raster_kernels::KernelType::AVX2) {
+                kernel_type = raster_kernels::KernelType::SSE2;
+            } else if (kernel_type == raster_kernels::KernelType::SSE2) {
+                kernel_type = raster_kernels::KernelType::SCALAR;
+            } else {
+                kernel_type = raster_kernels::best_supported_kernel_type();
+            }
 
-            SDL_SetRenderTarget(renderer, target_texture);
+            if (!raster_kernels::is_kernel_type_supported(kernel_type)) {
+                kernel_type = raster_kernels::KernelType::SCALAR;
+            }
 
-            SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
-            SDL_RenderClear(renderer);
-        } else {
-            SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
-            SDL_RenderClear(renderer);
+            settings.kernel_type = kernel_type;
         }
+        previous_change_kernel_key_state = current_change_kernel_key_state;
 
-        if (!is_paused) {
-            rotation_degrees_y += ROTATION_DEGREES_Y_PER_SECOND * delta_time;
-            rotation_degrees_x += ROTATION_DEGREES_X_PER_SECOND * delta_time;
+        const bool current_toggle_overdraw_heatmap_key_state = keyboard_state[SDL_SCANCODE_O];
+        if (!previous_toggle_overdraw_heatmap_key_state && current_toggle_overdraw_heatmap_key_state) {
+            settings.is_tracking_overdraw = !settings.is_tracking_overdraw;
         }
+        previous_toggle_overdraw_heatmap_key_state = current_toggle_overdraw_heatmap_key_state;
 
-        int render_width, render_height;
-        SDL_GetCurrentRenderOutputSize(renderer, &render_width, &render_height);
+        const bool current_toggle_deferred_shading_key_state = keyboard_state[SDL_SCANCODE_D];
+        if (!previous_toggle_deferred_shading_key_state && current_toggle_deferred_shading_key_state) {
+            settings.is_shading_deferred = !settings.is_shading_deferred;
+        }
+        previous_toggle_deferred_shading_key_state = current_toggle_deferred_shading_key_state;
 
-        glm::mat4 projection = glm::perspective(
-            glm::radians(45.0f),
-            static_cast<float>(render_width) / render_height,
-            0.1f,
-            100.0f
-        );
+        const bool current_change_multisampling_key_state = keyboard_state[SDL_SCANCODE_A];
+        if (!previous_change_multisampling_key_state && current_change_multisampling_key_state) {
+            // Cycle through 1, 2 and 4 samples per pixel.
+            settings.sample_count = settings.sample_count == 4 ? 1 : settings.sample_count * 2;
+        }
+        previous_change_multisampling_key_state = current_change_multisampling_key_state;
+
+        const bool current_change_depth_format_key_state = keyboard_state[SDL_SCANCODE_Z];
+        if (!previous_change_depth_format_key_state && current_change_depth_format_key_state) {
+            switch (settings.depth_format) {
+                case raster_kernels::DepthFormat::FLOAT:
+                    settings.depth_format = raster_kernels::DepthFormat::REVERSED_FLOAT;
+                    break;
+
+                case raster_kernels::DepthFormat::REVERSED_FLOAT:
+                    settings.depth_format = raster_kernels::DepthFormat::UNORM16;
+                    break;
+
+                case raster_kernels::DepthFormat::UNORM16:
+                    settings.depth_format = raster_kernels::DepthFormat::UNORM24;
+                    break;
+
+                default:
+                    settings.depth_format = raster_kernels::DepthFormat::FLOAT;
+                    break;
+            }
+        }
+        previous_change_depth_format_key_state = current_change_depth_format_key_state;
 
-        glm::mat4 view = glm::lookAt(camera_position, camera_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const bool current_change_perspective_subdivision_key_state = keyboard_state[SDL_SCANCODE_P];
+        if (!previous_change_perspective_subdivision_key_state && current_change_perspective_subdivision_key_state) {
+            // Cycle through exact correction, and correction every 8 and 16
+            // pixels for large triangles.
+            settings.perspective_span_length = settings.perspective_span_length == 16 ? 0 : settings.perspective_span_length + 8;
+        }
+        previous_change_perspective_subdivision_key_state = current_change_perspective_subdivision_key_state;
+
+        const bool current_change_lighting_key_state = keyboard_state[SDL_SCANCODE_L];
+        if (!previous_change_lighting_key_state && current_change_lighting_key_state) {
+            if (settings.lighting_model == lighting::LightingModel::UNLIT) {
+                settings.lighting_model = lighting::LightingModel::LAMBERT;
+            } else if (settings.lighting_model == lighting::LightingModel::LAMBERT) {
+                settings.lighting_model = lighting::LightingModel::PHONG;
+            } else {
+                settings.lighting_model = lighting::LightingModel::UNLIT;
+            }
+        }
+        previous_change_lighting_key_state = current_change_lighting_key_state;
 
-        glm::mat4 rotation_x = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_x), glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 rotation_y = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_degrees_y), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 model_rotation = rotation_x * rotation_y;
+        const bool current_toggle_dynamic_resolution_key_state = keyboard_state[SDL_SCANCODE_R];
+        if (!previous_toggle_dynamic_resolution_key_state && current_toggle_dynamic_resolution_key_state) {
+            settings.is_scaling_resolution = !settings.is_scaling_resolution;
+        }
+        previous_toggle_dynamic_resolution_key_state = current_toggle_dynamic_resolution_key_state;
 
-        glm::mat4 big_cube_translation = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 0.0f, 0.0f));
-        glm::mat4 big_cube_model = big_cube_translation * model_rotation;
+        const bool current_toggle_multithreading_key_state = keyboard_state[SDL_SCANCODE_M];
+        if (!previous_toggle_multithreading_key_state && current_toggle_multithreading_key_state) {
+            if (settings.thread_count == 1) {
+                settings.thread_count = MAX_THREAD_COUNT;
+            } else {
+                settings.thread_count = 1;
+            }
+        }
+        previous_toggle_multithreading_key_state = current_toggle_multithreading_key_state;
 
-        glm::mat4 small_cube_translation = glm::translate(glm::mat4(1.0), glm::vec3(1.75f, 0.0f, 0.0f));
-        glm::mat4 small_cube_model = small_cube_translation * model_rotation;
+        int window_width, window_height;
+        SDL_GetRenderOutputSize(renderer, &window_width, &window_height);
+        settings.window_width = window_width;
+        settings.window_height = window_height;
 
-        SDL_Surface* render_texture_surface = nullptr;
-        if (is_rasterizing_textures) {
-            render_texture_surface = texture_surface;
+        {
+            std::lock_guard<std::mutex> lock(settings_mutex);
+            shared_settings = settings;
         }
 
-        triangle_rasterizer.resize_depth_buffer(render_width, render_height);
-        triangle_rasterizer.clear_depth_buffer();
-        triangle_rasterizer.set_texture_filter(texture_filter);
-        triangle_rasterizer.set_texture_wrap(texture_wrap);
+        RenderedFrame* frame = frame_pipeline.acquire_rendered_frame(FRAME_WAIT_TIMEOUT_MILLISECONDS);
+        if (frame == nullptr) {
+            continue;
+        }
 
-        big_cube.rasterize(triangle_rasterizer, renderer, render_texture_surface, projection, view, big_cube_model);
-        small_cube.rasterize(triangle_rasterizer, renderer, render_texture_surface, projection, view, small_cube_model);
+        Uint64 current_timestamp = SDL_GetTicks();
+        float delta_time = (current_timestamp - previous_timestamp) / 1000.0f;
+        previous_timestamp = current_timestamp;
 
-        if (is_upscaling) {
-            SDL_SetRenderTarget(renderer, nullptr);
+        frame_count++;
+        seconds_left_until_fps_report -= delta_time;
+        if (seconds_left_until_fps_report <= 0.0f) {
+            std::string kernel_name = raster_kernels::kernel_type_name(settings.kernel_type);
+            std::string thread_count = std::to_string(settings.thread_count);
+            std::string sample_count = std::to_string(settings.sample_count);
+            std::string depth_format_name = raster_kernels::depth_format_name(settings.depth_format);
+            std::string lighting_model_name = lighting::lighting_model_name(settings.lighting_model);
+            std::string scale_percentage = std::to_string(100 * frame->width / frame->full_width);
 
-            int window_width, window_height;
-            SDL_GetRenderOutputSize(renderer, &window_width, &window_height);
+            // The stats are from the frame that is about to be presented.
+            const PipelineStats& pipeline_stats = frame->pipeline_stats;
+            std::string triangle_count = std::to_string(pipeline_stats.rasterized_triangles);
+            std::string shaded_pixel_count = std::to_string(pipeline_stats.pixels.shaded_pixels);
 
-            SDL_FRect texture_fit_to_window_rect;
-            SDL_FRect window_rect = { 0.0f, 0.0f, static_cast<float>(window_width), static_cast<float>(window_height) };
-            fit_inner_rect_within_outer_rect(target_texture_rect, window_rect, texture_fit_to_window_rect);
+            SDL_SetWindowTitle(window, (WINDOW_TITLE + std::string(" | FPS: ") + std::to_string(frame_count) + " | Kernel: " + kernel_name + " | Threads: " + thread_count + " | MSAA: " + sample_count + "x"
+                                        + " | Depth: " + depth_format_name + " | Lighting: " + lighting_model_name + " | Scale: " + scale_percentage + "%" + " | Triangles: " + triangle_count + " | Shaded pixels: " + shaded_pixel_count).c_str());
 
-            SDL_RenderTexture(renderer, target_texture, nullptr, &texture_fit_to_window_rect);
+            seconds_left_until_fps_report = 1.0f;
+            frame_count = 0;
+        }
+
+        if (!recreate_framebuffer_texture(frame->full_width, frame->full_height)) {
+            frame_pipeline.release_frame(frame);
+            running = false;
+            continue;
         }
+        upload_color_buffer(*frame);
+
+        // The frame's pixels are in the texture now, so the render thread can
+        // start on the next frame in it while this one is presented.
+        SDL_FRect rendered_rect = { 0.0f, 0.0f, static_cast<float>(frame->width), static_cast<float>(frame->height) };
+        SDL_FRect full_render_rect = { 0.0f, 0.0f, static_cast<float>(frame->full_width), static_cast<float>(frame->full_height) };
+        frame_pipeline.release_frame(frame);
+
+        // Since we're going to maintain the original aspect ratio when upscaling,
+        // filling the window with black before rendering the framebuffer texture
+        // will give us "black bars" around any space not covered by the texture
+        // due to aspect ratio misalignment. Frames that were rendered at the
+        // window size just fill the window.
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+
+        SDL_FRect texture_fit_to_window_rect;
+        SDL_FRect window_rect = { 0.0f, 0.0f, static_cast<float>(window_width), static_cast<float>(window_height) };
+        fit_inner_rect_within_outer_rect(full_render_rect, window_rect, texture_fit_to_window_rect);
+
+        SDL_RenderTexture(renderer, framebuffer_texture, &rendered_rect, &texture_fit_to_window_rect);
 
         SDL_RenderPresent(renderer);
     }
 
     // --- cleanup and quit ---
 
+    frame_pipeline.stop();
     cleanup();
     return 0;
 }
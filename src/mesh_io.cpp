@@ -0,0 +1,874 @@
+#include "mesh_io.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+// The binary mesh header. Every array starts at its offset from the start of
+// the file, which is a multiple of SECTION_ALIGNMENT, in the order the
+// offsets are listed in: positions x, y and z, colors, texture coordinates,
+// normals, tangents and indices.
+struct BinaryMeshHeader {
+    char magic[8];
+    Uint32 version;
+    Uint32 vertex_count;
+    Uint32 index_count;
+    Uint32 header_size;
+    float bounds_min[3];
+    float bounds_max[3];
+    Uint64 section_offsets[8];
+};
+
+static const char BINARY_MESH_MAGIC[8] = { 'S', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+static const Uint32 BINARY_MESH_VERSION = 2;
+static const int BINARY_MESH_SECTION_COUNT = 8;
+static const Uint64 SECTION_ALIGNMENT = 64;
+
+static_assert(sizeof(BinaryMeshHeader) == 112, "the binary mesh header must not have any padding");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float) && sizeof(glm::vec2) == 2 * sizeof(float),
+              "vertex attributes are mapped straight from the file");
+
+// Colors for vertices that don't have any.
+static const glm::vec3 DEFAULT_VERTEX_COLOR = glm::vec3(1.0f, 1.0f, 1.0f);
+
+enum class PlyFormat {
+    ASCII,
+    BINARY_LITTLE_ENDIAN,
+    BINARY_BIG_ENDIAN,
+};
+
+enum class PlyType {
+    INVALID,
+    INT8,
+    UINT8,
+    INT16,
+    UINT16,
+    INT32,
+    UINT32,
+    FLOAT32,
+    FLOAT64,
+};
+
+struct PlyProperty {
+    std::string name;
+    PlyType type;
+
+    // Lists are a count followed by that many values of the property's type.
+    bool is_list;
+    PlyType count_type;
+};
+
+struct PlyElement {
+    std::string name;
+    long long count;
+    std::vector<PlyProperty> properties;
+};
+
+// Where the body of a PLY file is being read from.
+struct PlyReader {
+    const char* cursor;
+    const char* end;
+    PlyFormat format;
+};
+
+// --------------------------------------------------------------------------
+
+// Reads the whole file, with a NUL after its last byte so that text can be
+// parsed without checking for the end all the time.
+static bool read_file(const std::string& path, std::vector<char>& contents) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "[ERROR] could not open " << path << std::endl;
+        return false;
+    }
+
+    contents.clear();
+
+    char buffer[1 << 16];
+    size_t read_count;
+    while ((read_count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.insert(contents.end(), buffer, buffer + read_count);
+    }
+
+    bool has_failed = std::ferror(file) != 0;
+    std::fclose(file);
+
+    if (has_failed) {
+        std::cerr << "[ERROR] could not read " << path << std::endl;
+        return false;
+    }
+
+    contents.push_back('\0');
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+static bool ends_with(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && std::equal(suffix.rbegin(), suffix.rend(), text.rbegin());
+}
+
+// --------------------------------------------------------------------------
+
+static bool is_little_endian() {
+    return SDL_BYTEORDER == SDL_LIL_ENDIAN;
+}
+
+// --------------------------------------------------------------------------
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// --------------------------------------------------------------------------
+
+static const char* skip_blanks(const char* cursor) {
+    while (is_blank(*cursor)) {
+        cursor++;
+    }
+
+    return cursor;
+}
+
+// --------------------------------------------------------------------------
+
+static const char* next_line(const char* cursor) {
+    while (*cursor != '\0' && *cursor != '\n') {
+        cursor++;
+    }
+
+    return *cursor == '\n' ? cursor + 1 : cursor;
+}
+
+// --------------------------------------------------------------------------
+
+// Unlike strtof() on its own, this never goes looking for the number on the
+// next line.
+static bool parse_float(const char*& cursor, float& value) {
+    const char* start = skip_blanks(cursor);
+    if (*start == '\n' || *start == '\0') {
+        return false;
+    }
+
+    char* end = nullptr;
+    value = std::strtof(start, &end);
+    if (end == start) {
+        return false;
+    }
+
+    cursor = end;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+// OBJ indices start at one, and negative ones count back from the last
+// element defined so far. Returns -1 if the index doesn't refer to anything.
+static long resolve_obj_index(long index, size_t count) {
+    long resolved_index = index > 0 ? index - 1 : static_cast<long>(count) + index;
+    return index != 0 && resolved_index >= 0 && resolved_index < static_cast<long>(count) ? resolved_index : -1;
+}
+
+// --------------------------------------------------------------------------
+
+static std::vector<std::string> split_words(const std::string& line) {
+    std::vector<std::string> words;
+
+    size_t position = 0;
+    while (position < line.size()) {
+        while (position < line.size() && (is_blank(line[position]) || line[position] == '\n')) {
+            position++;
+        }
+
+        size_t word_start = position;
+        while (position < line.size() && !is_blank(line[position]) && line[position] != '\n') {
+            position++;
+        }
+
+        if (position > word_start) {
+            words.push_back(line.substr(word_start, position - word_start));
+        }
+    }
+
+    return words;
+}
+
+// --------------------------------------------------------------------------
+
+static PlyType parse_ply_type(const std::string& name) {
+    if (name == "char" || name == "int8") {
+        return PlyType::INT8;
+    } else if (name == "uchar" || name == "uint8") {
+        return PlyType::UINT8;
+    } else if (name == "short" || name == "int16") {
+        return PlyType::INT16;
+    } else if (name == "ushort" || name == "uint16") {
+        return PlyType::UINT16;
+    } else if (name == "int" || name == "int32") {
+        return PlyType::INT32;
+    } else if (name == "uint" || name == "uint32") {
+        return PlyType::UINT32;
+    } else if (name == "float" || name == "float32") {
+        return PlyType::FLOAT32;
+    } else if (name == "double" || name == "float64") {
+        return PlyType::FLOAT64;
+    }
+
+    return PlyType::INVALID;
+}
+
+// --------------------------------------------------------------------------
+
+static int ply_type_size(PlyType type) {
+    switch (type) {
+        case PlyType::INT8:
+        case PlyType::UINT8:
+            return 1;
+
+        case PlyType::INT16:
+        case PlyType::UINT16:
+            return 2;
+
+        case PlyType::FLOAT64:
+            return 8;
+
+        default:
+            return 4;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+// Whether what's left of the body could hold count records, each at least
+// binary_size bytes in a binary file or value_count values in an ASCII one.
+// Counts come straight from the file, so this is checked before anything is
+// sized by them. An ASCII value is at least a digit and a separator, apart
+// from the last one in the file.
+static bool fits_in_ply_body(const PlyReader& reader, double count, size_t binary_size, size_t value_count) {
+    size_t record_size = reader.format == PlyFormat::ASCII ? 2 * value_count : binary_size;
+    if (record_size == 0) {
+        return true;
+    }
+
+    size_t remaining = static_cast<size_t>(reader.end - reader.cursor);
+    return count <= static_cast<double>((remaining + 1) / record_size);
+}
+
+// --------------------------------------------------------------------------
+
+static bool read_ply_value(PlyReader& reader, PlyType type, double& value) {
+    if (reader.format == PlyFormat::ASCII) {
+        while (reader.cursor < reader.end && (is_blank(*reader.cursor) || *reader.cursor == '\n')) {
+            reader.cursor++;
+        }
+
+        char* end = nullptr;
+        value = std::strtod(reader.cursor, &end);
+        if (end == reader.cursor) {
+            return false;
+        }
+
+        reader.cursor = end;
+        return true;
+    }
+
+    int size = ply_type_size(type);
+    if (reader.end - reader.cursor < size) {
+        return false;
+    }
+
+    Uint8 bytes[8];
+    std::memcpy(bytes, reader.cursor, size);
+    reader.cursor += size;
+
+    bool is_file_little_endian = reader.format == PlyFormat::BINARY_LITTLE_ENDIAN;
+    if (is_file_little_endian != is_little_endian()) {
+        std::reverse(bytes, bytes + size);
+    }
+
+    switch (type) {
+        case PlyType::INT8: { Sint8 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::UINT8: { Uint8 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::INT16: { Sint16 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::UINT16: { Uint16 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::INT32: { Sint32 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::UINT32: { Uint32 typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        case PlyType::FLOAT32: { float typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+        default: { double typed_value; std::memcpy(&typed_value, bytes, size); value = typed_value; break; }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+// Reads one property of one element, and keeps the values of lists.
+static bool read_ply_property(PlyReader& reader, const PlyProperty& property, double& value, std::vector<double>& list_values) {
+    if (!property.is_list) {
+        return read_ply_value(reader, property.type, value);
+    }
+
+    double count;
+    if (!read_ply_value(reader, property.count_type, count) || count < 0.0) {
+        return false;
+    }
+
+    if (!fits_in_ply_body(reader, count, ply_type_size(property.type), 1)) {
+        return false;
+    }
+
+    list_values.resize(static_cast<size_t>(count));
+    for (double& list_value : list_values) {
+        if (!read_ply_value(reader, property.type, list_value)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+static bool parse_ply_header(const std::vector<char>& contents, PlyFormat& format, std::vector<PlyElement>& elements, size_t& body_offset) {
+    size_t position = 0;
+    bool has_format = false;
+    bool is_first_line = true;
+
+    while (position < contents.size() - 1) {
+        size_t line_end = position;
+        while (line_end < contents.size() - 1 && contents[line_end] != '\n') {
+            line_end++;
+        }
+
+        std::vector<std::string> words = split_words(std::string(contents.data() + position, line_end - position));
+        position = line_end + 1;
+
+        if (is_first_line) {
+            if (words.size() != 1 || words[0] != "ply") {
+                return false;
+            }
+
+            is_first_line = false;
+            continue;
+        }
+
+        if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        } else if (words[0] == "end_header") {
+            body_offset = std::min(position, contents.size() - 1);
+            return has_format;
+        } else if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") {
+                format = PlyFormat::ASCII;
+            } else if (words[1] == "binary_little_endian") {
+                format = PlyFormat::BINARY_LITTLE_ENDIAN;
+            } else if (words[1] == "binary_big_endian") {
+                format = PlyFormat::BINARY_BIG_ENDIAN;
+            } else {
+                return false;
+            }
+
+            has_format = true;
+        } else if (words[0] == "element" && words.size() == 3) {
+            PlyElement element;
+            element.name = words[1];
+            element.count = std::strtoll(words[2].c_str(), nullptr, 10);
+            if (element.count < 0) {
+                return false;
+            }
+
+            elements.push_back(element);
+        } else if (words[0] == "property" && !elements.empty()) {
+            PlyProperty property;
+            property.is_list = words.size() == 5 && words[1] == "list";
+            if (property.is_list) {
+                property.count_type = parse_ply_type(words[2]);
+                property.type = parse_ply_type(words[3]);
+                property.name = words[4];
+            } else if (words.size() == 3) {
+                property.count_type = PlyType::INVALID;
+                property.type = parse_ply_type(words[1]);
+                property.name = words[2];
+            } else {
+                return false;
+            }
+
+            if (property.type == PlyType::INVALID || (property.is_list && property.count_type == PlyType::INVALID)) {
+                return false;
+            }
+
+            elements.back().properties.push_back(property);
+        } else {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------------------
+
+static int find_ply_property(const PlyElement& element, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        for (size_t i = 0; i < element.properties.size(); i++) {
+            if (element.properties[i].name == name && !element.properties[i].is_list) {
+                return static_cast<int>(i);
+            }
+        }
+    }
+
+    return -1;
+}
+
+// --------------------------------------------------------------------------
+
+static bool is_integer_ply_type(PlyType type) {
+    return type != PlyType::FLOAT32 && type != PlyType::FLOAT64;
+}
+
+// --------------------------------------------------------------------------
+
+bool mesh_io::load_mesh(const std::string& path, Object& object) {
+    if (ends_with(path, ".obj")) {
+        return load_obj(path, object);
+    } else if (ends_with(path, ".ply")) {
+        return load_ply(path, object);
+    } else if (ends_with(path, ".mesh")) {
+        return map_binary_mesh(path, object);
+    }
+
+    std::cerr << "[ERROR] unknown mesh format: " << path << std::endl;
+    return false;
+}
+
+// --------------------------------------------------------------------------
+
+bool mesh_io::load_obj(const std::string& path, Object& object) {
+    std::vector<char> contents;
+    if (!read_file(path, contents)) {
+        return false;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> position_colors;
+    std::vector<glm::vec2> obj_tex_coords;
+
+    // Keyed by the position index in the upper half and one plus the
+    // texture coordinate index, or zero for none, in the lower half.
+    std::unordered_map<Uint64, Uint32> vertex_indices;
+    std::vector<Uint32> polygon;
+
+    Object loaded_object;
+    int line_number = 1;
+
+    for (const char* cursor = contents.data(); *cursor != '\0'; cursor = next_line(cursor), line_number++) {
+        const char* line = skip_blanks(cursor);
+
+        if (line[0] == 'v' && is_blank(line[1])) {
+            const char* values = line + 1;
+            glm::vec3 position;
+            if (!parse_float(values, position.x) || !parse_float(values, position.y) || !parse_float(values, position.z)) {
+                std::cerr << "[ERROR] " << path << ":" << line_number << ": bad vertex position" << std::endl;
+                return false;
+            }
+
+            // One more value is the w coordinate, which is ignored, and
+            // three or four more are a color, after the w if there is one.
+            float extra_values[5];
+            int extra_value_count = 0;
+            while (extra_value_count < 5 && parse_float(values, extra_values[extra_value_count])) {
+                extra_value_count++;
+            }
+
+            glm::vec3 color = DEFAULT_VERTEX_COLOR;
+            if (extra_value_count == 3 || extra_value_count == 4) {
+                const float* color_values = extra_values + extra_value_count - 3;
+                color = glm::vec3(color_values[0], color_values[1], color_values[2]);
+            } else if (extra_value_count != 0 && extra_value_count != 1) {
+                std::cerr << "[ERROR] " << path << ":" << line_number << ": bad vertex color" << std::endl;
+                return false;
+            }
+
+            positions.push_back(position);
+            position_colors.push_back(color);
+        } else if (line[0] == 'v' && line[1] == 't' && is_blank(line[2])) {
+            const char* values = line + 2;
+            glm::vec2 tex_coord = glm::vec2(0.0f);
+            if (!parse_float(values, tex_coord.x)) {
+                std::cerr << "[ERROR] " << path << ":" << line_number << ": bad texture coordinate" << std::endl;
+                return false;
+            }
+
+            // The second coordinate is optional, and a third one is ignored.
+            parse_float(values, tex_coord.y);
+            obj_tex_coords.push_back(tex_coord);
+        } else if (line[0] == 'f' && is_blank(line[1])) {
+            polygon.clear();
+
+            const char* corner = skip_blanks(line + 1);
+            while (*corner != '\n' && *corner != '\0') {
+                char* end = nullptr;
+                long position_index = resolve_obj_index(std::strtol(corner, &end, 10), positions.size());
+                long tex_coord_index = -1;
+                bool is_valid = end != corner && position_index >= 0;
+                corner = end;
+
+                // Corners are position, position/tex_coord, position//normal
+                // or position/tex_coord/normal.
+                if (is_valid && *corner == '/') {
+                    corner++;
+                    if (*corner != '/') {
+                        tex_coord_index = resolve_obj_index(std::strtol(corner, &end, 10), obj_tex_coords.size());
+                        is_valid = end != corner && tex_coord_index >= 0;
+                        corner = end;
+                    }
+
+                    if (is_valid && *corner == '/') {
+                        corner++;
+                        std::strtol(corner, &end, 10);
+                        is_valid = end != corner;
+                        corner = end;
+                    }
+                }
+
+                if (!is_valid || !(is_blank(*corner) || *corner == '\n' || *corner == '\0')) {
+                    std::cerr << "[ERROR] " << path << ":" << line_number << ": bad face" << std::endl;
+                    return false;
+                }
+
+                Uint64 key = (static_cast<Uint64>(position_index) << 32) | static_cast<Uint64>(tex_coord_index + 1);
+                std::unordered_map<Uint64, Uint32>::iterator it = vertex_indices.find(key);
+                if (it == vertex_indices.end()) {
+                    WorldVertex vertex = {
+                        positions[position_index],
+                        position_colors[position_index],
+                        tex_coord_index >= 0 ? obj_tex_coords[tex_coord_index] : glm::vec2(0.0f),
+                    };
+
+                    it = vertex_indices.emplace(key, loaded_object.add_vertex(vertex)).first;
+                }
+
+                polygon.push_back(it->second);
+                corner = skip_blanks(corner);
+            }
+
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                loaded_object.add_triangle(polygon[0], polygon[i], polygon[i + 1]);
+            }
+        }
+    }
+
+    object = std::move(loaded_object);
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool mesh_io::load_ply(const std::string& path, Object& object) {
+    std::vector<char> contents;
+    if (!read_file(path, contents)) {
+        return false;
+    }
+
+    PlyFormat format = PlyFormat::ASCII;
+    std::vector<PlyElement> elements;
+    size_t body_offset = 0;
+    if (!parse_ply_header(contents, format, elements, body_offset)) {
+        std::cerr << "[ERROR] " << path << " does not have a valid PLY header" << std::endl;
+        return false;
+    }
+
+    PlyReader reader = { contents.data() + body_offset, contents.data() + contents.size() - 1, format };
+
+    Object loaded_object;
+    bool has_vertices = false;
+    double value = 0.0;
+    std::vector<double> list_values;
+
+    for (const PlyElement& element : elements) {
+        if (element.name == "vertex") {
+            int position_properties[3] = {
+                find_ply_property(element, { "x" }),
+                find_ply_property(element, { "y" }),
+                find_ply_property(element, { "z" }),
+            };
+            int color_properties[3] = {
+                find_ply_property(element, { "red", "r", "diffuse_red" }),
+                find_ply_property(element, { "green", "g", "diffuse_green" }),
+                find_ply_property(element, { "blue", "b", "diffuse_blue" }),
+            };
+            int tex_coord_properties[2] = {
+                find_ply_property(element, { "u", "s", "texture_u", "texture_s" }),
+                find_ply_property(element, { "v", "t", "texture_v", "texture_t" }),
+            };
+
+            if (position_properties[0] < 0 || position_properties[1] < 0 || position_properties[2] < 0) {
+                std::cerr << "[ERROR] " << path << ": the vertices have no x, y and z" << std::endl;
+                return false;
+            }
+
+            if (element.count > INT_MAX) {
+                std::cerr << "[ERROR] " << path << ": too many vertices" << std::endl;
+                return false;
+            }
+
+            size_t vertex_size = 0;
+            for (const PlyProperty& property : element.properties) {
+                vertex_size += ply_type_size(property.is_list ? property.count_type : property.type);
+            }
+
+            if (!fits_in_ply_body(reader, static_cast<double>(element.count), vertex_size, element.properties.size())) {
+                std::cerr << "[ERROR] " << path << ": there are more vertices than the file has room for" << std::endl;
+                return false;
+            }
+
+            loaded_object.reserve(static_cast<int>(element.count), 0);
+
+            std::vector<double> values(element.properties.size());
+            for (long long i = 0; i < element.count; i++) {
+                for (size_t j = 0; j < element.properties.size(); j++) {
+                    if (!read_ply_property(reader, element.properties[j], values[j], list_values)) {
+                        std::cerr << "[ERROR] " << path << ": vertex " << i << " is cut short" << std::endl;
+                        return false;
+                    }
+                }
+
+                WorldVertex vertex;
+                vertex.color = DEFAULT_VERTEX_COLOR;
+                vertex.tex_coord = glm::vec2(0.0f);
+                for (int k = 0; k < 3; k++) {
+                    vertex.position[k] = static_cast<float>(values[position_properties[k]]);
+
+                    if (color_properties[k] >= 0) {
+                        bool is_integer = is_integer_ply_type(element.properties[color_properties[k]].type);
+                        vertex.color[k] = static_cast<float>(values[color_properties[k]] / (is_integer ? 255.0 : 1.0));
+                    }
+                }
+
+                for (int k = 0; k < 2; k++) {
+                    if (tex_coord_properties[k] >= 0) {
+                        vertex.tex_coord[k] = static_cast<float>(values[tex_coord_properties[k]]);
+                    }
+                }
+
+                loaded_object.add_vertex(vertex);
+            }
+
+            has_vertices = true;
+        } else if (element.name == "face") {
+            if (!has_vertices) {
+                std::cerr << "[ERROR] " << path << ": the faces come before the vertices" << std::endl;
+                return false;
+            }
+
+            int vertex_count = loaded_object.get_vertex_count();
+            for (long long i = 0; i < element.count; i++) {
+                for (const PlyProperty& property : element.properties) {
+                    if (!read_ply_property(reader, property, value, list_values)) {
+                        std::cerr << "[ERROR] " << path << ": face " << i << " is cut short" << std::endl;
+                        return false;
+                    }
+
+                    if (!property.is_list || (property.name != "vertex_indices" && property.name != "vertex_index")) {
+                        continue;
+                    }
+
+                    for (double index : list_values) {
+                        if (!(index >= 0.0 && index < vertex_count)) {
+                            std::cerr << "[ERROR] " << path << ": face " << i << " refers to a vertex that doesn't exist" << std::endl;
+                            return false;
+                        }
+                    }
+
+                    for (size_t j = 1; j + 1 < list_values.size(); j++) {
+                        loaded_object.add_triangle(static_cast<Uint32>(list_values[0]),
+                                                   static_cast<Uint32>(list_values[j]),
+                                                   static_cast<Uint32>(list_values[j + 1]));
+                    }
+                }
+            }
+        } else {
+            // Anything else is skipped, which still means reading it.
+            for (long long i = 0; i < element.count; i++) {
+                for (const PlyProperty& property : element.properties) {
+                    if (!read_ply_property(reader, property, value, list_values)) {
+                        std::cerr << "[ERROR] " << path << ": element " << element.name << " is cut short" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    object = std::move(loaded_object);
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool mesh_io::save_binary_mesh(const std::string& path, const Object& object) {
+    if (!is_little_endian()) {
+        std::cerr << "[ERROR] binary meshes can only be written on little endian machines" << std::endl;
+        return false;
+    }
+
+    MeshArrays arrays = object.get_arrays();
+    const bounding_volumes::BoundingBox& bounds = object.get_bounds();
+
+    const void* section_data[BINARY_MESH_SECTION_COUNT] = {
+        arrays.positions_x,
+        arrays.positions_y,
+        arrays.positions_z,
+        arrays.colors,
+        arrays.tex_coords,
+        arrays.normals,
+        arrays.tangents,
+        arrays.indices,
+    };
+    Uint64 section_sizes[BINARY_MESH_SECTION_COUNT] = {
+        arrays.vertex_count * sizeof(float),
+        arrays.vertex_count * sizeof(float),
+        arrays.vertex_count * sizeof(float),
+        arrays.vertex_count * sizeof(glm::vec3),
+        arrays.vertex_count * sizeof(glm::vec2),
+        arrays.vertex_count * sizeof(glm::vec3),
+        arrays.vertex_count * sizeof(glm::vec3),
+        arrays.index_count * sizeof(Uint32),
+    };
+
+    BinaryMeshHeader header = {};
+    std::memcpy(header.magic, BINARY_MESH_MAGIC, sizeof(header.magic));
+    header.version = BINARY_MESH_VERSION;
+    header.vertex_count = static_cast<Uint32>(arrays.vertex_count);
+    header.index_count = static_cast<Uint32>(arrays.index_count);
+    header.header_size = sizeof(BinaryMeshHeader);
+    for (int i = 0; i < 3; i++) {
+        header.bounds_min[i] = bounds.min[i];
+        header.bounds_max[i] = bounds.max[i];
+    }
+
+    Uint64 offset = sizeof(BinaryMeshHeader);
+    for (int i = 0; i < BINARY_MESH_SECTION_COUNT; i++) {
+        offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        header.section_offsets[i] = offset;
+        offset += section_sizes[i];
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "[ERROR] could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    bool was_written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    const char PADDING[SECTION_ALIGNMENT] = {};
+    Uint64 written_size = sizeof(BinaryMeshHeader);
+    for (int i = 0; i < BINARY_MESH_SECTION_COUNT && was_written; i++) {
+        Uint64 padding_size = header.section_offsets[i] - written_size;
+        was_written = std::fwrite(PADDING, 1, padding_size, file) == padding_size;
+
+        if (was_written && section_sizes[i] > 0) {
+            was_written = std::fwrite(section_data[i], 1, section_sizes[i], file) == section_sizes[i];
+        }
+
+        written_size = header.section_offsets[i] + section_sizes[i];
+    }
+
+    was_written &= std::fclose(file) == 0;
+    if (!was_written) {
+        std::cerr << "[ERROR] could not write " << path << std::endl;
+    }
+
+    return was_written;
+}
+
+// --------------------------------------------------------------------------
+
+bool mesh_io::map_binary_mesh(const std::string& path, Object& object) {
+    if (!is_little_endian()) {
+        std::cerr << "[ERROR] binary meshes can only be read on little endian machines" << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+    if (!file->is_open()) {
+        return false;
+    }
+
+    BinaryMeshHeader header;
+    if (file->get_size() < sizeof(header)) {
+        std::cerr << "[ERROR] " << path << " is too small to be a binary mesh" << std::endl;
+        return false;
+    }
+
+    std::memcpy(&header, file->get_data(), sizeof(header));
+    if (std::memcmp(header.magic, BINARY_MESH_MAGIC, sizeof(header.magic)) != 0 || header.version != BINARY_MESH_VERSION) {
+        std::cerr << "[ERROR] " << path << " is not a version " << BINARY_MESH_VERSION << " binary mesh" << std::endl;
+        return false;
+    }
+
+    if (header.vertex_count > INT_MAX || header.index_count > INT_MAX || header.index_count % 3 != 0) {
+        std::cerr << "[ERROR] " << path << " has a bad vertex or index count" << std::endl;
+        return false;
+    }
+
+    Uint64 section_sizes[BINARY_MESH_SECTION_COUNT] = {
+        header.vertex_count * sizeof(float),
+        header.vertex_count * sizeof(float),
+        header.vertex_count * sizeof(float),
+        header.vertex_count * sizeof(glm::vec3),
+        header.vertex_count * sizeof(glm::vec2),
+        header.vertex_count * sizeof(glm::vec3),
+        header.vertex_count * sizeof(glm::vec3),
+        header.index_count * sizeof(Uint32),
+    };
+
+    for (int i = 0; i < BINARY_MESH_SECTION_COUNT; i++) {
+        Uint64 offset = header.section_offsets[i];
+        if (offset % SECTION_ALIGNMENT != 0 || offset > file->get_size() || section_sizes[i] > file->get_size() - offset) {
+            std::cerr << "[ERROR] " << path << " is truncated or has a bad section offset" << std::endl;
+            return false;
+        }
+    }
+
+    const Uint8* data = file->get_data();
+
+    MeshArrays arrays;
+    arrays.positions_x = reinterpret_cast<const float*>(data + header.section_offsets[0]);
+    arrays.positions_y = reinterpret_cast<const float*>(data + header.section_offsets[1]);
+    arrays.positions_z = reinterpret_cast<const float*>(data + header.section_offsets[2]);
+    arrays.colors = reinterpret_cast<const glm::vec3*>(data + header.section_offsets[3]);
+    arrays.tex_coords = reinterpret_cast<const glm::vec2*>(data + header.section_offsets[4]);
+    arrays.normals = reinterpret_cast<const glm::vec3*>(data + header.section_offsets[5]);
+    arrays.tangents = reinterpret_cast<const glm::vec3*>(data + header.section_offsets[6]);
+    arrays.indices = reinterpret_cast<const Uint32*>(data + header.section_offsets[7]);
+    arrays.vertex_count = static_cast<int>(header.vertex_count);
+    arrays.index_count = static_cast<int>(header.index_count);
+
+    // This is the only pass over the file before it is drawn, and it only
+    // touches the indices. A bad index would be read out of bounds later on.
+    for (int i = 0; i < arrays.index_count; i++) {
+        if (arrays.indices[i] >= header.vertex_count) {
+            std::cerr << "[ERROR] " << path << " has an index that refers to a vertex that doesn't exist" << std::endl;
+            return false;
+        }
+    }
+
+    bounding_volumes::BoundingBox bounds;
+    if (header.vertex_count > 0) {
+        bounds.min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+        bounds.max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+    }
+
+    object = Object(arrays, bounds, file);
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include <string>
+
+#include "Object.h"
+
+namespace mesh_io {
+    // Picks the loader from the file's extension, which is .obj, .ply or
+    // .mesh, and replaces the object with what it loads. Errors are printed,
+    // and leave the object as it was.
+    bool load_mesh(const std::string& path, Object& object);
+
+    // Polygons are split into triangle fans, and every distinct pair of
+    // position and texture coordinate indices becomes one vertex. Vertex
+    // colors are read from "v x y z r g b" and "v x y z w r g b" lines when
+    // they are there, and w coordinates and normals are ignored.
+    bool load_obj(const std::string& path, Object& object);
+
+    // ASCII and binary PLY files with a vertex element, having x, y and z
+    // properties, and a face element, with a vertex_indices list. Colors
+    // and texture coordinates are read when they are there.
+    bool load_ply(const std::string& path, Object& object);
+
+    // The binary mesh format is the object's arrays exactly as they are laid
+    // out in memory, behind a small header, so mapping a file is all it
+    // takes to load it. Files are little endian.
+    bool save_binary_mesh(const std::string& path, const Object& object);
+    bool map_binary_mesh(const std::string& path, Object& object);
+};
+
+#endif
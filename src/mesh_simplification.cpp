@@ -0,0 +1,373 @@
+#include "mesh_simplification.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// A symmetric 4x4 matrix that adds up the squared distances of a point to a
+// set of planes, stored as its upper triangle, row by row.
+struct Quadric {
+    double values[10];
+};
+
+// Moving the from vertex onto the to vertex, which removes every triangle
+// that had both of them.
+struct Collapse {
+    double cost;
+    Uint32 from;
+    Uint32 to;
+};
+
+// What the simplifier works on, which gets coarser with every collapse.
+struct SimplificationState {
+    std::vector<glm::vec3> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> is_locked;
+    std::vector<Uint32> indices;
+
+    // Which triangles use each vertex, rebuilt at the start of every pass.
+    std::vector<int> first_vertex_triangle;
+    std::vector<int> vertex_triangles;
+
+    std::vector<Collapse> collapses;
+    std::vector<bool> is_touched;
+
+    // The farthest any collapse so far may have moved the surface.
+    float geometric_error;
+};
+
+static const int MAX_LEVEL_COUNT = 8;
+
+// --------------------------------------------------------------------------
+
+static void add_plane(Quadric& quadric, const glm::vec3& normal, const glm::vec3& point) {
+    double a = normal.x;
+    double b = normal.y;
+    double c = normal.z;
+    double d = -(a * point.x + b * point.y + c * point.z);
+
+    double* values = quadric.values;
+    values[0] += a * a;
+    values[1] += a * b;
+    values[2] += a * c;
+    values[3] += a * d;
+    values[4] += b * b;
+    values[5] += b * c;
+    values[6] += b * d;
+    values[7] += c * c;
+    values[8] += c * d;
+    values[9] += d * d;
+}
+
+// --------------------------------------------------------------------------
+
+static double evaluate_quadric(const Quadric& quadric, const glm::vec3& point) {
+    double x = point.x;
+    double y = point.y;
+    double z = point.z;
+    const double* values = quadric.values;
+
+    double error = values[0] * x * x + 2.0 * values[1] * x * y + 2.0 * values[2] * x * z + 2.0 * values[3] * x
+                 + values[4] * y * y + 2.0 * values[5] * y * z + 2.0 * values[6] * y
+                 + values[7] * z * z + 2.0 * values[8] * z
+                 + values[9];
+
+    // Rounding can push the error of a point that is on every plane a little
+    // below zero.
+    return std::max(error, 0.0);
+}
+
+// --------------------------------------------------------------------------
+
+static double collapse_cost(const SimplificationState& state, Uint32 from, Uint32 to) {
+    Quadric quadric = state.quadrics[from];
+    for (int i = 0; i < 10; i++) {
+        quadric.values[i] += state.quadrics[to].values[i];
+    }
+
+    return evaluate_quadric(quadric, state.positions[to]);
+}
+
+// --------------------------------------------------------------------------
+
+static void initialize_state(SimplificationState& state, const MeshArrays& arrays) {
+    state.positions.resize(arrays.vertex_count);
+    for (int i = 0; i < arrays.vertex_count; i++) {
+        state.positions[i] = glm::vec3(arrays.positions_x[i], arrays.positions_y[i], arrays.positions_z[i]);
+    }
+
+    state.indices.assign(arrays.indices, arrays.indices + arrays.index_count);
+    state.quadrics.assign(arrays.vertex_count, Quadric());
+    state.geometric_error = 0.0f;
+
+    // Every vertex starts out with the planes of the triangles around it,
+    // plus a plane standing up along every open edge, so that collapses
+    // that would pull the edge in or out cost something too.
+    std::vector<std::pair<Uint32, Uint32>> edges;
+    edges.reserve(state.indices.size());
+    for (size_t i = 0; i < state.indices.size(); i += 3) {
+        const Uint32* triangle = &state.indices[i];
+        for (int j = 0; j < 3; j++) {
+            Uint32 a = triangle[j];
+            Uint32 b = triangle[(j + 1) % 3];
+            edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < state.indices.size(); i += 3) {
+        const Uint32* triangle = &state.indices[i];
+        glm::vec3 normal = glm::cross(state.positions[triangle[1]] - state.positions[triangle[0]],
+                                      state.positions[triangle[2]] - state.positions[triangle[0]]);
+        float length = glm::length(normal);
+        if (!(length > 0.0f)) {
+            continue;
+        }
+        normal /= length;
+
+        for (int j = 0; j < 3; j++) {
+            add_plane(state.quadrics[triangle[j]], normal, state.positions[triangle[j]]);
+        }
+
+        for (int j = 0; j < 3; j++) {
+            Uint32 a = triangle[j];
+            Uint32 b = triangle[(j + 1) % 3];
+            std::pair<Uint32, Uint32> edge = std::make_pair(std::min(a, b), std::max(a, b));
+
+            std::vector<std::pair<Uint32, Uint32>>::iterator it = std::lower_bound(edges.begin(), edges.end(), edge);
+            bool is_open_edge = (it + 1 == edges.end() || *(it + 1) != edge);
+            if (!is_open_edge) {
+                continue;
+            }
+
+            glm::vec3 edge_normal = glm::cross(state.positions[b] - state.positions[a], normal);
+            float edge_length = glm::length(edge_normal);
+            if (edge_length > 0.0f) {
+                add_plane(state.quadrics[a], edge_normal / edge_length, state.positions[a]);
+                add_plane(state.quadrics[b], edge_normal / edge_length, state.positions[a]);
+            }
+        }
+    }
+
+    // Vertices that sit on the same position are where attributes change,
+    // like along a texture seam. Moving only some of them would tear the
+    // surface apart there, so none of them ever move.
+    std::vector<Uint32> sorted_vertices(arrays.vertex_count);
+    for (int i = 0; i < arrays.vertex_count; i++) {
+        sorted_vertices[i] = static_cast<Uint32>(i);
+    }
+
+    const std::vector<glm::vec3>& positions = state.positions;
+    std::sort(sorted_vertices.begin(), sorted_vertices.end(), [&positions](Uint32 a, Uint32 b) {
+        const glm::vec3& a_position = positions[a];
+        const glm::vec3& b_position = positions[b];
+        if (a_position.x != b_position.x) {
+            return a_position.x < b_position.x;
+        } else if (a_position.y != b_position.y) {
+            return a_position.y < b_position.y;
+        }
+        return a_position.z < b_position.z;
+    });
+
+    state.is_locked.assign(arrays.vertex_count, false);
+    for (int i = 1; i < arrays.vertex_count; i++) {
+        if (positions[sorted_vertices[i]] == positions[sorted_vertices[i - 1]]) {
+            state.is_locked[sorted_vertices[i]] = true;
+            state.is_locked[sorted_vertices[i - 1]] = true;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+static void build_vertex_triangles(SimplificationState& state) {
+    int vertex_count = static_cast<int>(state.positions.size());
+    int triangle_count = static_cast<int>(state.indices.size() / 3);
+
+    state.first_vertex_triangle.assign(vertex_count + 1, 0);
+    for (Uint32 index : state.indices) {
+        state.first_vertex_triangle[index + 1]++;
+    }
+    for (int i = 0; i < vertex_count; i++) {
+        state.first_vertex_triangle[i + 1] += state.first_vertex_triangle[i];
+    }
+
+    std::vector<int> next_slots(state.first_vertex_triangle.begin(), state.first_vertex_triangle.end() - 1);
+    state.vertex_triangles.resize(state.indices.size());
+    for (int i = 0; i < triangle_count; i++) {
+        for (int j = 0; j < 3; j++) {
+            state.vertex_triangles[next_slots[state.indices[3 * i + j]]++] = i;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+// A collapse is only allowed if none of the triangles that stay around
+// would end up facing the other way, or with no area at all.
+static bool is_collapse_valid(const SimplificationState& state, Uint32 from, Uint32 to) {
+    for (int i = state.first_vertex_triangle[from]; i < state.first_vertex_triangle[from + 1]; i++) {
+        const Uint32* triangle = &state.indices[3 * state.vertex_triangles[i]];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+            continue;
+        }
+
+        glm::vec3 positions[3];
+        glm::vec3 moved_positions[3];
+        for (int j = 0; j < 3; j++) {
+            positions[j] = state.positions[triangle[j]];
+            moved_positions[j] = triangle[j] == from ? state.positions[to] : positions[j];
+        }
+
+        glm::vec3 normal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+        glm::vec3 moved_normal = glm::cross(moved_positions[1] - moved_positions[0], moved_positions[2] - moved_positions[0]);
+        if (!(glm::dot(normal, moved_normal) > 0.0f)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+// Collapses the cheapest edges first, until there are only target_triangle_count
+// triangles left. Once a vertex has been part of a collapse, the triangles
+// around it have changed, so it is left alone until the next pass. Returns
+// false if nothing could be collapsed at all.
+static bool run_collapse_pass(SimplificationState& state, int target_triangle_count) {
+    build_vertex_triangles(state);
+
+    state.collapses.clear();
+    for (size_t i = 0; i < state.indices.size(); i += 3) {
+        const Uint32* triangle = &state.indices[i];
+        for (int j = 0; j < 3; j++) {
+            Uint32 a = triangle[j];
+            Uint32 b = triangle[(j + 1) % 3];
+
+            if (!state.is_locked[a]) {
+                state.collapses.push_back({ collapse_cost(state, a, b), a, b });
+            }
+            if (!state.is_locked[b]) {
+                state.collapses.push_back({ collapse_cost(state, b, a), b, a });
+            }
+        }
+    }
+
+    std::sort(state.collapses.begin(), state.collapses.end(), [](const Collapse& a, const Collapse& b) {
+        return a.cost < b.cost;
+    });
+
+    state.is_touched.assign(state.positions.size(), false);
+    int triangle_count = static_cast<int>(state.indices.size() / 3);
+    bool has_collapsed = false;
+
+    for (const Collapse& collapse : state.collapses) {
+        if (triangle_count <= target_triangle_count) {
+            break;
+        }
+
+        if (state.is_touched[collapse.from] || state.is_touched[collapse.to] || !is_collapse_valid(state, collapse.from, collapse.to)) {
+            continue;
+        }
+
+        for (int i = state.first_vertex_triangle[collapse.from]; i < state.first_vertex_triangle[collapse.from + 1]; i++) {
+            Uint32* triangle = &state.indices[3 * state.vertex_triangles[i]];
+            bool has_to = triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to;
+
+            for (int j = 0; j < 3; j++) {
+                if (triangle[j] == collapse.from) {
+                    triangle[j] = collapse.to;
+                }
+                state.is_touched[triangle[j]] = true;
+            }
+
+            if (has_to) {
+                triangle_count--;
+            }
+        }
+
+        for (int i = 0; i < 10; i++) {
+            state.quadrics[collapse.to].values[i] += state.quadrics[collapse.from].values[i];
+        }
+
+        state.is_touched[collapse.from] = true;
+        state.geometric_error = std::max(state.geometric_error, static_cast<float>(std::sqrt(collapse.cost)));
+        has_collapsed = true;
+    }
+
+    // Triangles that lost a corner to a collapse have no area left.
+    size_t kept_index_count = 0;
+    for (size_t i = 0; i < state.indices.size(); i += 3) {
+        Uint32 a = state.indices[i];
+        Uint32 b = state.indices[i + 1];
+        Uint32 c = state.indices[i + 2];
+        if (a != b && b != c && c != a) {
+            state.indices[kept_index_count++] = a;
+            state.indices[kept_index_count++] = b;
+            state.indices[kept_index_count++] = c;
+        }
+    }
+    state.indices.resize(kept_index_count);
+
+    return has_collapsed;
+}
+
+// --------------------------------------------------------------------------
+
+// Copies the vertices that are still in use into a new object.
+static Object make_level_object(const SimplificationState& state, const MeshArrays& arrays) {
+    std::vector<Uint32> level_indices(arrays.vertex_count, UINT32_MAX);
+    Object level_object;
+
+    for (size_t i = 0; i < state.indices.size(); i += 3) {
+        Uint32 corners[3];
+        for (int j = 0; j < 3; j++) {
+            Uint32 index = state.indices[i + j];
+            if (level_indices[index] == UINT32_MAX) {
+                WorldVertex vertex = { state.positions[index], arrays.colors[index], arrays.tex_coords[index] };
+                level_indices[index] = level_object.add_vertex(vertex);
+            }
+
+            corners[j] = level_indices[index];
+        }
+
+        level_object.add_triangle(corners[0], corners[1], corners[2]);
+    }
+
+    return level_object;
+}
+
+// --------------------------------------------------------------------------
+
+std::vector<mesh_simplification::LevelOfDetail> mesh_simplification::build_lods(const Object& object, int min_triangle_count) {
+    std::vector<LevelOfDetail> lods;
+
+    MeshArrays arrays = object.get_arrays();
+    SimplificationState state;
+    initialize_state(state, arrays);
+
+    int previous_triangle_count = arrays.index_count / 3;
+    while (static_cast<int>(lods.size()) < MAX_LEVEL_COUNT) {
+        int target_triangle_count = previous_triangle_count / 2;
+        if (target_triangle_count < min_triangle_count) {
+            break;
+        }
+
+        while (static_cast<int>(state.indices.size() / 3) > target_triangle_count && run_collapse_pass(state, target_triangle_count)) {
+            // keep collapsing
+        }
+
+        // A level that barely got any smaller isn't worth keeping around,
+        // and means the rest of the mesh is locked or can't be collapsed.
+        int triangle_count = static_cast<int>(state.indices.size() / 3);
+        if (triangle_count > previous_triangle_count * 3 / 4) {
+            break;
+        }
+
+        lods.push_back({ make_level_object(state, arrays), state.geometric_error });
+        previous_triangle_count = triangle_count;
+    }
+
+    return lods;
+}
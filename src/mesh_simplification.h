@@ -0,0 +1,29 @@
+#ifndef MESH_SIMPLIFICATION_H
+#define MESH_SIMPLIFICATION_H
+
+#include <vector>
+
+#include "Object.h"
+
+namespace mesh_simplification {
+    // A coarser version of a mesh, along with how far, in object space, its
+    // surface may have moved away from the original one.
+    struct LevelOfDetail {
+        Object object;
+        float geometric_error;
+    };
+
+    // Builds progressively coarser versions of the object, each with about
+    // half the triangles of the one before it, by collapsing the edges whose
+    // removal changes the surface the least according to their quadric error.
+    // Levels stop once they would have fewer than min_triangle_count
+    // triangles, or once the mesh can't be simplified any further.
+    //
+    // Every collapse moves one vertex onto another one, so vertices are never
+    // invented and keep their colors and texture coordinates. Vertices that
+    // share their position with other vertices, like along texture seams,
+    // are never moved, which keeps the seams from opening up into cracks.
+    std::vector<LevelOfDetail> build_lods(const Object& object, int min_triangle_count);
+};
+
+#endif
@@ -11,20 +11,8 @@ Object primitives::quad(float length, float height, glm::vec3 color, float max_t
     glm::vec3 p2 = glm::vec3( length / 2,  height / 2, 0.0f);
     glm::vec3 p3 = glm::vec3(-length / 2,  height / 2, 0.0f);
 
-    WorldTriangle tri0 = {
-        { p0, color, glm::vec2(0.0f,              0.0f             ) },
-        { p1, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p2, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle tri1 = {
-        { p0, color, glm::vec2(0.0f,              0.0f             ) },
-        { p2, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p3, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
-
     Object quad;
-    quad.add_triangle(tri0);
-    quad.add_triangle(tri1);
+    add_quad_face(quad, p0, p1, p2, p3, color, max_texture_coord);
 
     return quad;
 }
@@ -45,84 +33,36 @@ Object primitives::cuboid(float length, float height, float depth, glm::vec3 col
     glm::vec3 p6 = glm::vec3( length / 2,  height / 2, -depth / 2);
     glm::vec3 p7 = glm::vec3(-length / 2,  height / 2, -depth / 2);
 
-    WorldTriangle face0_tri0 = {
-        { p0, color, glm::vec2(0.0f,              0.0f             ) },
-        { p1, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p2, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face0_tri1 = {
-        { p0, color, glm::vec2(0.0f,              0.0f             ) },
-        { p2, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p3, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
-
-    WorldTriangle face1_tri0 = {
-        { p1, color, glm::vec2(0.0f,              0.0f             ) },
-        { p5, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p6, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face1_tri1 = {
-        { p1, color, glm::vec2(0.0f,              0.0f             ) },
-        { p6, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p2, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
-
-    WorldTriangle face2_tri0 = {
-        { p5, color, glm::vec2(0.0f,              0.0f             ) },
-        { p4, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p7, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face2_tri1 = {
-        { p5, color, glm::vec2(0.0f,              0.0f             ) },
-        { p7, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p6, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
-
-    WorldTriangle face3_tri0 = {
-        { p4, color, glm::vec2(0.0f,              0.0f             ) },
-        { p0, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p3, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face3_tri1 = {
-        { p4, color, glm::vec2(0.0f,              0.0f             ) },
-        { p3, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p7, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
-
-    WorldTriangle face4_tri0 = {
-        { p3, color, glm::vec2(0.0f,              0.0f             ) },
-        { p2, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p6, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face4_tri1 = {
-        { p3, color, glm::vec2(0.0f,              0.0f             ) },
-        { p6, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p7, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
+    // Each face gets its own four vertices, since the corners they share
+    // with other faces have different texture coordinates on each face.
+    Object cuboid;
+    add_quad_face(cuboid, p0, p1, p2, p3, color, max_texture_coord);
+    add_quad_face(cuboid, p1, p5, p6, p2, color, max_texture_coord);
+    add_quad_face(cuboid, p5, p4, p7, p6, color, max_texture_coord);
+    add_quad_face(cuboid, p4, p0, p3, p7, color, max_texture_coord);
+    add_quad_face(cuboid, p3, p2, p6, p7, color, max_texture_coord);
+    add_quad_face(cuboid, p1, p0, p4, p5, color, max_texture_coord);
+
+    return cuboid;
+}
 
-    WorldTriangle face5_tri0 = {
-        { p1, color, glm::vec2(0.0f,              0.0f             ) },
-        { p0, color, glm::vec2(max_texture_coord, 0.0f             ) },
-        { p4, color, glm::vec2(max_texture_coord, max_texture_coord) },
-    };
-    WorldTriangle face5_tri1 = {
-        { p1, color, glm::vec2(0.0f,              0.0f             ) },
-        { p4, color, glm::vec2(max_texture_coord, max_texture_coord) },
-        { p5, color, glm::vec2(0.0f,              max_texture_coord) },
-    };
+// --------------------------------------------------------------------------
 
-    Object quad;
-    quad.add_triangle(face0_tri0);
-    quad.add_triangle(face0_tri1);
-    quad.add_triangle(face1_tri0);
-    quad.add_triangle(face1_tri1);
-    quad.add_triangle(face2_tri0);
-    quad.add_triangle(face2_tri1);
-    quad.add_triangle(face3_tri0);
-    quad.add_triangle(face3_tri1);
-    quad.add_triangle(face4_tri0);
-    quad.add_triangle(face4_tri1);
-    quad.add_triangle(face5_tri0);
-    quad.add_triangle(face5_tri1);
-    return quad;
+// Adds a counter-clockwise quad made of two triangles that share the p0-p2
+// diagonal, with the texture's origin at p0.
+void primitives::add_quad_face(Object& object,
+                               const glm::vec3& p0,
+                               const glm::vec3& p1,
+                               const glm::vec3& p2,
+                               const glm::vec3& p3,
+                               const glm::vec3& color,
+                               float max_texture_coord) {
+
+    Uint32 index0 = object.add_vertex({ p0, color, glm::vec2(0.0f,              0.0f             ) });
+    Uint32 index1 = object.add_vertex({ p1, color, glm::vec2(max_texture_coord, 0.0f             ) });
+    Uint32 index2 = object.add_vertex({ p2, color, glm::vec2(max_texture_coord, max_texture_coord) });
+    Uint32 index3 = object.add_vertex({ p3, color, glm::vec2(0.0f,              max_texture_coord) });
+
+    object.add_triangle(index0, index1, index2);
+    object.add_triangle(index0, index2, index3);
 }
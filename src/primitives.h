@@ -8,6 +8,14 @@
 namespace primitives {
     Object quad(float length, float height, glm::vec3 color, float max_texture_coord);
     Object cuboid(float length, float height, float depth, glm::vec3 color, float max_texture_coord);
+
+    void add_quad_face(Object& object,
+                       const glm::vec3& p0,
+                       const glm::vec3& p1,
+                       const glm::vec3& p2,
+                       const glm::vec3& p3,
+                       const glm::vec3& color,
+                       float max_texture_coord);
 };
 
 #endif
@@ -0,0 +1,244 @@
+#include "raster_kernels.h"
+
+namespace {
+    template<typename Variant>
+    struct ScalarKernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_pixels<Variant>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant, int SAMPLE_COUNT>
+    struct MultisampleKernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_samples<Variant, SAMPLE_COUNT>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant>
+    using Multisample2xKernel = MultisampleKernel<Variant, 2>;
+
+    template<typename Variant>
+    using Multisample4xKernel = MultisampleKernel<Variant, 4>;
+
+    // There are no multisampled visibility kernels, so this is the usual
+    // selection without them.
+    template<template<typename> class Kernel>
+    raster_kernels::TriangleKernel select_multisample_variant(const raster_kernels::RenderState& render_state) {
+        const texture::TextureFilter UNUSED_FILTER = texture::TextureFilter::NEAREST;
+        const texture::TextureWrap UNUSED_WRAP = texture::TextureWrap::CLAMP;
+
+        if (render_state.is_counting_overdraw) {
+            return raster_kernels::select_depth_variant<raster_kernels::TriangleKernel, Kernel, raster_kernels::Shading::OVERDRAW, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+        }
+
+        return raster_kernels::select_shading_variant<raster_kernels::TriangleKernel, Kernel>(render_state);
+    }
+
+    template<typename Variant, int SPAN_LENGTH>
+    struct SubdividedKernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_subdivided_spans<Variant, SPAN_LENGTH>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant>
+    using Subdivided8Kernel = SubdividedKernel<Variant, 8>;
+
+    template<typename Variant>
+    using Subdivided16Kernel = SubdividedKernel<Variant, 16>;
+
+    // The depth state doesn't matter when resolving, so every depth variant
+    // shares a single copy of each shader.
+    template<typename Variant>
+    struct ResolveShader {
+        static void run(const TriangleSetup& setup,
+                        const texture::Texture* texture,
+                        const raster_kernels::RenderTarget& target,
+                        int y,
+                        int min_x,
+                        int max_x) {
+
+            typedef raster_kernels::KernelVariant<Variant::SHADING, Variant::FILTER, Variant::WRAP, true, true, raster_kernels::DepthFormat::FLOAT> ShadingVariant;
+            raster_kernels::resolve_pixel_span<ShadingVariant>(setup, texture, target, y, min_x, max_x);
+        }
+    };
+};
+
+// --------------------------------------------------------------------------
+
+bool raster_kernels::is_kernel_type_supported(const KernelType kernel_type) {
+    switch (kernel_type) {
+        case KernelType::SCALAR:
+            return true;
+
+#if defined(__x86_64__) || defined(_M_X64)
+        case KernelType::SSE2:
+            return SDL_HasSSE2();
+
+        case KernelType::AVX2:
+            return SDL_HasAVX2();
+#endif
+
+        default:
+            return false;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::KernelType raster_kernels::best_supported_kernel_type() {
+    if (is_kernel_type_supported(KernelType::AVX2)) {
+        return KernelType::AVX2;
+    } else if (is_kernel_type_supported(KernelType::SSE2)) {
+        return KernelType::SSE2;
+    }
+
+    return KernelType::SCALAR;
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_kernel(const KernelType kernel_type, const RenderState& render_state) {
+    if (!is_kernel_type_supported(kernel_type)) {
+        return get_scalar_kernel(render_state);
+    }
+
+    switch (kernel_type) {
+        case KernelType::SSE2:
+            return get_sse2_kernel(render_state);
+
+        case KernelType::AVX2:
+            return get_avx2_kernel(render_state);
+
+        default:
+            return get_scalar_kernel(render_state);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+const char* raster_kernels::kernel_type_name(const KernelType kernel_type) {
+    switch (kernel_type) {
+        case KernelType::SSE2:
+            return "SSE2";
+
+        case KernelType::AVX2:
+            return "AVX2";
+
+        default:
+            return "scalar";
+    }
+}
+
+// --------------------------------------------------------------------------
+
+int raster_kernels::depth_format_size(const DepthFormat depth_format) {
+    switch (depth_format) {
+        case DepthFormat::UNORM16:
+            return sizeof(DepthTraits<DepthFormat::UNORM16>::Value);
+
+        case DepthFormat::UNORM24:
+            return sizeof(DepthTraits<DepthFormat::UNORM24>::Value);
+
+        default:
+            return sizeof(DepthTraits<DepthFormat::FLOAT>::Value);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+const char* raster_kernels::depth_format_name(const DepthFormat depth_format) {
+    switch (depth_format) {
+        case DepthFormat::REVERSED_FLOAT:
+            return "reversed float";
+
+        case DepthFormat::UNORM16:
+            return "16-bit";
+
+        case DepthFormat::UNORM24:
+            return "24-bit";
+
+        default:
+            return "float";
+    }
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_scalar_kernel(const RenderState& render_state) {
+    return select_kernel_variant<ScalarKernel>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_multisample_kernel(int sample_count, const RenderState& render_state) {
+    if (sample_count == 2) {
+        return select_multisample_variant<Multisample2xKernel>(render_state);
+    }
+
+    return select_multisample_variant<Multisample4xKernel>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_subdivided_kernel(const KernelType kernel_type, int span_length, const RenderState& render_state) {
+    if (!is_kernel_type_supported(kernel_type)) {
+        return get_scalar_subdivided_kernel(span_length, render_state);
+    }
+
+    switch (kernel_type) {
+        case KernelType::SSE2:
+            return get_sse2_subdivided_kernel(span_length, render_state);
+
+        case KernelType::AVX2:
+            return get_avx2_subdivided_kernel(span_length, render_state);
+
+        default:
+            return get_scalar_subdivided_kernel(span_length, render_state);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_scalar_subdivided_kernel(int span_length, const RenderState& render_state) {
+    if (span_length == 8) {
+        return select_shading_variant<TriangleKernel, Subdivided8Kernel>(render_state);
+    }
+
+    return select_shading_variant<TriangleKernel, Subdivided16Kernel>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::SpanShader raster_kernels::get_resolve_shader(const RenderState& render_state) {
+    return select_shading_variant<SpanShader, ResolveShader>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+void raster_kernels::add_pixel_stats(PixelStats& total, const PixelStats& stats) {
+    total.visited_pixels += stats.visited_pixels;
+    total.covered_pixels += stats.covered_pixels;
+    total.depth_rejected_pixels += stats.depth_rejected_pixels;
+    total.shaded_pixels += stats.shaded_pixels;
+    total.resolved_pixels += stats.resolved_pixels;
+}
@@ -0,0 +1,1046 @@
+#ifndef RASTER_KERNELS_H
+#define RASTER_KERNELS_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "texture.h"
+
+// An edge function evaluated at the center of the triangle's first pixel,
+// along with how much it changes when stepping one pixel right or down.
+// Everything is kept in integers so that stepping is exact.
+struct EdgeFunction {
+    Sint64 value;
+    Sint64 step_x;
+    Sint64 step_y;
+};
+
+// A screen-space linear attribute: its value at the center of the triangle's
+// first pixel and its change per pixel in x and y.
+struct AttributePlane {
+    float value;
+    float step_x;
+    float step_y;
+};
+
+struct TriangleSetup {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+
+    EdgeFunction edges[3];
+
+    AttributePlane depth;
+    AttributePlane inverse_z;
+    AttributePlane color_over_z[3];
+    AttributePlane tex_coord_over_z[2];
+
+    // No pixel of the triangle is nearer than this, which is what lets whole
+    // blocks of pixels be rejected against the coarse depth buffer.
+    float min_depth;
+};
+
+namespace raster_kernels {
+    enum class KernelType {
+        SCALAR,
+        SSE2,
+        AVX2,
+    };
+
+    // An inclusive rectangle of pixels that a kernel may touch.
+    struct PixelRect {
+        int min_x;
+        int min_y;
+        int max_x;
+        int max_y;
+    };
+
+    // The depth buffer is split into square blocks that each remember the
+    // farthest depth stored in them. Blocks never straddle a tile.
+    static const int DEPTH_BLOCK_SIZE = 8;
+
+    // How depths are stored. Whatever the format, smaller depths are nearer
+    // and a pixel passes the depth test when its depth is no farther than
+    // what is stored.
+    //
+    // FLOAT is normalized device z, which spends nearly all of its
+    // precision right in front of the near plane. REVERSED_FLOAT is the
+    // negated reversed-Z depth, which goes from -1 at the near plane to 0 at
+    // the far plane, so the far end gets the densest floats and the
+    // precision comes out about even over the whole range. The two share
+    // their kernels. UNORM16 and UNORM24 are window depth, from 0 at the
+    // near plane to 1 at the far plane, as 16-bit or 24-bit integers. The
+    // 16-bit format takes half the memory and bandwidth of the others, and
+    // the 24-bit one is stored in 32 bits.
+    enum class DepthFormat {
+        FLOAT,
+        REVERSED_FLOAT,
+        UNORM16,
+        UNORM24,
+    };
+
+    // How each format is stored. Depth planes are set up in the format's
+    // own units, so the integer formats only have to round to store them.
+    // Rounding is to the nearest integer, with ties to even, which is what
+    // the SIMD conversions do too.
+    template<DepthFormat FORMAT>
+    struct DepthTraits {
+        typedef float Value;
+
+        static inline Value to_stored(float depth) {
+            return depth;
+        }
+    };
+
+    template<DepthFormat FORMAT, typename STORED_VALUE, Uint32 MAX_VALUE_VALUE>
+    struct UnormDepthTraits {
+        typedef STORED_VALUE Value;
+        static constexpr Uint32 MAX_VALUE = MAX_VALUE_VALUE;
+
+        // NaNs end up as the nearest depth, so that they never fail a depth
+        // test, just like they don't with floats.
+        static inline Value to_stored(float depth) {
+            float clamped_depth = depth > 0.0f ? depth : 0.0f;
+            clamped_depth = clamped_depth < static_cast<float>(MAX_VALUE) ? clamped_depth : static_cast<float>(MAX_VALUE);
+
+            return static_cast<Value>(std::lrint(clamped_depth));
+        }
+    };
+
+    template<>
+    struct DepthTraits<DepthFormat::UNORM16> : UnormDepthTraits<DepthFormat::UNORM16, Uint16, 0xFFFF> {};
+
+    template<>
+    struct DepthTraits<DepthFormat::UNORM24> : UnormDepthTraits<DepthFormat::UNORM24, Uint32, 0xFFFFFF> {};
+
+    int depth_format_size(DepthFormat depth_format);
+    const char* depth_format_name(DepthFormat depth_format);
+
+    // Multisampled pixels have their samples at these positions, given in
+    // sixteenths of a pixel from the pixel's center, which is the same grid
+    // the vertices are snapped to. They are the usual rotated grid patterns,
+    // so that nearly horizontal and nearly vertical edges both get as many
+    // steps as there are samples.
+    static const int SAMPLE_POSITION_STEPS = 16;
+    static const int SAMPLE_POSITIONS_2X[2][2] = { { 4, 4 }, { -4, -4 } };
+    static const int SAMPLE_POSITIONS_4X[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+
+    // No sample is farther than this from its pixel's center along x or y.
+    static const int MAX_SAMPLE_OFFSET = 6;
+
+    // The depth buffer holds DepthTraits<FORMAT>::Value depths, for whatever
+    // format the kernels were picked for. The farthest depth in every block
+    // is kept as a float in any format, which holds 24-bit integers exactly.
+    struct RenderTarget {
+        Uint32* color_buffer;
+        void* depth_buffer;
+        float* block_max_depth;
+        int width;
+        int height;
+        int block_columns;
+
+        // How many times each pixel has been shaded, or null when nobody is
+        // looking at the overdraw.
+        Uint16* shade_counts;
+
+        // One plus the id of the triangle that was last drawn over each
+        // pixel, or null unless shading is deferred. Zero means no triangle
+        // has been drawn there since the pixels were last resolved.
+        Uint32* visibility_buffer;
+
+        // With more than one sample per pixel, the depth buffer holds every
+        // sample's depth, one pixel's samples after another, and the sample
+        // colors are stored the same way. They are averaged into the color
+        // buffer once the pixels are done.
+        int sample_count;
+        Uint32* sample_colors;
+    };
+
+    // What the kernels did with the pixels they were handed. Pixels in
+    // depth blocks that were skipped as a whole never count as visited.
+    // When shading is deferred, shaded pixels only had their triangle
+    // recorded, and resolved pixels are the ones that really got shaded.
+    struct PixelStats {
+        Uint64 visited_pixels;
+        Uint64 covered_pixels;
+        Uint64 depth_rejected_pixels;
+        Uint64 shaded_pixels;
+        Uint64 resolved_pixels;
+    };
+
+    // Everything about how triangles are drawn that stays the same for at
+    // least a whole draw. Every combination gets its own kernel with the
+    // state compiled in, so the kernels never check any of it per pixel.
+    // Counting overdraw only counts, and doesn't shade anything. Deferred
+    // kernels only record which triangle is visible, and leave the shading to
+    // a resolve pass.
+    struct RenderState {
+        bool is_textured;
+        texture::TextureFilter texture_filter;
+        texture::TextureWrap texture_wrap;
+        bool is_depth_tested;
+        bool is_depth_written;
+        bool is_counting_overdraw;
+        bool is_shading_deferred;
+        DepthFormat depth_format;
+    };
+
+    // Kernels only draw the part of the triangle that lies within the clip
+    // rectangle, and they draw it exactly the same way no matter what the
+    // rectangle is. They return true if they wrote to the depth buffer, and
+    // add what they did to the pixel stats. The texture is only used by
+    // textured kernels, and the triangle id only by deferred ones.
+    typedef bool (*TriangleKernel)(const TriangleSetup& setup, const PixelRect& clip_rect, const RenderTarget& target, const texture::Texture* texture, Uint32 triangle_id, PixelStats& pixel_stats);
+
+    // Resolving shades the pixels from min_x to max_x in row y, which the
+    // visibility buffer says the triangle is visible in, exactly like the
+    // forward kernels would have.
+    typedef void (*SpanShader)(const TriangleSetup& setup, const texture::Texture* texture, const RenderTarget& target, int y, int min_x, int max_x);
+
+    // Triangles drawn with a fragment shader have up to this many floats of
+    // varyings.
+    static const int MAX_VARYING_COUNT = 16;
+
+    // What the kernels of a triangle drawn with a fragment shader need on
+    // top of its setup: a plane for each of its varyings over z, and the
+    // shader itself, whose type only the kernels know.
+    struct ShaderBinding {
+        const AttributePlane* varying_planes;
+        const void* fragment_shader;
+    };
+
+    // The same as the kernels and resolve shaders above, but for triangles
+    // drawn with a fragment shader. shader_pipeline.h has the only ones.
+    typedef bool (*ShaderKernel)(const TriangleSetup& setup, const ShaderBinding& binding, const PixelRect& clip_rect, const RenderTarget& target, PixelStats& pixel_stats);
+    typedef void (*ShaderSpanShader)(const TriangleSetup& setup, const ShaderBinding& binding, const RenderTarget& target, int y, int min_x, int max_x);
+
+    bool is_kernel_type_supported(const KernelType kernel_type);
+    KernelType best_supported_kernel_type();
+    TriangleKernel get_kernel(const KernelType kernel_type, const RenderState& render_state);
+    const char* kernel_type_name(const KernelType kernel_type);
+
+    TriangleKernel get_scalar_kernel(const RenderState& render_state);
+    TriangleKernel get_sse2_kernel(const RenderState& render_state);
+    TriangleKernel get_avx2_kernel(const RenderState& render_state);
+
+    // Multisampled kernels test coverage and depth at every sample, but
+    // shade each pixel only once per triangle, at the pixel's center. There
+    // is only a scalar version of them, and they can't defer shading, so
+    // the kernel type and deferred shading are ignored.
+    TriangleKernel get_multisample_kernel(int sample_count, const RenderState& render_state);
+
+    // Subdivided kernels are meant for large triangles, and only divide by
+    // the interpolated 1/z every span_length pixels along each row, which
+    // can be 8 or 16. Every kernel type draws exactly the same pixels with
+    // them. They only shade forward, so overdraw counting and deferred
+    // shading are ignored.
+    TriangleKernel get_subdivided_kernel(const KernelType kernel_type, int span_length, const RenderState& render_state);
+
+    TriangleKernel get_scalar_subdivided_kernel(int span_length, const RenderState& render_state);
+    TriangleKernel get_sse2_subdivided_kernel(int span_length, const RenderState& render_state);
+    TriangleKernel get_avx2_subdivided_kernel(int span_length, const RenderState& render_state);
+
+    // Only the shading part of the render state matters here.
+    SpanShader get_resolve_shader(const RenderState& render_state);
+
+    void add_pixel_stats(PixelStats& total, const PixelStats& stats);
+
+    enum class Shading {
+        VERTEX_COLOR,
+        TEXTURE,
+        OVERDRAW,
+        VISIBILITY,
+
+        // Only the kernels in shader_pipeline.h shade this way, with a
+        // fragment shader that gets the triangle's own varyings.
+        FRAGMENT_SHADER,
+    };
+
+    // The render state as compile-time constants. The filter and wrap mode
+    // only mean something to textured variants, and the depth format only to
+    // variants that test or write depth. REVERSED_FLOAT depths are stored
+    // just like FLOAT ones, so it never shows up here.
+    template<Shading SHADING_VALUE,
+             texture::TextureFilter FILTER_VALUE,
+             texture::TextureWrap WRAP_VALUE,
+             bool IS_DEPTH_TESTED_VALUE,
+             bool IS_DEPTH_WRITTEN_VALUE,
+             DepthFormat DEPTH_FORMAT_VALUE>
+    struct KernelVariant {
+        static constexpr Shading SHADING = SHADING_VALUE;
+        static constexpr texture::TextureFilter FILTER = FILTER_VALUE;
+        static constexpr texture::TextureWrap WRAP = WRAP_VALUE;
+        static constexpr bool IS_DEPTH_TESTED = IS_DEPTH_TESTED_VALUE;
+        static constexpr bool IS_DEPTH_WRITTEN = IS_DEPTH_WRITTEN_VALUE;
+        static constexpr DepthFormat DEPTH_FORMAT = DEPTH_FORMAT_VALUE;
+
+        typedef DepthTraits<DEPTH_FORMAT_VALUE> Depth;
+
+        static constexpr bool USES_MIPMAPS = FILTER_VALUE == texture::TextureFilter::NEAREST_MIPMAP
+                                          || FILTER_VALUE == texture::TextureFilter::TRILINEAR;
+    };
+
+    // ----------------------------------------------------------------------
+
+    // These are shared by every kernel. They have internal linkage on purpose:
+    // the SIMD kernels are compiled for instruction sets the CPU might not
+    // have, so they must never end up sharing a copy with the scalar path.
+
+    static inline float evaluate_plane(const AttributePlane& plane, float offset_x, float offset_y) {
+        return plane.value + plane.step_x * offset_x + plane.step_y * offset_y;
+    }
+
+    // Intersects the clip rectangle with the triangle's bounding box, and
+    // returns false if nothing is left.
+    static inline bool clip_to_triangle(const TriangleSetup& setup, const PixelRect& clip_rect, PixelRect& result) {
+        result.min_x = std::max(setup.min_x, clip_rect.min_x);
+        result.min_y = std::max(setup.min_y, clip_rect.min_y);
+        result.max_x = std::min(setup.max_x, clip_rect.max_x);
+        result.max_y = std::min(setup.max_y, clip_rect.max_y);
+
+        return result.min_x <= result.max_x && result.min_y <= result.max_y;
+    }
+
+    static inline Sint64 edge_value_at(const EdgeFunction& edge, const TriangleSetup& setup, int x, int y) {
+        return edge.value + edge.step_x * (x - setup.min_x) + edge.step_y * (y - setup.min_y);
+    }
+
+    static inline int count_set_bits(int bits) {
+        int count = 0;
+        for (; bits != 0; bits &= bits - 1) {
+            count++;
+        }
+
+        return count;
+    }
+
+    static inline Uint32 pack_color(const glm::vec3& color) {
+        Uint32 r = static_cast<Uint32>(color.r * 255);
+        Uint32 g = static_cast<Uint32>(color.g * 255);
+        Uint32 b = static_cast<Uint32>(color.b * 255);
+
+        return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+    }
+
+    // The farthest depth stored in the block whose top left pixel is given.
+    // A NaN depth never fails a depth test, so it counts as infinitely far.
+    template<DepthFormat DEPTH_FORMAT>
+    static inline float max_depth_in_block(const RenderTarget& target, int origin_x, int origin_y) {
+        typedef typename DepthTraits<DEPTH_FORMAT>::Value DepthValue;
+
+        int end_x = std::min(origin_x + DEPTH_BLOCK_SIZE, target.width);
+        int end_y = std::min(origin_y + DEPTH_BLOCK_SIZE, target.height);
+
+        DepthValue max_depth = std::numeric_limits<DepthValue>::lowest();
+        bool has_nan = false;
+        for (int y = origin_y; y < end_y; y++) {
+            const DepthValue* depth_row = static_cast<const DepthValue*>(target.depth_buffer) + y * target.width * target.sample_count;
+            for (int x = origin_x * target.sample_count; x < end_x * target.sample_count; x++) {
+                DepthValue depth = depth_row[x];
+                max_depth = depth > max_depth ? depth : max_depth;
+                has_nan |= depth != depth;
+            }
+        }
+
+        return has_nan ? INFINITY : static_cast<float>(max_depth);
+    }
+
+    // False if no sample in the block can pass all three edge tests. Samples
+    // are sample_reach sixteenths of a pixel away from the pixel centers at
+    // most, which is zero when the pixels aren't multisampled.
+    static inline bool may_cover_block(const TriangleSetup& setup, int origin_x, int origin_y, int sample_reach) {
+        const Sint64 LAST_PIXEL = DEPTH_BLOCK_SIZE - 1;
+
+        for (int i = 0; i < 3; i++) {
+            const EdgeFunction& edge = setup.edges[i];
+            Sint64 max_value = edge_value_at(edge, setup, origin_x, origin_y)
+                             + std::max(edge.step_x, static_cast<Sint64>(0)) * LAST_PIXEL
+                             + std::max(edge.step_y, static_cast<Sint64>(0)) * LAST_PIXEL
+                             + (std::abs(edge.step_x) + std::abs(edge.step_y)) * sample_reach / SAMPLE_POSITION_STEPS;
+            if (max_value < 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Walks the part of the triangle inside the clip rectangle one depth
+    // block at a time and hands every block that might still show some of
+    // the triangle to rasterize_block(block_rect), which returns true if it
+    // shaded any pixels. Blocks that are entirely outside the triangle, or
+    // entirely behind what is already there when depth testing, are skipped.
+    template<typename Variant, int SAMPLE_COUNT = 1, typename BlockRasterizer>
+    static inline bool rasterize_depth_blocks(const TriangleSetup& setup,
+                                              const PixelRect& clip_rect,
+                                              const RenderTarget& target,
+                                              PixelStats& pixel_stats,
+                                              BlockRasterizer&& rasterize_block) {
+
+        PixelRect rect;
+        if (!clip_to_triangle(setup, clip_rect, rect)) {
+            return false;
+        }
+
+        bool wrote_depth = false;
+        for (int block_y = rect.min_y / DEPTH_BLOCK_SIZE; block_y <= rect.max_y / DEPTH_BLOCK_SIZE; block_y++) {
+            for (int block_x = rect.min_x / DEPTH_BLOCK_SIZE; block_x <= rect.max_x / DEPTH_BLOCK_SIZE; block_x++) {
+                float& block_max_depth = target.block_max_depth[block_y * target.block_columns + block_x];
+                if (Variant::IS_DEPTH_TESTED && setup.min_depth > block_max_depth) {
+                    continue;
+                }
+
+                int origin_x = block_x * DEPTH_BLOCK_SIZE;
+                int origin_y = block_y * DEPTH_BLOCK_SIZE;
+                if (!may_cover_block(setup, origin_x, origin_y, SAMPLE_COUNT > 1 ? MAX_SAMPLE_OFFSET : 0)) {
+                    continue;
+                }
+
+                PixelRect block_rect;
+                block_rect.min_x = std::max(origin_x, rect.min_x);
+                block_rect.min_y = std::max(origin_y, rect.min_y);
+                block_rect.max_x = std::min(origin_x + DEPTH_BLOCK_SIZE - 1, rect.max_x);
+                block_rect.max_y = std::min(origin_y + DEPTH_BLOCK_SIZE - 1, rect.max_y);
+
+                pixel_stats.visited_pixels += (block_rect.max_x - block_rect.min_x + 1) * (block_rect.max_y - block_rect.min_y + 1);
+
+                if (rasterize_block(block_rect) && Variant::IS_DEPTH_WRITTEN) {
+                    block_max_depth = max_depth_in_block<Variant::DEPTH_FORMAT>(target, origin_x, origin_y);
+                    wrote_depth = true;
+                }
+            }
+        }
+
+        return wrote_depth;
+    }
+
+    static inline glm::vec2 texture_coordinate_at(const TriangleSetup& setup, float offset_x, float offset_y) {
+        glm::vec2 interpolated_tex_coord_over_z = glm::vec2(
+            evaluate_plane(setup.tex_coord_over_z[0], offset_x, offset_y),
+            evaluate_plane(setup.tex_coord_over_z[1], offset_x, offset_y)
+        );
+
+        return interpolated_tex_coord_over_z / evaluate_plane(setup.inverse_z, offset_x, offset_y);
+    }
+
+    // Like on a GPU, the texture's level of detail comes from how much the
+    // texture coordinates change across the 2x2 quad of pixels that the given
+    // pixel belongs to, whether or not the triangle covers the whole quad.
+    // Every pixel of a quad gets the same level no matter which kernel
+    // shades it.
+    static inline float texture_lod_at_quad(const TriangleSetup& setup, const texture::Texture* texture, int x, int y) {
+        float quad_offset_x = static_cast<float>((x & ~1) - setup.min_x);
+        float quad_offset_y = static_cast<float>((y & ~1) - setup.min_y);
+
+        glm::vec2 quad_tex_coord = texture_coordinate_at(setup, quad_offset_x, quad_offset_y);
+        glm::vec2 right_tex_coord = texture_coordinate_at(setup, quad_offset_x + 1.0f, quad_offset_y);
+        glm::vec2 below_tex_coord = texture_coordinate_at(setup, quad_offset_x, quad_offset_y + 1.0f);
+
+        return texture->compute_lod(right_tex_coord - quad_tex_coord, below_tex_coord - quad_tex_coord);
+    }
+
+    // The color of a pixel that the triangle covers.
+    template<typename Variant>
+    static inline Uint32 shade_pixel(const TriangleSetup& setup, const texture::Texture* texture, int x, int y) {
+        float offset_x = static_cast<float>(x - setup.min_x);
+        float offset_y = static_cast<float>(y - setup.min_y);
+
+        float interpolated_inverse_z = evaluate_plane(setup.inverse_z, offset_x, offset_y);
+
+        glm::vec3 color;
+        if constexpr (Variant::SHADING == Shading::VERTEX_COLOR) {
+            glm::vec3 interpolated_color_over_z = glm::vec3(
+                evaluate_plane(setup.color_over_z[0], offset_x, offset_y),
+                evaluate_plane(setup.color_over_z[1], offset_x, offset_y),
+                evaluate_plane(setup.color_over_z[2], offset_x, offset_y)
+            );
+
+            color = interpolated_color_over_z / interpolated_inverse_z;
+            color = glm::clamp(color, 0.0f, 1.0f);
+        } else {
+            glm::vec2 interpolated_tex_coord_over_z = glm::vec2(
+                evaluate_plane(setup.tex_coord_over_z[0], offset_x, offset_y),
+                evaluate_plane(setup.tex_coord_over_z[1], offset_x, offset_y)
+            );
+
+            glm::vec2 interpolated_perspective_corrected_uv = interpolated_tex_coord_over_z / interpolated_inverse_z;
+
+            float lod = 0.0f;
+            if constexpr (Variant::USES_MIPMAPS) {
+                lod = texture_lod_at_quad(setup, texture, x, y);
+            }
+
+            color = texture->sample<Variant::FILTER, Variant::WRAP>(interpolated_perspective_corrected_uv, lod);
+        }
+
+        return pack_color(color);
+    }
+
+    // Depth tests, shades and writes a pixel already known to be covered, and
+    // returns false if it failed the depth test. Forward variants get the
+    // pixel's color from shade(x, y).
+    template<typename Variant, typename PixelShader>
+    static inline bool shade_covered_pixel_with(const TriangleSetup& setup,
+                                                const RenderTarget& target,
+                                                Uint32 triangle_id,
+                                                int x,
+                                                int y,
+                                                PixelShader&& shade) {
+
+        float offset_x = static_cast<float>(x - setup.min_x);
+        float offset_y = static_cast<float>(y - setup.min_y);
+
+        typedef typename Variant::Depth::Value DepthValue;
+
+        DepthValue depth = Variant::Depth::to_stored(evaluate_plane(setup.depth, offset_x, offset_y));
+        int buffer_index = y * target.width + x;
+        DepthValue* depth_buffer = static_cast<DepthValue*>(target.depth_buffer);
+        if (Variant::IS_DEPTH_TESTED && depth > depth_buffer[buffer_index]) {
+            return false;
+        }
+
+        if (Variant::IS_DEPTH_WRITTEN) {
+            depth_buffer[buffer_index] = depth;
+        }
+
+        if constexpr (Variant::SHADING == Shading::OVERDRAW) {
+            target.shade_counts[buffer_index]++;
+        } else if constexpr (Variant::SHADING == Shading::VISIBILITY) {
+            target.visibility_buffer[buffer_index] = triangle_id + 1;
+        } else {
+            target.color_buffer[buffer_index] = shade(x, y);
+        }
+
+        return true;
+    }
+
+    template<typename Variant>
+    static inline bool shade_covered_pixel(const TriangleSetup& setup,
+                                           const RenderTarget& target,
+                                           const texture::Texture* texture,
+                                           Uint32 triangle_id,
+                                           int x,
+                                           int y) {
+
+        return shade_covered_pixel_with<Variant>(setup, target, triangle_id, x, y, [&](int pixel_x, int pixel_y) {
+            return shade_pixel<Variant>(setup, texture, pixel_x, pixel_y);
+        });
+    }
+
+    template<typename Variant>
+    static void resolve_pixel_span(const TriangleSetup& setup, const texture::Texture* texture, const RenderTarget& target, int y, int min_x, int max_x) {
+        Uint32* color_row = target.color_buffer + y * target.width;
+        for (int x = min_x; x <= max_x; x++) {
+            color_row[x] = shade_pixel<Variant>(setup, texture, x, y);
+        }
+    }
+
+    // This is the reference kernel: one pixel at a time, no SIMD. The other
+    // kernels must produce the exact same pixels. Forward variants get each
+    // pixel's color from shade(x, y).
+    template<typename Variant, typename PixelShader>
+    static bool rasterize_triangle_pixels_with(const TriangleSetup& setup,
+                                               const PixelRect& clip_rect,
+                                               const RenderTarget& target,
+                                               Uint32 triangle_id,
+                                               PixelStats& pixel_stats,
+                                               PixelShader&& shade) {
+
+        return rasterize_depth_blocks<Variant>(setup, clip_rect, target, pixel_stats, [&](const PixelRect& block_rect) {
+            bool has_shaded = false;
+
+            Sint64 row_w0 = edge_value_at(setup.edges[0], setup, block_rect.min_x, block_rect.min_y);
+            Sint64 row_w1 = edge_value_at(setup.edges[1], setup, block_rect.min_x, block_rect.min_y);
+            Sint64 row_w2 = edge_value_at(setup.edges[2], setup, block_rect.min_x, block_rect.min_y);
+
+            for (int y = block_rect.min_y; y <= block_rect.max_y; y++) {
+                Sint64 w0 = row_w0;
+                Sint64 w1 = row_w1;
+                Sint64 w2 = row_w2;
+
+                row_w0 += setup.edges[0].step_y;
+                row_w1 += setup.edges[1].step_y;
+                row_w2 += setup.edges[2].step_y;
+
+                for (int x = block_rect.min_x; x <= block_rect.max_x; x++) {
+                    // The fill rule bias is already folded into the edge values, so a
+                    // pixel is covered exactly when all three of them are non-negative.
+                    bool is_covered = (w0 | w1 | w2) >= 0;
+
+                    w0 += setup.edges[0].step_x;
+                    w1 += setup.edges[1].step_x;
+                    w2 += setup.edges[2].step_x;
+
+                    if (!is_covered) {
+                        continue;
+                    }
+
+                    pixel_stats.covered_pixels++;
+                    if (shade_covered_pixel_with<Variant>(setup, target, triangle_id, x, y, shade)) {
+                        pixel_stats.shaded_pixels++;
+                        has_shaded = true;
+                    } else {
+                        pixel_stats.depth_rejected_pixels++;
+                    }
+                }
+            }
+
+            return has_shaded;
+        });
+    }
+
+    template<typename Variant>
+    static bool rasterize_triangle_pixels(const TriangleSetup& setup,
+                                          const PixelRect& clip_rect,
+                                          const RenderTarget& target,
+                                          const texture::Texture* texture,
+                                          Uint32 triangle_id,
+                                          PixelStats& pixel_stats) {
+
+        return rasterize_triangle_pixels_with<Variant>(setup, clip_rect, target, triangle_id, pixel_stats, [&](int x, int y) {
+            return shade_pixel<Variant>(setup, texture, x, y);
+        });
+    }
+
+    // Like the reference kernel, but every pixel has SAMPLE_COUNT samples.
+    // Coverage and depth are per sample, while the pixel is shaded once and
+    // its color stored in every sample that passed. Pixels whose centers are
+    // outside the triangle are shaded from attributes extrapolated out to
+    // their centers, like most GPUs do. The color comes from shade(x, y).
+    template<typename Variant, int SAMPLE_COUNT, typename PixelShader>
+    static bool rasterize_triangle_samples_with(const TriangleSetup& setup,
+                                                const PixelRect& clip_rect,
+                                                const RenderTarget& target,
+                                                PixelStats& pixel_stats,
+                                                PixelShader&& shade) {
+
+        static_assert(SAMPLE_COUNT == 2 || SAMPLE_COUNT == 4, "only 2x and 4x multisampling have sample positions");
+        const int (*sample_positions)[2] = SAMPLE_COUNT == 2 ? SAMPLE_POSITIONS_2X : SAMPLE_POSITIONS_4X;
+
+        // The edge steps are whole multiples of the subpixel grid, so the
+        // edge functions can be moved to the samples exactly.
+        Sint64 sample_edge_offsets[3][SAMPLE_COUNT];
+        float sample_offsets_x[SAMPLE_COUNT];
+        float sample_offsets_y[SAMPLE_COUNT];
+        for (int s = 0; s < SAMPLE_COUNT; s++) {
+            for (int i = 0; i < 3; i++) {
+                const EdgeFunction& edge = setup.edges[i];
+                sample_edge_offsets[i][s] = (edge.step_x * sample_positions[s][0] + edge.step_y * sample_positions[s][1]) / SAMPLE_POSITION_STEPS;
+            }
+
+            sample_offsets_x[s] = static_cast<float>(sample_positions[s][0]) / SAMPLE_POSITION_STEPS;
+            sample_offsets_y[s] = static_cast<float>(sample_positions[s][1]) / SAMPLE_POSITION_STEPS;
+        }
+
+        return rasterize_depth_blocks<Variant, SAMPLE_COUNT>(setup, clip_rect, target, pixel_stats, [&](const PixelRect& block_rect) {
+            bool has_shaded = false;
+
+            Sint64 row_w0 = edge_value_at(setup.edges[0], setup, block_rect.min_x, block_rect.min_y);
+            Sint64 row_w1 = edge_value_at(setup.edges[1], setup, block_rect.min_x, block_rect.min_y);
+            Sint64 row_w2 = edge_value_at(setup.edges[2], setup, block_rect.min_x, block_rect.min_y);
+
+            for (int y = block_rect.min_y; y <= block_rect.max_y; y++) {
+                Sint64 w0 = row_w0;
+                Sint64 w1 = row_w1;
+                Sint64 w2 = row_w2;
+
+                row_w0 += setup.edges[0].step_y;
+                row_w1 += setup.edges[1].step_y;
+                row_w2 += setup.edges[2].step_y;
+
+                for (int x = block_rect.min_x; x <= block_rect.max_x; x++) {
+                    int coverage_mask = 0;
+                    for (int s = 0; s < SAMPLE_COUNT; s++) {
+                        bool is_covered = ((w0 + sample_edge_offsets[0][s]) | (w1 + sample_edge_offsets[1][s]) | (w2 + sample_edge_offsets[2][s])) >= 0;
+                        coverage_mask |= is_covered << s;
+                    }
+
+                    w0 += setup.edges[0].step_x;
+                    w1 += setup.edges[1].step_x;
+                    w2 += setup.edges[2].step_x;
+
+                    if (coverage_mask == 0) {
+                        continue;
+                    }
+
+                    pixel_stats.covered_pixels++;
+
+                    float offset_x = static_cast<float>(x - setup.min_x);
+                    float offset_y = static_cast<float>(y - setup.min_y);
+                    int pixel_index = y * target.width + x;
+                    typedef typename Variant::Depth::Value DepthValue;
+                    DepthValue* sample_depths = static_cast<DepthValue*>(target.depth_buffer) + pixel_index * SAMPLE_COUNT;
+
+                    int passed_mask = 0;
+                    for (int s = 0; s < SAMPLE_COUNT; s++) {
+                        if ((coverage_mask & (1 << s)) == 0) {
+                            continue;
+                        }
+
+                        DepthValue depth = Variant::Depth::to_stored(evaluate_plane(setup.depth, offset_x + sample_offsets_x[s], offset_y + sample_offsets_y[s]));
+                        if (Variant::IS_DEPTH_TESTED && depth > sample_depths[s]) {
+                            continue;
+                        }
+
+                        if (Variant::IS_DEPTH_WRITTEN) {
+                            sample_depths[s] = depth;
+                        }
+
+                        passed_mask |= 1 << s;
+                    }
+
+                    if (passed_mask == 0) {
+                        pixel_stats.depth_rejected_pixels++;
+                        continue;
+                    }
+
+                    if constexpr (Variant::SHADING == Shading::OVERDRAW) {
+                        target.shade_counts[pixel_index]++;
+                    } else {
+                        Uint32 color = shade(x, y);
+
+                        Uint32* sample_colors = target.sample_colors + pixel_index * SAMPLE_COUNT;
+                        for (int s = 0; s < SAMPLE_COUNT; s++) {
+                            if ((passed_mask & (1 << s)) != 0) {
+                                sample_colors[s] = color;
+                            }
+                        }
+                    }
+
+                    pixel_stats.shaded_pixels++;
+                    has_shaded = true;
+                }
+            }
+
+            return has_shaded;
+        });
+    }
+
+    template<typename Variant, int SAMPLE_COUNT>
+    static bool rasterize_triangle_samples(const TriangleSetup& setup,
+                                           const PixelRect& clip_rect,
+                                           const RenderTarget& target,
+                                           const texture::Texture* texture,
+                                           Uint32,
+                                           PixelStats& pixel_stats) {
+
+        return rasterize_triangle_samples_with<Variant, SAMPLE_COUNT>(setup, clip_rect, target, pixel_stats, [&](int x, int y) {
+            return shade_pixel<Variant>(setup, texture, x, y);
+        });
+    }
+
+    // Finds the pixels of row y from min_x to max_x that the triangle
+    // covers, which are always a single run, straight from the edge
+    // functions. Returns false if there are none.
+    static inline bool find_covered_span(const TriangleSetup& setup, int y, int min_x, int max_x, int& span_min_x, int& span_max_x) {
+        Sint64 first_x = min_x;
+        Sint64 last_x = max_x;
+        for (int i = 0; i < 3; i++) {
+            const EdgeFunction& edge = setup.edges[i];
+            Sint64 value = edge_value_at(edge, setup, min_x, y);
+            if (edge.step_x > 0) {
+                if (value < 0) {
+                    first_x = std::max(first_x, min_x + (-value + edge.step_x - 1) / edge.step_x);
+                }
+            } else if (value < 0) {
+                return false;
+            } else if (edge.step_x < 0) {
+                last_x = std::min(last_x, min_x + value / -edge.step_x);
+            }
+        }
+
+        if (first_x > last_x) {
+            return false;
+        }
+
+        span_min_x = static_cast<int>(first_x);
+        span_max_x = static_cast<int>(last_x);
+        return true;
+    }
+
+    // The perspective-correct vertex color or texture coordinate at a
+    // pixel, whichever the variant shades with, with a single division.
+    // They are kept as plain floats, which the compiler keeps in registers
+    // much more readily than glm vectors.
+    template<typename Variant>
+    struct SpanAttributes {
+        static constexpr int COUNT = Variant::SHADING == Shading::VERTEX_COLOR ? 3 : 2;
+
+        float values[COUNT];
+    };
+
+    template<typename Variant>
+    static inline SpanAttributes<Variant> perspective_attributes_at(const TriangleSetup& setup, float offset_x, float offset_y) {
+        float z = 1.0f / evaluate_plane(setup.inverse_z, offset_x, offset_y);
+
+        SpanAttributes<Variant> attributes;
+        for (int i = 0; i < SpanAttributes<Variant>::COUNT; i++) {
+            const AttributePlane& plane = Variant::SHADING == Shading::VERTEX_COLOR ? setup.color_over_z[i] : setup.tex_coord_over_z[i];
+            attributes.values[i] = evaluate_plane(plane, offset_x, offset_y) * z;
+        }
+
+        return attributes;
+    }
+
+    // Depth tests, shades and writes a pixel of a subspan, with the
+    // attributes interpolated linearly from the subspan's left end, and
+    // returns false if it failed the depth test. The lane kernels do the
+    // same math in the same order for whole spans of pixels at once.
+    template<typename Variant>
+    static inline bool shade_subspan_pixel(const TriangleSetup& setup,
+                                           const RenderTarget& target,
+                                           const texture::Texture* texture,
+                                           const SpanAttributes<Variant>& left,
+                                           const SpanAttributes<Variant>& step,
+                                           int left_x,
+                                           int x,
+                                           int y,
+                                           float lod) {
+
+        typedef typename Variant::Depth::Value DepthValue;
+
+        DepthValue* depth_buffer = static_cast<DepthValue*>(target.depth_buffer);
+        int buffer_index = y * target.width + x;
+
+        DepthValue depth = Variant::Depth::to_stored(evaluate_plane(setup.depth, static_cast<float>(x - setup.min_x), static_cast<float>(y - setup.min_y)));
+        if (Variant::IS_DEPTH_TESTED && depth > depth_buffer[buffer_index]) {
+            return false;
+        }
+
+        if (Variant::IS_DEPTH_WRITTEN) {
+            depth_buffer[buffer_index] = depth;
+        }
+
+        float step_count = static_cast<float>(x - left_x);
+        if constexpr (Variant::SHADING == Shading::VERTEX_COLOR) {
+            Uint32 r = static_cast<Uint32>(std::clamp(left.values[0] + step.values[0] * step_count, 0.0f, 1.0f) * 255);
+            Uint32 g = static_cast<Uint32>(std::clamp(left.values[1] + step.values[1] * step_count, 0.0f, 1.0f) * 255);
+            Uint32 b = static_cast<Uint32>(std::clamp(left.values[2] + step.values[2] * step_count, 0.0f, 1.0f) * 255);
+
+            target.color_buffer[buffer_index] = (r << 24) | (g << 16) | (b << 8) | 0xFF;
+        } else {
+            glm::vec2 tex_coord = glm::vec2(left.values[0] + step.values[0] * step_count,
+                                            left.values[1] + step.values[1] * step_count);
+
+            target.color_buffer[buffer_index] = pack_color(texture->sample<Variant::FILTER, Variant::WRAP>(tex_coord, lod));
+        }
+
+        return true;
+    }
+
+    // Shared by the subdivided kernels of every kernel type. It walks each
+    // row's covered span directly instead of testing every pixel of every
+    // depth block against the edges, and only divides by the interpolated
+    // 1/z at the ends of each subspan. Subspans end on multiples of
+    // SPAN_LENGTH on screen, so every kernel type splits a row the same way
+    // and the lane kernels' spans never straddle two subspans.
+    // draw_subspan(y, left_x, last_x, left, step) draws the pixels from
+    // left_x to last_x, with the exact attributes at left_x and how much
+    // they change per pixel, and returns true if it shaded any of them.
+    template<typename Variant, int SPAN_LENGTH, typename SubspanRasterizer>
+    static inline bool rasterize_subdivided_spans(const TriangleSetup& setup,
+                                                  const PixelRect& clip_rect,
+                                                  const RenderTarget& target,
+                                                  SubspanRasterizer draw_subspan) {
+
+        static_assert(Variant::SHADING == Shading::VERTEX_COLOR || Variant::SHADING == Shading::TEXTURE,
+                      "only forward shading interpolates attributes");
+
+        PixelRect rect;
+        if (!clip_to_triangle(setup, clip_rect, rect)) {
+            return false;
+        }
+
+        bool has_shaded = false;
+        for (int y = rect.min_y; y <= rect.max_y; y++) {
+            int span_min_x, span_max_x;
+            if (!find_covered_span(setup, y, rect.min_x, rect.max_x, span_min_x, span_max_x)) {
+                continue;
+            }
+
+            float offset_y = static_cast<float>(y - setup.min_y);
+
+            int left_x = span_min_x;
+            SpanAttributes<Variant> left = perspective_attributes_at<Variant>(setup, static_cast<float>(left_x - setup.min_x), offset_y);
+            while (left_x <= span_max_x) {
+                // The last subspan ends on the last pixel of the span, and
+                // every other one on the first pixel of the next subspan.
+                int next_left_x = (left_x / SPAN_LENGTH + 1) * SPAN_LENGTH;
+                int right_x = std::min(next_left_x, span_max_x);
+                int last_x = std::min(next_left_x - 1, span_max_x);
+
+                SpanAttributes<Variant> right = left;
+                if (right_x > left_x) {
+                    right = perspective_attributes_at<Variant>(setup, static_cast<float>(right_x - setup.min_x), offset_y);
+                }
+
+                float step_scale = right_x > left_x ? 1.0f / (right_x - left_x) : 0.0f;
+                SpanAttributes<Variant> step;
+                for (int i = 0; i < SpanAttributes<Variant>::COUNT; i++) {
+                    step.values[i] = (right.values[i] - left.values[i]) * step_scale;
+                }
+
+                has_shaded |= draw_subspan(y, left_x, last_x, left, step);
+
+                left_x = last_x + 1;
+                left = right;
+            }
+        }
+
+        if (!Variant::IS_DEPTH_WRITTEN || !has_shaded) {
+            return false;
+        }
+
+        // The depth blocks are only brought up to date once the whole
+        // triangle is drawn. Until then they are farther than they should
+        // be, which only ever rejects less.
+        for (int block_y = rect.min_y / DEPTH_BLOCK_SIZE; block_y <= rect.max_y / DEPTH_BLOCK_SIZE; block_y++) {
+            for (int block_x = rect.min_x / DEPTH_BLOCK_SIZE; block_x <= rect.max_x / DEPTH_BLOCK_SIZE; block_x++) {
+                int origin_x = block_x * DEPTH_BLOCK_SIZE;
+                int origin_y = block_y * DEPTH_BLOCK_SIZE;
+                if (may_cover_block(setup, origin_x, origin_y, 0)) {
+                    target.block_max_depth[block_y * target.block_columns + block_x] = max_depth_in_block<Variant::DEPTH_FORMAT>(target, origin_x, origin_y);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // The scalar kernel for large triangles. The attributes in between the
+    // ends of a subspan are interpolated linearly, so they are off by at
+    // most about SPAN_LENGTH^2 / 8 times their second derivative along the
+    // row, which is tiny unless the triangle is steeply inclined and close
+    // to the camera. Coverage, depth and mipmap levels of detail are exactly
+    // the same as in the reference kernel. Only forward shading is
+    // supported, since overdraw and visibility kernels have no attributes to
+    // interpolate.
+    template<typename Variant, int SPAN_LENGTH>
+    static bool rasterize_triangle_subdivided_spans(const TriangleSetup& setup,
+                                                    const PixelRect& clip_rect,
+                                                    const RenderTarget& target,
+                                                    const texture::Texture* texture,
+                                                    Uint32,
+                                                    PixelStats& pixel_stats) {
+
+        auto draw_subspan = [&](int y, int left_x, int last_x, const SpanAttributes<Variant>& left, const SpanAttributes<Variant>& step) {
+            const float* block_max_depth_row = target.block_max_depth + (y / DEPTH_BLOCK_SIZE) * target.block_columns;
+
+            bool has_shaded = false;
+            int lod_quad_x = -1;
+            float lod = 0.0f;
+
+            for (int x = left_x; x <= last_x; x++) {
+                if (Variant::IS_DEPTH_TESTED && setup.min_depth > block_max_depth_row[x / DEPTH_BLOCK_SIZE]) {
+                    continue;
+                }
+
+                pixel_stats.visited_pixels++;
+                pixel_stats.covered_pixels++;
+
+                if (Variant::USES_MIPMAPS && lod_quad_x != x / 2) {
+                    lod_quad_x = x / 2;
+                    lod = texture_lod_at_quad(setup, texture, x, y);
+                }
+
+                if (!shade_subspan_pixel<Variant>(setup, target, texture, left, step, left_x, x, y, lod)) {
+                    pixel_stats.depth_rejected_pixels++;
+                    continue;
+                }
+
+                pixel_stats.shaded_pixels++;
+                has_shaded = true;
+            }
+
+            return has_shaded;
+        };
+
+        return rasterize_subdivided_spans<Variant, SPAN_LENGTH>(setup, clip_rect, target, draw_subspan);
+    }
+
+    // Every kernel type has a Kernel<Variant> class template whose static
+    // run() is the kernel for that variant, and so do the resolve shaders.
+    // These pick the one that matches the render state, which instantiates
+    // all of them.
+    template<typename Function, template<typename> class Kernel, Shading SHADING, texture::TextureFilter FILTER, texture::TextureWrap WRAP, DepthFormat DEPTH_FORMAT>
+    static Function select_depth_test_variant(const RenderState& render_state) {
+        if (render_state.is_depth_tested && render_state.is_depth_written) {
+            return Kernel<KernelVariant<SHADING, FILTER, WRAP, true, true, DEPTH_FORMAT>>::run;
+        } else if (render_state.is_depth_tested) {
+            return Kernel<KernelVariant<SHADING, FILTER, WRAP, true, false, DEPTH_FORMAT>>::run;
+        }
+
+        return Kernel<KernelVariant<SHADING, FILTER, WRAP, false, true, DEPTH_FORMAT>>::run;
+    }
+
+    template<typename Function, template<typename> class Kernel, Shading SHADING, texture::TextureFilter FILTER, texture::TextureWrap WRAP>
+    static Function select_depth_variant(const RenderState& render_state) {
+        if (!render_state.is_depth_tested && !render_state.is_depth_written) {
+            return Kernel<KernelVariant<SHADING, FILTER, WRAP, false, false, DepthFormat::FLOAT>>::run;
+        }
+
+        switch (render_state.depth_format) {
+            case DepthFormat::UNORM16:
+                return select_depth_test_variant<Function, Kernel, SHADING, FILTER, WRAP, DepthFormat::UNORM16>(render_state);
+
+            case DepthFormat::UNORM24:
+                return select_depth_test_variant<Function, Kernel, SHADING, FILTER, WRAP, DepthFormat::UNORM24>(render_state);
+
+            default:
+                return select_depth_test_variant<Function, Kernel, SHADING, FILTER, WRAP, DepthFormat::FLOAT>(render_state);
+        }
+    }
+
+    template<typename Function, template<typename> class Kernel, texture::TextureFilter FILTER>
+    static Function select_wrap_variant(const RenderState& render_state) {
+        if (render_state.texture_wrap == texture::TextureWrap::REPEAT) {
+            return select_depth_variant<Function, Kernel, Shading::TEXTURE, FILTER, texture::TextureWrap::REPEAT>(render_state);
+        }
+
+        return select_depth_variant<Function, Kernel, Shading::TEXTURE, FILTER, texture::TextureWrap::CLAMP>(render_state);
+    }
+
+    template<typename Function, template<typename> class Kernel>
+    static Function select_shading_variant(const RenderState& render_state) {
+        const texture::TextureFilter UNUSED_FILTER = texture::TextureFilter::NEAREST;
+        const texture::TextureWrap UNUSED_WRAP = texture::TextureWrap::CLAMP;
+
+        if (!render_state.is_textured) {
+            return select_depth_variant<Function, Kernel, Shading::VERTEX_COLOR, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+        }
+
+        switch (render_state.texture_filter) {
+            case texture::TextureFilter::BILINEAR:
+                return select_wrap_variant<Function, Kernel, texture::TextureFilter::BILINEAR>(render_state);
+
+            case texture::TextureFilter::NEAREST_MIPMAP:
+                return select_wrap_variant<Function, Kernel, texture::TextureFilter::NEAREST_MIPMAP>(render_state);
+
+            case texture::TextureFilter::TRILINEAR:
+                return select_wrap_variant<Function, Kernel, texture::TextureFilter::TRILINEAR>(render_state);
+
+            default:
+                return select_wrap_variant<Function, Kernel, texture::TextureFilter::NEAREST>(render_state);
+        }
+    }
+
+    template<template<typename> class Kernel>
+    static TriangleKernel select_kernel_variant(const RenderState& render_state) {
+        const texture::TextureFilter UNUSED_FILTER = texture::TextureFilter::NEAREST;
+        const texture::TextureWrap UNUSED_WRAP = texture::TextureWrap::CLAMP;
+
+        if (render_state.is_counting_overdraw) {
+            return select_depth_variant<TriangleKernel, Kernel, Shading::OVERDRAW, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+        } else if (render_state.is_shading_deferred) {
+            return select_depth_variant<TriangleKernel, Kernel, Shading::VISIBILITY, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+        }
+
+        return select_shading_variant<TriangleKernel, Kernel>(render_state);
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "raster_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+// Everything defined below this point is compiled for AVX2, which is why it
+// is kept in its own file and only ever called after checking for AVX2
+// support at runtime. Headers shared with other files must be included above
+// it, so that their inline functions are never compiled with AVX2.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "raster_kernels_simd.h"
+
+namespace {
+    struct Avx2Lanes {
+        static const int COUNT = 8;
+
+        typedef __m256 Float;
+        typedef __m256i Int;
+
+        static Float splat(float value) { return _mm256_set1_ps(value); }
+        static Int splat(Sint32 value) { return _mm256_set1_epi32(value); }
+        static Float lane_offsets() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+        static Int lane_indices() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+        static Int lane_multiples(Sint32 step) { return _mm256_mullo_epi32(_mm256_set1_epi32(step), lane_indices()); }
+
+        static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static Int add_int(Int a, Int b) { return _mm256_add_epi32(a, b); }
+
+        static Int and_mask(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static Int and_not_mask(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+        static Int greater_than(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+        static Int greater_than(Int a, Int b) { return _mm256_cmpgt_epi32(a, b); }
+        static Int non_negative(Int a) { return _mm256_cmpgt_epi32(a, _mm256_set1_epi32(-1)); }
+
+        static Float select(Int mask, Float a, Float b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+        static Int select(Int mask, Int a, Int b) { return _mm256_blendv_epi8(b, a, mask); }
+
+        static int mask_bits(Int mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)); }
+        static Int round_to_int(Float a) { return _mm256_cvtps_epi32(a); }
+
+        static Float load(const float* values) { return _mm256_loadu_ps(values); }
+        static Int load(const Uint32* values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)); }
+        static void store(float* values, Float lanes) { _mm256_storeu_ps(values, lanes); }
+        static void store(Uint32* values, Int lanes) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), lanes); }
+
+        static Int load(const Uint16* values) {
+            return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+        }
+
+        // Packing works within each 128-bit half, so the halves are put back
+        // together afterwards.
+        static void store(Uint16* values, Int lanes) {
+            Int packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lanes, lanes), 0b1000);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm256_castsi256_si128(packed));
+        }
+
+        static Int pack_color(Float r, Float g, Float b) {
+            Float max_channel_value = _mm256_set1_ps(255.0f);
+            Int r_bits = _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(r, max_channel_value)), 24);
+            Int g_bits = _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(g, max_channel_value)), 16);
+            Int b_bits = _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(b, max_channel_value)), 8);
+
+            return _mm256_or_si256(_mm256_or_si256(r_bits, g_bits), _mm256_or_si256(b_bits, _mm256_set1_epi32(0xFF)));
+        }
+    };
+};
+
+// --------------------------------------------------------------------------
+
+namespace {
+    template<typename Variant>
+    struct Avx2Kernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_spans<Avx2Lanes, Variant>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant, int SPAN_LENGTH>
+    struct Avx2SubdividedKernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_subdivided_lane_spans<Avx2Lanes, Variant, SPAN_LENGTH>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant>
+    using Avx2Subdivided8Kernel = Avx2SubdividedKernel<Variant, 8>;
+
+    template<typename Variant>
+    using Avx2Subdivided16Kernel = Avx2SubdividedKernel<Variant, 16>;
+};
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_avx2_kernel(const RenderState& render_state) {
+    return select_kernel_variant<Avx2Kernel>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_avx2_subdivided_kernel(int span_length, const RenderState& render_state) {
+    if (span_length == 8) {
+        return select_shading_variant<TriangleKernel, Avx2Subdivided8Kernel>(render_state);
+    }
+
+    return select_shading_variant<TriangleKernel, Avx2Subdivided16Kernel>(render_state);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#else
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_avx2_kernel(const RenderState& render_state) {
+    return get_scalar_kernel(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_avx2_subdivided_kernel(int span_length, const RenderState& render_state) {
+    return get_scalar_subdivided_kernel(span_length, render_state);
+}
+
+#endif
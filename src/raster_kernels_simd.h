@@ -0,0 +1,410 @@
+#ifndef RASTER_KERNELS_SIMD_H
+#define RASTER_KERNELS_SIMD_H
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "raster_kernels.h"
+
+// This is the kernel shared by every SIMD instruction set. It walks each row
+// of every depth block the triangle might show up in, in spans of Lanes::COUNT
+// pixels, and does the coverage test, depth test, depth write and
+// perspective-correct attribute interpolation for a whole span at once, using
+// lane masks instead of branches. Like the scalar kernel, it is instantiated
+// once for every KernelVariant. The subdivided kernel for large triangles
+// below shares its lanes.
+//
+// The Lanes type wraps one instruction set's registers and intrinsics, and it
+// must provide these static members:
+//
+//   COUNT                        number of pixels processed at once
+//   Float, Int                   float and 32-bit integer registers
+//   splat(float), splat(Sint32)  broadcast to every lane
+//   lane_offsets()               the floats 0, 1, 2, ...
+//   lane_indices()               the integers 0, 1, 2, ...
+//   lane_multiples(step)         the integers 0, step, 2 * step, ...
+//   add, mul, div, min, max      lane-wise float arithmetic
+//   add_int                      lane-wise integer addition
+//   and_mask, and_not_mask       a & b and ~a & b for masks
+//   greater_than(a, b)           mask of a > b, for floats or integers
+//   non_negative(a)              mask of a >= 0 for integers
+//   select(mask, a, b)           a where the mask is set, b elsewhere
+//   mask_bits(mask)              one bit per lane, lane 0 in bit 0
+//   round_to_int(a)              floats to integers, rounding ties to even
+//   load, store                  unaligned memory access to floats, Uint32s,
+//                                or Uint16s that are widened to integer lanes
+//   pack_color(r, g, b)          truncates [0, 1] floats to RGBA8888 pixels
+//
+// The SIMD kernels are compiled for instruction sets the CPU might not have,
+// so everything in here must have internal linkage.
+
+namespace raster_kernels {
+
+    // Edge values are narrowed to 32-bit lanes at the start of each span.
+    // Clamping them to this magnitude can't change the sign of any lane as
+    // long as the per-lane steps within a span stay below it as well.
+    static const Sint64 MAX_SPAN_EDGE_VALUE = static_cast<Sint64>(1) << 30;
+
+    // ----------------------------------------------------------------------
+
+    static inline Sint32 narrow_edge_value(Sint64 edge_value) {
+        return static_cast<Sint32>(std::clamp(edge_value, -MAX_SPAN_EDGE_VALUE, MAX_SPAN_EDGE_VALUE));
+    }
+
+    // ----------------------------------------------------------------------
+
+    template<typename Lanes>
+    static inline typename Lanes::Float evaluate_plane_lanes(const AttributePlane& plane,
+                                                             typename Lanes::Float offset_x,
+                                                             typename Lanes::Float offset_y) {
+
+        // This is the same order of operations as evaluate_plane(), which is
+        // what keeps the SIMD kernels bit-identical to the scalar one.
+        return Lanes::add(Lanes::add(Lanes::splat(plane.value), Lanes::mul(Lanes::splat(plane.step_x), offset_x)),
+                          Lanes::mul(Lanes::splat(plane.step_y), offset_y));
+    }
+
+    // ----------------------------------------------------------------------
+
+    template<typename Lanes>
+    static inline typename Lanes::Float clamp_to_unit_lanes(typename Lanes::Float value) {
+        return Lanes::min(Lanes::max(value, Lanes::splat(0.0f)), Lanes::splat(1.0f));
+    }
+
+    // ----------------------------------------------------------------------
+
+    // Depths the way the variant's format stores them, which is either Float
+    // or Int lanes. Converts the same way as DepthTraits::to_stored(), down
+    // to a NaN ending up as the nearest integer depth.
+    template<typename Lanes, DepthFormat DEPTH_FORMAT>
+    static inline auto to_stored_depth_lanes(typename Lanes::Float depth) {
+        if constexpr (DEPTH_FORMAT == DepthFormat::FLOAT) {
+            return depth;
+        } else {
+            typename Lanes::Float max_depth = Lanes::splat(static_cast<float>(DepthTraits<DEPTH_FORMAT>::MAX_VALUE));
+            return Lanes::round_to_int(Lanes::min(Lanes::max(depth, Lanes::splat(0.0f)), max_depth));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+
+    template<typename Lanes, typename Variant>
+    static bool rasterize_triangle_spans(const TriangleSetup& setup, const PixelRect& clip_rect, const RenderTarget& target, const texture::Texture* texture, Uint32 triangle_id, PixelStats& pixel_stats) {
+        typedef typename Lanes::Float Float;
+        typedef typename Lanes::Int Int;
+
+        const int LANE_COUNT = Lanes::COUNT;
+
+        // Huge triangles would overflow the 32-bit lanes, but they are rare
+        // enough that the reference kernel can take care of them.
+        for (int i = 0; i < 3; i++) {
+            if (std::abs(setup.edges[i].step_x) * LANE_COUNT >= MAX_SPAN_EDGE_VALUE) {
+                return rasterize_triangle_pixels<Variant>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+            }
+        }
+
+        Sint64 span_step_w[3];
+        Int lane_step_w[3];
+        for (int i = 0; i < 3; i++) {
+            span_step_w[i] = setup.edges[i].step_x * LANE_COUNT;
+            lane_step_w[i] = Lanes::lane_multiples(static_cast<Sint32>(setup.edges[i].step_x));
+        }
+
+        const Int lane_indices = Lanes::lane_indices();
+        const Float lane_offsets = Lanes::lane_offsets();
+
+        return rasterize_depth_blocks<Variant>(setup, clip_rect, target, pixel_stats, [&](const PixelRect& block_rect) {
+            bool has_shaded = false;
+
+            // Spans are aligned to multiples of the lane count on screen, so
+            // the same pixels always end up in the same lanes. Depth blocks are
+            // a multiple of the lane count wide, so spans never leave a block.
+            int first_span_x = block_rect.min_x - block_rect.min_x % LANE_COUNT;
+
+            Sint64 row_w[3];
+            for (int i = 0; i < 3; i++) {
+                row_w[i] = edge_value_at(setup.edges[i], setup, first_span_x, block_rect.min_y);
+            }
+
+            const Int before_min_x = Lanes::splat(static_cast<Sint32>(block_rect.min_x - 1));
+            const Int after_max_x = Lanes::splat(static_cast<Sint32>(block_rect.max_x + 1));
+
+            for (int y = block_rect.min_y; y <= block_rect.max_y; y++) {
+                Sint64 w[3] = { row_w[0], row_w[1], row_w[2] };
+                for (int i = 0; i < 3; i++) {
+                    row_w[i] += setup.edges[i].step_y;
+                }
+
+                int row_index = y * target.width;
+                Float offset_y = Lanes::splat(static_cast<float>(y - setup.min_y));
+
+                for (int span_x = first_span_x; span_x <= block_rect.max_x; span_x += LANE_COUNT) {
+                    Sint64 span_w[3] = { w[0], w[1], w[2] };
+                    for (int i = 0; i < 3; i++) {
+                        w[i] += span_step_w[i];
+                    }
+
+                    // A span hanging off the right side of the buffer would
+                    // touch the next row, so its pixels are handled one at a time.
+                    if (span_x + LANE_COUNT > target.width) {
+                        for (int lane = 0; lane < LANE_COUNT; lane++) {
+                            int x = span_x + lane;
+                            Sint64 w0 = span_w[0] + setup.edges[0].step_x * lane;
+                            Sint64 w1 = span_w[1] + setup.edges[1].step_x * lane;
+                            Sint64 w2 = span_w[2] + setup.edges[2].step_x * lane;
+                            if (x < block_rect.min_x || x > block_rect.max_x || (w0 | w1 | w2) < 0) {
+                                continue;
+                            }
+
+                            pixel_stats.covered_pixels++;
+                            if (shade_covered_pixel<Variant>(setup, target, texture, triangle_id, x, y)) {
+                                pixel_stats.shaded_pixels++;
+                                has_shaded = true;
+                            } else {
+                                pixel_stats.depth_rejected_pixels++;
+                            }
+                        }
+
+                        continue;
+                    }
+
+                    Int x_lanes = Lanes::add_int(Lanes::splat(static_cast<Sint32>(span_x)), lane_indices);
+                    Int in_rect = Lanes::and_mask(Lanes::greater_than(x_lanes, before_min_x),
+                                                  Lanes::greater_than(after_max_x, x_lanes));
+
+                    Int w0 = Lanes::add_int(Lanes::splat(narrow_edge_value(span_w[0])), lane_step_w[0]);
+                    Int w1 = Lanes::add_int(Lanes::splat(narrow_edge_value(span_w[1])), lane_step_w[1]);
+                    Int w2 = Lanes::add_int(Lanes::splat(narrow_edge_value(span_w[2])), lane_step_w[2]);
+                    Int is_inside = Lanes::and_mask(Lanes::and_mask(Lanes::non_negative(w0), Lanes::non_negative(w1)),
+                                                    Lanes::non_negative(w2));
+
+                    Int is_covered = Lanes::and_mask(is_inside, in_rect);
+                    int covered_bits = Lanes::mask_bits(is_covered);
+                    if (covered_bits == 0) {
+                        continue;
+                    }
+
+                    Float offset_x = Lanes::add(Lanes::splat(static_cast<float>(span_x - setup.min_x)), lane_offsets);
+
+                    typedef typename Variant::Depth::Value DepthValue;
+                    DepthValue* depth_span = static_cast<DepthValue*>(target.depth_buffer) + row_index + span_x;
+                    auto depth = to_stored_depth_lanes<Lanes, Variant::DEPTH_FORMAT>(evaluate_plane_lanes<Lanes>(setup.depth, offset_x, offset_y));
+                    auto stored_depth = depth;
+                    Int is_visible = is_covered;
+                    if (Variant::IS_DEPTH_TESTED || Variant::IS_DEPTH_WRITTEN) {
+                        stored_depth = Lanes::load(depth_span);
+                    }
+                    if (Variant::IS_DEPTH_TESTED) {
+                        is_visible = Lanes::and_not_mask(Lanes::greater_than(depth, stored_depth), is_covered);
+                    }
+
+                    int visible_bits = Lanes::mask_bits(is_visible);
+                    int covered_count = count_set_bits(covered_bits);
+                    int visible_count = count_set_bits(visible_bits);
+                    pixel_stats.covered_pixels += covered_count;
+                    pixel_stats.depth_rejected_pixels += covered_count - visible_count;
+                    pixel_stats.shaded_pixels += visible_count;
+
+                    if (visible_bits == 0) {
+                        continue;
+                    }
+
+                    has_shaded = true;
+                    if (Variant::IS_DEPTH_WRITTEN) {
+                        Lanes::store(depth_span, Lanes::select(is_visible, depth, stored_depth));
+                    }
+
+                    if constexpr (Variant::SHADING == Shading::OVERDRAW) {
+                        for (int lane = 0; lane < LANE_COUNT; lane++) {
+                            target.shade_counts[row_index + span_x + lane] += (visible_bits >> lane) & 1;
+                        }
+
+                        continue;
+                    } else if constexpr (Variant::SHADING == Shading::VISIBILITY) {
+                        Uint32* visibility_span = target.visibility_buffer + row_index + span_x;
+                        Int visible_id = Lanes::splat(static_cast<Sint32>(triangle_id + 1));
+                        Lanes::store(visibility_span, Lanes::select(is_visible, visible_id, Lanes::load(visibility_span)));
+
+                        continue;
+                    }
+
+                    Uint32* color_span = target.color_buffer + row_index + span_x;
+                    Float interpolated_inverse_z = evaluate_plane_lanes<Lanes>(setup.inverse_z, offset_x, offset_y);
+
+                    if constexpr (Variant::SHADING == Shading::VERTEX_COLOR) {
+                        Float r = Lanes::div(evaluate_plane_lanes<Lanes>(setup.color_over_z[0], offset_x, offset_y), interpolated_inverse_z);
+                        Float g = Lanes::div(evaluate_plane_lanes<Lanes>(setup.color_over_z[1], offset_x, offset_y), interpolated_inverse_z);
+                        Float b = Lanes::div(evaluate_plane_lanes<Lanes>(setup.color_over_z[2], offset_x, offset_y), interpolated_inverse_z);
+
+                        Int packed_colors = Lanes::pack_color(clamp_to_unit_lanes<Lanes>(r),
+                                                              clamp_to_unit_lanes<Lanes>(g),
+                                                              clamp_to_unit_lanes<Lanes>(b));
+
+                        Lanes::store(color_span, Lanes::select(is_visible, packed_colors, Lanes::load(color_span)));
+                    } else {
+                        // Texture fetches are scattered all over the texture, so
+                        // they are gathered one visible lane at a time.
+                        float u[LANE_COUNT];
+                        float v[LANE_COUNT];
+                        Lanes::store(u, Lanes::div(evaluate_plane_lanes<Lanes>(setup.tex_coord_over_z[0], offset_x, offset_y), interpolated_inverse_z));
+                        Lanes::store(v, Lanes::div(evaluate_plane_lanes<Lanes>(setup.tex_coord_over_z[1], offset_x, offset_y), interpolated_inverse_z));
+
+                        // Spans start on even pixels, so each pair of lanes
+                        // is one row of a quad and shares its level of detail.
+                        int lod_lane_pair = -1;
+                        float lod = 0.0f;
+
+                        for (int lane = 0; lane < LANE_COUNT; lane++) {
+                            if ((visible_bits & (1 << lane)) == 0) {
+                                continue;
+                            }
+
+                            if (Variant::USES_MIPMAPS && lod_lane_pair != lane / 2) {
+                                lod_lane_pair = lane / 2;
+                                lod = texture_lod_at_quad(setup, texture, span_x + lane, y);
+                            }
+
+                            glm::vec3 color = texture->sample<Variant::FILTER, Variant::WRAP>(glm::vec2(u[lane], v[lane]), lod);
+
+                            color_span[lane] = pack_color(color);
+                        }
+                    }
+                }
+            }
+
+            return has_shaded;
+        });
+    }
+
+    // ----------------------------------------------------------------------
+
+    // The subdivided kernel for large triangles, which draws each subspan in
+    // spans of Lanes::COUNT pixels that are aligned to multiples of the lane
+    // count on screen, like the kernel above. Subspans start on multiples of
+    // SPAN_LENGTH, so no span ever straddles two of them. It interpolates
+    // the attributes the same way as the scalar subdivided kernel does, and
+    // draws exactly the same pixels.
+    template<typename Lanes, typename Variant, int SPAN_LENGTH>
+    static bool rasterize_triangle_subdivided_lane_spans(const TriangleSetup& setup, const PixelRect& clip_rect, const RenderTarget& target, const texture::Texture* texture, Uint32, PixelStats& pixel_stats) {
+        typedef typename Lanes::Float Float;
+        typedef typename Lanes::Int Int;
+        typedef typename Variant::Depth::Value DepthValue;
+
+        const int LANE_COUNT = Lanes::COUNT;
+        static_assert(SPAN_LENGTH % LANE_COUNT == 0 && DEPTH_BLOCK_SIZE % LANE_COUNT == 0, "spans must not straddle subspans or depth blocks");
+
+        const Int lane_indices = Lanes::lane_indices();
+        const Float lane_offsets = Lanes::lane_offsets();
+
+        auto draw_subspan = [&](int y, int left_x, int last_x, const SpanAttributes<Variant>& left, const SpanAttributes<Variant>& step) {
+            const float* block_max_depth_row = target.block_max_depth + (y / DEPTH_BLOCK_SIZE) * target.block_columns;
+            int row_index = y * target.width;
+            Float offset_y = Lanes::splat(static_cast<float>(y - setup.min_y));
+
+            const Int before_left_x = Lanes::splat(static_cast<Sint32>(left_x - 1));
+            const Int after_last_x = Lanes::splat(static_cast<Sint32>(last_x + 1));
+
+            bool has_shaded = false;
+            for (int span_x = left_x - left_x % LANE_COUNT; span_x <= last_x; span_x += LANE_COUNT) {
+                if (Variant::IS_DEPTH_TESTED && setup.min_depth > block_max_depth_row[span_x / DEPTH_BLOCK_SIZE]) {
+                    continue;
+                }
+
+                // A span hanging off the right side of the buffer would
+                // touch the next row, so its pixels are handled one at a time.
+                if (span_x + LANE_COUNT > target.width) {
+                    for (int x = std::max(span_x, left_x); x <= std::min(span_x + LANE_COUNT - 1, last_x); x++) {
+                        pixel_stats.visited_pixels++;
+                        pixel_stats.covered_pixels++;
+
+                        float lod = Variant::USES_MIPMAPS ? texture_lod_at_quad(setup, texture, x, y) : 0.0f;
+                        if (shade_subspan_pixel<Variant>(setup, target, texture, left, step, left_x, x, y, lod)) {
+                            pixel_stats.shaded_pixels++;
+                            has_shaded = true;
+                        } else {
+                            pixel_stats.depth_rejected_pixels++;
+                        }
+                    }
+
+                    continue;
+                }
+
+                Int x_lanes = Lanes::add_int(Lanes::splat(static_cast<Sint32>(span_x)), lane_indices);
+                Int is_covered = Lanes::and_mask(Lanes::greater_than(x_lanes, before_left_x),
+                                                 Lanes::greater_than(after_last_x, x_lanes));
+
+                Float offset_x = Lanes::add(Lanes::splat(static_cast<float>(span_x - setup.min_x)), lane_offsets);
+
+                DepthValue* depth_span = static_cast<DepthValue*>(target.depth_buffer) + row_index + span_x;
+                auto depth = to_stored_depth_lanes<Lanes, Variant::DEPTH_FORMAT>(evaluate_plane_lanes<Lanes>(setup.depth, offset_x, offset_y));
+                auto stored_depth = depth;
+                Int is_visible = is_covered;
+                if (Variant::IS_DEPTH_TESTED || Variant::IS_DEPTH_WRITTEN) {
+                    stored_depth = Lanes::load(depth_span);
+                }
+                if (Variant::IS_DEPTH_TESTED) {
+                    is_visible = Lanes::and_not_mask(Lanes::greater_than(depth, stored_depth), is_covered);
+                }
+
+                int visible_bits = Lanes::mask_bits(is_visible);
+                int covered_count = count_set_bits(Lanes::mask_bits(is_covered));
+                int visible_count = count_set_bits(visible_bits);
+                pixel_stats.visited_pixels += covered_count;
+                pixel_stats.covered_pixels += covered_count;
+                pixel_stats.depth_rejected_pixels += covered_count - visible_count;
+                pixel_stats.shaded_pixels += visible_count;
+
+                if (visible_bits == 0) {
+                    continue;
+                }
+
+                has_shaded = true;
+                if (Variant::IS_DEPTH_WRITTEN) {
+                    Lanes::store(depth_span, Lanes::select(is_visible, depth, stored_depth));
+                }
+
+                Uint32* color_span = target.color_buffer + row_index + span_x;
+                Float step_counts = Lanes::add(Lanes::splat(static_cast<float>(span_x - left_x)), lane_offsets);
+
+                if constexpr (Variant::SHADING == Shading::VERTEX_COLOR) {
+                    Float r = Lanes::add(Lanes::splat(left.values[0]), Lanes::mul(Lanes::splat(step.values[0]), step_counts));
+                    Float g = Lanes::add(Lanes::splat(left.values[1]), Lanes::mul(Lanes::splat(step.values[1]), step_counts));
+                    Float b = Lanes::add(Lanes::splat(left.values[2]), Lanes::mul(Lanes::splat(step.values[2]), step_counts));
+
+                    Int packed_colors = Lanes::pack_color(clamp_to_unit_lanes<Lanes>(r),
+                                                          clamp_to_unit_lanes<Lanes>(g),
+                                                          clamp_to_unit_lanes<Lanes>(b));
+
+                    Lanes::store(color_span, Lanes::select(is_visible, packed_colors, Lanes::load(color_span)));
+                } else {
+                    float u[LANE_COUNT];
+                    float v[LANE_COUNT];
+                    Lanes::store(u, Lanes::add(Lanes::splat(left.values[0]), Lanes::mul(Lanes::splat(step.values[0]), step_counts)));
+                    Lanes::store(v, Lanes::add(Lanes::splat(left.values[1]), Lanes::mul(Lanes::splat(step.values[1]), step_counts)));
+
+                    int lod_lane_pair = -1;
+                    float lod = 0.0f;
+
+                    for (int lane = 0; lane < LANE_COUNT; lane++) {
+                        if ((visible_bits & (1 << lane)) == 0) {
+                            continue;
+                        }
+
+                        if (Variant::USES_MIPMAPS && lod_lane_pair != lane / 2) {
+                            lod_lane_pair = lane / 2;
+                            lod = texture_lod_at_quad(setup, texture, span_x + lane, y);
+                        }
+
+                        color_span[lane] = pack_color(texture->sample<Variant::FILTER, Variant::WRAP>(glm::vec2(u[lane], v[lane]), lod));
+                    }
+                }
+            }
+
+            return has_shaded;
+        };
+
+        return rasterize_subdivided_spans<Variant, SPAN_LENGTH>(setup, clip_rect, target, draw_subspan);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "raster_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// SSE2 is part of the x86-64 baseline, so unlike AVX2 it needs no special
+// compiler options.
+#include <emmintrin.h>
+
+#include "raster_kernels_simd.h"
+
+namespace {
+    struct Sse2Lanes {
+        static const int COUNT = 4;
+
+        typedef __m128 Float;
+        typedef __m128i Int;
+
+        static Float splat(float value) { return _mm_set1_ps(value); }
+        static Int splat(Sint32 value) { return _mm_set1_epi32(value); }
+        static Float lane_offsets() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+        static Int lane_indices() { return _mm_setr_epi32(0, 1, 2, 3); }
+        static Int lane_multiples(Sint32 step) { return _mm_setr_epi32(0, step, 2 * step, 3 * step); }
+
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Int add_int(Int a, Int b) { return _mm_add_epi32(a, b); }
+
+        static Int and_mask(Int a, Int b) { return _mm_and_si128(a, b); }
+        static Int and_not_mask(Int a, Int b) { return _mm_andnot_si128(a, b); }
+        static Int greater_than(Float a, Float b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+        static Int greater_than(Int a, Int b) { return _mm_cmpgt_epi32(a, b); }
+        static Int non_negative(Int a) { return _mm_cmpgt_epi32(a, _mm_set1_epi32(-1)); }
+
+        // SSE2 has no blend instruction, so the selects are done with masks.
+        static Float select(Int mask, Float a, Float b) {
+            Float float_mask = _mm_castsi128_ps(mask);
+            return _mm_or_ps(_mm_and_ps(float_mask, a), _mm_andnot_ps(float_mask, b));
+        }
+
+        static Int select(Int mask, Int a, Int b) {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        }
+
+        static int mask_bits(Int mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)); }
+        static Int round_to_int(Float a) { return _mm_cvtps_epi32(a); }
+
+        static Float load(const float* values) { return _mm_loadu_ps(values); }
+        static Int load(const Uint32* values) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+        static void store(float* values, Float lanes) { _mm_storeu_ps(values, lanes); }
+        static void store(Uint32* values, Int lanes) { _mm_storeu_si128(reinterpret_cast<__m128i*>(values), lanes); }
+
+        static Int load(const Uint16* values) {
+            return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)), _mm_setzero_si128());
+        }
+
+        // SSE2 can only pack to signed 16-bit integers, so the lanes are
+        // shifted into that range first and shifted back once packed.
+        static void store(Uint16* values, Int lanes) {
+            Int signed_lanes = _mm_sub_epi32(lanes, _mm_set1_epi32(0x8000));
+            Int packed = _mm_xor_si128(_mm_packs_epi32(signed_lanes, signed_lanes), _mm_set1_epi16(static_cast<short>(0x8000)));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(values), packed);
+        }
+
+        static Int pack_color(Float r, Float g, Float b) {
+            Float max_channel_value = _mm_set1_ps(255.0f);
+            Int r_bits = _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(r, max_channel_value)), 24);
+            Int g_bits = _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(g, max_channel_value)), 16);
+            Int b_bits = _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(b, max_channel_value)), 8);
+
+            return _mm_or_si128(_mm_or_si128(r_bits, g_bits), _mm_or_si128(b_bits, _mm_set1_epi32(0xFF)));
+        }
+    };
+};
+
+// --------------------------------------------------------------------------
+
+namespace {
+    template<typename Variant>
+    struct Sse2Kernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_spans<Sse2Lanes, Variant>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant, int SPAN_LENGTH>
+    struct Sse2SubdividedKernel {
+        static bool run(const TriangleSetup& setup,
+                        const raster_kernels::PixelRect& clip_rect,
+                        const raster_kernels::RenderTarget& target,
+                        const texture::Texture* texture,
+                        Uint32 triangle_id,
+                        raster_kernels::PixelStats& pixel_stats) {
+
+            return raster_kernels::rasterize_triangle_subdivided_lane_spans<Sse2Lanes, Variant, SPAN_LENGTH>(setup, clip_rect, target, texture, triangle_id, pixel_stats);
+        }
+    };
+
+    template<typename Variant>
+    using Sse2Subdivided8Kernel = Sse2SubdividedKernel<Variant, 8>;
+
+    template<typename Variant>
+    using Sse2Subdivided16Kernel = Sse2SubdividedKernel<Variant, 16>;
+};
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_sse2_kernel(const RenderState& render_state) {
+    return select_kernel_variant<Sse2Kernel>(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_sse2_subdivided_kernel(int span_length, const RenderState& render_state) {
+    if (span_length == 8) {
+        return select_shading_variant<TriangleKernel, Sse2Subdivided8Kernel>(render_state);
+    }
+
+    return select_shading_variant<TriangleKernel, Sse2Subdivided16Kernel>(render_state);
+}
+
+#else
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_sse2_kernel(const RenderState& render_state) {
+    return get_scalar_kernel(render_state);
+}
+
+// --------------------------------------------------------------------------
+
+raster_kernels::TriangleKernel raster_kernels::get_sse2_subdivided_kernel(int span_length, const RenderState& render_state) {
+    return get_scalar_subdivided_kernel(span_length, render_state);
+}
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef SHADER_PIPELINE_H
+#define SHADER_PIPELINE_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "Object.h"
+#include "TriangleRasterizer.h"
+#include "raster_kernels.h"
+#include "texture.h"
+
+// Draws objects with vertex and fragment shaders of the caller's own. They
+// are plain classes rather than virtual interfaces, and every fragment
+// shader gets its own kernels with the shader compiled into the pixel loop,
+// so shading a pixel costs no more than whatever the shader itself does.
+//
+// A vertex shader computes a vertex's varyings from its attributes:
+//
+//     Varyings operator()(const shader_pipeline::VertexInput& input) const;
+//
+// Positions still go through the batched vertex stage, with the matrices
+// the draw is given, so the vertex shader only computes the varyings. A
+// fragment shader computes a pixel's color, from 0 to 1, from the
+// varyings interpolated perspective correctly across the triangle, and
+// from where the pixel is, for things like sampling mipmapped textures:
+//
+//     glm::vec3 operator()(const Varyings& varyings, const shader_pipeline::Fragment& fragment) const;
+//
+// Both have a Varyings typedef for the same struct, which can only be made
+// of floats, like plain floats and glm vectors, with no more than
+// raster_kernels::MAX_VARYING_COUNT of them in total. Anything else the
+// shaders need, like matrices, lights or textures, goes in the shaders'
+// own members.
+namespace shader_pipeline {
+    // The normal and tangent are the mesh's, which aren't normalized, and
+    // aren't quite perpendicular to each other either. Once they are, the
+    // cross product of the normal and the tangent is the bitangent that
+    // normal maps need, unless the texture mapping is mirrored.
+    struct VertexInput {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 tangent;
+        glm::vec3 color;
+        glm::vec2 tex_coord;
+    };
+
+    // The pixel a fragment shader is shading, and the triangle it belongs
+    // to.
+    struct Fragment {
+        const TriangleSetup* setup;
+        const raster_kernels::ShaderBinding* binding;
+        int x;
+        int y;
+    };
+
+    template<typename Varyings>
+    struct VaryingLayout {
+        static constexpr int COUNT = sizeof(Varyings) / sizeof(float);
+
+        static_assert(std::is_trivially_copyable<Varyings>::value, "varyings are copied around as raw floats");
+        static_assert(sizeof(Varyings) % sizeof(float) == 0 && alignof(Varyings) == alignof(float), "varyings can only be made of floats");
+        static_assert(COUNT <= raster_kernels::MAX_VARYING_COUNT, "there are too many varyings");
+    };
+
+    // ----------------------------------------------------------------------
+
+    static inline glm::vec2 varying_vec2_at(const Fragment& fragment, int first_varying, float offset_x, float offset_y) {
+        const AttributePlane* planes = fragment.binding->varying_planes + first_varying;
+        glm::vec2 interpolated_value_over_z = glm::vec2(
+            raster_kernels::evaluate_plane(planes[0], offset_x, offset_y),
+            raster_kernels::evaluate_plane(planes[1], offset_x, offset_y)
+        );
+
+        return interpolated_value_over_z / raster_kernels::evaluate_plane(fragment.setup->inverse_z, offset_x, offset_y);
+    }
+
+    // The level of detail to sample the texture at with the texture
+    // coordinates in the glm::vec2 varying that starts at the
+    // first_varying-th float of the varyings. It comes from the pixel's
+    // whole 2x2 quad, exactly like in the textured kernels.
+    static inline float texture_lod(const Fragment& fragment, const texture::Texture& texture, int first_varying) {
+        float quad_offset_x = static_cast<float>((fragment.x & ~1) - fragment.setup->min_x);
+        float quad_offset_y = static_cast<float>((fragment.y & ~1) - fragment.setup->min_y);
+
+        glm::vec2 quad_tex_coord = varying_vec2_at(fragment, first_varying, quad_offset_x, quad_offset_y);
+        glm::vec2 right_tex_coord = varying_vec2_at(fragment, first_varying, quad_offset_x + 1.0f, quad_offset_y);
+        glm::vec2 below_tex_coord = varying_vec2_at(fragment, first_varying, quad_offset_x, quad_offset_y + 1.0f);
+
+        return texture.compute_lod(right_tex_coord - quad_tex_coord, below_tex_coord - quad_tex_coord);
+    }
+
+    // A pixel's varyings, with a single division by the interpolated 1/z.
+    template<typename FragmentShader>
+    static inline typename FragmentShader::Varyings varyings_at(const TriangleSetup& setup,
+                                                                const raster_kernels::ShaderBinding& binding,
+                                                                int x,
+                                                                int y) {
+
+        typedef typename FragmentShader::Varyings Varyings;
+        const int COUNT = VaryingLayout<Varyings>::COUNT;
+
+        float offset_x = static_cast<float>(x - setup.min_x);
+        float offset_y = static_cast<float>(y - setup.min_y);
+        float z = 1.0f / raster_kernels::evaluate_plane(setup.inverse_z, offset_x, offset_y);
+
+        float values[COUNT];
+        for (int i = 0; i < COUNT; i++) {
+            values[i] = raster_kernels::evaluate_plane(binding.varying_planes[i], offset_x, offset_y) * z;
+        }
+
+        Varyings varyings;
+        std::memcpy(&varyings, values, sizeof(varyings));
+        return varyings;
+    }
+
+    template<typename FragmentShader>
+    static inline Uint32 shade_fragment(const TriangleSetup& setup, const raster_kernels::ShaderBinding& binding, int x, int y) {
+        const FragmentShader& fragment_shader = *static_cast<const FragmentShader*>(binding.fragment_shader);
+        Fragment fragment = { &setup, &binding, x, y };
+        glm::vec3 color = fragment_shader(varyings_at<FragmentShader>(setup, binding, x, y), fragment);
+
+        return raster_kernels::pack_color(glm::clamp(color, 0.0f, 1.0f));
+    }
+
+    // Every kernel a fragment shader can be drawn with. They cover exactly
+    // the same pixels as the reference kernel and the multisampled ones.
+    template<typename FragmentShader>
+    struct ShaderKernels {
+        template<typename Variant>
+        struct Forward {
+            static bool run(const TriangleSetup& setup,
+                            const raster_kernels::ShaderBinding& binding,
+                            const raster_kernels::PixelRect& clip_rect,
+                            const raster_kernels::RenderTarget& target,
+                            raster_kernels::PixelStats& pixel_stats) {
+
+                return raster_kernels::rasterize_triangle_pixels_with<Variant>(setup, clip_rect, target, 0, pixel_stats, [&](int x, int y) {
+                    return shade_fragment<FragmentShader>(setup, binding, x, y);
+                });
+            }
+        };
+
+        template<typename Variant, int SAMPLE_COUNT>
+        struct Multisample {
+            static bool run(const TriangleSetup& setup,
+                            const raster_kernels::ShaderBinding& binding,
+                            const raster_kernels::PixelRect& clip_rect,
+                            const raster_kernels::RenderTarget& target,
+                            raster_kernels::PixelStats& pixel_stats) {
+
+                return raster_kernels::rasterize_triangle_samples_with<Variant, SAMPLE_COUNT>(setup, clip_rect, target, pixel_stats, [&](int x, int y) {
+                    return shade_fragment<FragmentShader>(setup, binding, x, y);
+                });
+            }
+        };
+
+        template<typename Variant>
+        using Multisample2x = Multisample<Variant, 2>;
+
+        template<typename Variant>
+        using Multisample4x = Multisample<Variant, 4>;
+
+        static void resolve(const TriangleSetup& setup,
+                            const raster_kernels::ShaderBinding& binding,
+                            const raster_kernels::RenderTarget& target,
+                            int y,
+                            int min_x,
+                            int max_x) {
+
+            Uint32* color_row = target.color_buffer + y * target.width;
+            for (int x = min_x; x <= max_x; x++) {
+                color_row[x] = shade_fragment<FragmentShader>(setup, binding, x, y);
+            }
+        }
+    };
+
+    // The kernels for the fragment shader in the rasterizer's current state.
+    // The fragment shader has to stay where it is until the next flush.
+    template<typename FragmentShader>
+    ShaderDraw make_shader_draw(const TriangleRasterizer& triangle_rasterizer, const FragmentShader* fragment_shader) {
+        using raster_kernels::Shading;
+        using raster_kernels::ShaderKernel;
+        typedef ShaderKernels<FragmentShader> Kernels;
+
+        const texture::TextureFilter UNUSED_FILTER = texture::TextureFilter::NEAREST;
+        const texture::TextureWrap UNUSED_WRAP = texture::TextureWrap::CLAMP;
+
+        raster_kernels::RenderState render_state = triangle_rasterizer.get_render_state();
+
+        ShaderDraw shader_draw;
+        shader_draw.varying_count = VaryingLayout<typename FragmentShader::Varyings>::COUNT;
+        shader_draw.fragment_shader = fragment_shader;
+        shader_draw.resolve_shader = Kernels::resolve;
+
+        switch (triangle_rasterizer.get_multisampling()) {
+            case 2:
+                shader_draw.kernel = raster_kernels::select_depth_variant<ShaderKernel, Kernels::template Multisample2x, Shading::FRAGMENT_SHADER, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+                break;
+
+            case 4:
+                shader_draw.kernel = raster_kernels::select_depth_variant<ShaderKernel, Kernels::template Multisample4x, Shading::FRAGMENT_SHADER, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+                break;
+
+            default:
+                shader_draw.kernel = raster_kernels::select_depth_variant<ShaderKernel, Kernels::template Forward, Shading::FRAGMENT_SHADER, UNUSED_FILTER, UNUSED_WRAP>(render_state);
+                break;
+        }
+
+        return shader_draw;
+    }
+
+    // Runs the vertex shader on every vertex of the object, once, and then
+    // draws it with the fragment shader. The fragment shader is copied into
+    // the rasterizer's frame arena, since its triangles are only drawn when
+    // the rasterizer flushes, which frees it without destructing it.
+    template<typename VertexShader, typename FragmentShader>
+    void draw(TriangleRasterizer& triangle_rasterizer,
+              const Object& object,
+              const VertexShader& vertex_shader,
+              const FragmentShader& fragment_shader,
+              const glm::mat4& projection,
+              const glm::mat4& view,
+              const glm::mat4& model) {
+
+        typedef typename FragmentShader::Varyings Varyings;
+        const int VARYING_COUNT = VaryingLayout<Varyings>::COUNT;
+
+        static_assert(std::is_same<typename VertexShader::Varyings, Varyings>::value, "the vertex and fragment shaders must have the same varyings");
+        static_assert(alignof(FragmentShader) <= alignof(std::max_align_t), "fragment shaders can't be overaligned");
+
+        MeshArrays arrays = object.get_arrays();
+
+        std::vector<float>& varyings = triangle_rasterizer.get_transformed_vertices().varyings;
+        size_t varyings_size = static_cast<size_t>(arrays.vertex_count) * VARYING_COUNT;
+        if (varyings.size() < varyings_size) {
+            varyings.resize(varyings_size);
+        }
+
+        for (int i = 0; i < arrays.vertex_count; i++) {
+            VertexInput input;
+            input.position = glm::vec3(arrays.positions_x[i], arrays.positions_y[i], arrays.positions_z[i]);
+            input.normal = arrays.normals[i];
+            input.tangent = arrays.tangents[i];
+            input.color = arrays.colors[i];
+            input.tex_coord = arrays.tex_coords[i];
+
+            Varyings vertex_varyings = vertex_shader(input);
+            std::memcpy(varyings.data() + static_cast<size_t>(i) * VARYING_COUNT, &vertex_varyings, sizeof(vertex_varyings));
+        }
+
+        FragmentShader* binned_fragment_shader = triangle_rasterizer.get_frame_arena().allocate_array<FragmentShader>(1);
+        new (binned_fragment_shader) FragmentShader(fragment_shader);
+
+        object.rasterize(triangle_rasterizer, make_shader_draw(triangle_rasterizer, binned_fragment_shader), projection, view, model);
+    }
+};
+
+#endif
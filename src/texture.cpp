@@ -1,118 +1,302 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Texture ids start at 1, and are handed out in the order the textures are
+// constructed in, from whichever thread.
+static std::atomic<Uint32> next_texture_id(1);
+
 // --------------------------------------------------------------------------
 
-glm::vec3 texture::sample_locked_surface(SDL_Surface* surface,
-                                         const SDL_PixelFormatDetails* surface_pixel_format_details,
-                                         const glm::vec2& texture_coordinate,
-                                         const texture::TextureFilter& texture_filter,
-                                         const texture::TextureWrap& texture_wrap) {
+static bool is_power_of_two(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
 
-    glm::vec2 wrapped_tex_coord = apply_wrap_to_texture_coord(texture_coordinate, texture_wrap);
+// --------------------------------------------------------------------------
 
-    // Remember that the y-coordinate is upside down because of how images are loaded!
-    glm::vec2 image_tex_coord = glm::vec2(wrapped_tex_coord.x, 1.0f - wrapped_tex_coord.y);
+static Uint32 pack_texel(Uint32 r, Uint32 g, Uint32 b) {
+    return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+}
 
-    return apply_filter_to_texture_coord(surface, surface_pixel_format_details, texture_filter, texture_wrap, image_tex_coord);
+// --------------------------------------------------------------------------
+
+static Uint32 average_texels(Uint32 texel00, Uint32 texel10, Uint32 texel01, Uint32 texel11) {
+    Uint32 channels[3];
+    for (int i = 0; i < 3; i++) {
+        int shift = 24 - 8 * i;
+        Uint32 sum = ((texel00 >> shift) & 0xFF) + ((texel10 >> shift) & 0xFF)
+                   + ((texel01 >> shift) & 0xFF) + ((texel11 >> shift) & 0xFF);
+
+        channels[i] = (sum + 2) / 4;
+    }
+
+    return pack_texel(channels[0], channels[1], channels[2]);
 }
 
 // --------------------------------------------------------------------------
 
-glm::vec2 texture::apply_wrap_to_texture_coord(const glm::vec2& texture_coordinate, const texture::TextureWrap texture_wrap) {
-    glm::vec2 final_tex_coord;
+static glm::vec3 unpack_texel(Uint32 texel) {
+    return glm::vec3((texel >> 24) / 255.0f, ((texel >> 16) & 0xFF) / 255.0f, ((texel >> 8) & 0xFF) / 255.0f);
+}
 
-    if (texture_wrap == TextureWrap::CLAMP) {
-        final_tex_coord = glm::clamp(texture_coordinate, 0.0f, 1.0f);
-    } else if (texture_wrap == TextureWrap::REPEAT) {
-        int x_int = static_cast<int>(texture_coordinate.x);
-        float x_frac = texture_coordinate.x - x_int;
-        if (x_frac < 0.0f) {
-            x_frac += 1.0f;
-        }
+// --------------------------------------------------------------------------
 
-        int y_int = static_cast<int>(texture_coordinate.y);
-        float y_frac = texture_coordinate.y - y_int;
-        if (y_frac < 0.0f) {
-            y_frac += 1.0f;
-        }
+// Repeating only keeps the fractional part, which is also what keeps huge
+// texture coordinates from overflowing once they are scaled to texels.
+template<texture::TextureWrap WRAP>
+static float apply_wrap_to_texture_coord(float texture_coordinate) {
+    if constexpr (WRAP == texture::TextureWrap::REPEAT) {
+        return texture_coordinate - std::floor(texture_coordinate);
+    }
+
+    return glm::clamp(texture_coordinate, 0.0f, 1.0f);
+}
+
+// --------------------------------------------------------------------------
 
-        final_tex_coord = glm::vec2(x_frac, y_frac);
+template<texture::TextureWrap WRAP>
+static int wrap_texel_coordinate(int coordinate, int size, int mask) {
+    if constexpr (WRAP == texture::TextureWrap::CLAMP) {
+        return glm::clamp(coordinate, 0, size - 1);
     }
 
-    return final_tex_coord;
+    if (mask >= 0) {
+        return coordinate & mask;
+    }
+
+    int wrapped_coordinate = coordinate % size;
+    return wrapped_coordinate < 0 ? wrapped_coordinate + size : wrapped_coordinate;
 }
 
 // --------------------------------------------------------------------------
 
-glm::vec3 texture::apply_filter_to_texture_coord(SDL_Surface* surface,
-                                                    const SDL_PixelFormatDetails* surface_pixel_format_details,
-                                                    const texture::TextureFilter& filter,
-                                                    const texture::TextureWrap& wrap,
-                                                    const glm::vec2& tex_coord) {
+texture::Texture::Texture(SDL_Surface* surface)
+:
+id(next_texture_id.fetch_add(1, std::memory_order_relaxed)) {
+
+    int level_width = surface->w;
+    int level_height = surface->h;
+    std::vector<Uint32> level_texels(level_width * level_height);
 
-    Uint8 r, g, b;
+    const SDL_PixelFormatDetails* pixel_format_details = SDL_GetPixelFormatDetails(surface->format);
+    SDL_LockSurface(surface);
 
-    // We're assuming that the surface has four bytes per pixel, so the client
-    // needs to ensure that the surface meets this invariant.
-    Uint32* pixels = reinterpret_cast<Uint32*>(surface->pixels);
+    for (int y = 0; y < level_height; y++) {
+        const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) + y * surface->pitch);
+        for (int x = 0; x < level_width; x++) {
+            Uint8 r, g, b;
+            SDL_GetRGB(row[x], pixel_format_details, nullptr, &r, &g, &b);
 
-    int p00_x = static_cast<int>(tex_coord.x * surface->w);
-    int p00_y = static_cast<int>(tex_coord.y * surface->h);
+            level_texels[y * level_width + x] = pack_texel(r, g, b);
+        }
+    }
 
-    float p00_x_frac = (tex_coord.x * surface->w) - p00_x;
-    float p00_y_frac = (tex_coord.y * surface->h) - p00_y;
+    SDL_UnlockSurface(surface);
 
-    SDL_GetRGB(pixels[p00_y * surface->w + p00_x], surface_pixel_format_details, nullptr, &r, &g, &b);
-    glm::vec3 p00_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
+    add_level(level_texels, level_width, level_height);
 
-    glm::vec3 color;
-    if (filter == TextureFilter::NEAREST) {
-        color = p00_color;
-    } else if (filter == TextureFilter::BILINEAR) {
-        int next_x = p00_x_frac < 0.5 ? p00_x - 1 : p00_x + 1;
-        int next_y = p00_y_frac < 0.5 ? p00_y - 1 : p00_y + 1;
+    // Every level averages 2x2 texels of the one before it. Once a level is
+    // down to a single row or column, that row or column is averaged with itself.
+    while (level_width > 1 || level_height > 1) {
+        int next_width = std::max(level_width / 2, 1);
+        int next_height = std::max(level_height / 2, 1);
+        std::vector<Uint32> next_texels(next_width * next_height);
 
-        if (wrap == TextureWrap::CLAMP) {
-            next_x = glm::clamp(next_x, 0, surface->w - 1);
-            next_y = glm::clamp(next_y, 0, surface->h - 1);
-        } else if (wrap == TextureWrap::REPEAT) {
-            if (next_x < 0) {
-                next_x = surface->w - 1;
-            } else if (next_x >= surface->w) {
-                next_x = 0;
-            }
+        for (int y = 0; y < next_height; y++) {
+            const Uint32* row0 = level_texels.data() + std::min(2 * y, level_height - 1) * level_width;
+            const Uint32* row1 = level_texels.data() + std::min(2 * y + 1, level_height - 1) * level_width;
+            for (int x = 0; x < next_width; x++) {
+                int x0 = std::min(2 * x, level_width - 1);
+                int x1 = std::min(2 * x + 1, level_width - 1);
 
-            if (next_y < 0) {
-                next_y = surface->h - 1;
-            } else if (next_y >= surface->h) {
-                next_y = 0;
+                next_texels[y * next_width + x] = average_texels(row0[x0], row0[x1], row1[x0], row1[x1]);
             }
         }
 
-        // This is a diagram depicting the naming convention of the points.
-        // Flip it horizontally and/or vertically as necessary.
-        //  ----- -----
-        // | p00 | p10 |
-        //  ----- -----
-        // | p10 | p11 |
-        //  ----- -----
+        level_width = next_width;
+        level_height = next_height;
+        level_texels.swap(next_texels);
 
-        SDL_GetRGB(pixels[p00_y * surface->w + next_x], surface_pixel_format_details, nullptr, &r, &g, &b);
-        glm::vec3 p10_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
+        add_level(level_texels, level_width, level_height);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+texture::Texture::~Texture() {
+    // nothing to do for now
+}
+
+// --------------------------------------------------------------------------
+
+int texture::Texture::get_width() const {
+    return levels[0].width;
+}
+
+// --------------------------------------------------------------------------
+
+int texture::Texture::get_height() const {
+    return levels[0].height;
+}
+
+// --------------------------------------------------------------------------
 
-        SDL_GetRGB(pixels[next_y * surface->w + p00_x], surface_pixel_format_details, nullptr, &r, &g, &b);
-        glm::vec3 p01_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
+int texture::Texture::get_level_count() const {
+    return static_cast<int>(levels.size());
+}
 
-        SDL_GetRGB(pixels[next_y * surface->w + next_x], surface_pixel_format_details, nullptr, &r, &g, &b);
-        glm::vec3 p11_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
+// --------------------------------------------------------------------------
+
+Uint32 texture::Texture::get_id() const {
+    return id;
+}
 
-        float t_x = p00_x_frac < 0.5 ? 0.5f - p00_x_frac : p00_x_frac - 0.5f;
-        float t_y = p00_y_frac < 0.5 ? 0.5f - p00_y_frac : p00_y_frac - 0.5f;
+// --------------------------------------------------------------------------
+
+float texture::Texture::compute_lod(const glm::vec2& texture_coordinate_step_x,
+                                   const glm::vec2& texture_coordinate_step_y) const {
+
+    glm::vec2 size = glm::vec2(levels[0].width, levels[0].height);
+    glm::vec2 texel_step_x = texture_coordinate_step_x * size;
+    glm::vec2 texel_step_y = texture_coordinate_step_y * size;
+
+    // Whichever direction crosses more texels decides, and halving the log
+    // takes care of the square root of the squared lengths.
+    float max_squared_length = std::max(glm::dot(texel_step_x, texel_step_x), glm::dot(texel_step_y, texel_step_y));
+    float lod = 0.5f * std::log2(max_squared_length);
+
+    return std::isnan(lod) ? 0.0f : lod;
+}
 
-        glm::vec3 horizontal_color1 = glm::mix(p00_color, p10_color, t_x);
-        glm::vec3 horizontal_color2 = glm::mix(p10_color, p11_color, t_x);
-        color = glm::mix(horizontal_color1, horizontal_color2, t_y);
+// --------------------------------------------------------------------------
+
+template<texture::TextureFilter FILTER, texture::TextureWrap WRAP>
+glm::vec3 texture::Texture::sample(const glm::vec2& texture_coordinate, const float lod) const {
+    // Remember that the y-coordinate is upside down because of how images are loaded!
+    float u = apply_wrap_to_texture_coord<WRAP>(texture_coordinate.x);
+    float v = 1.0f - apply_wrap_to_texture_coord<WRAP>(texture_coordinate.y);
+
+    if constexpr (FILTER == TextureFilter::NEAREST) {
+        return sample_nearest<WRAP>(levels[0], u, v);
+    } else if constexpr (FILTER == TextureFilter::BILINEAR) {
+        return sample_bilinear<WRAP>(levels[0], u, v);
+    }
+
+    // Magnified textures just use the full sized level, and this also keeps
+    // a NaN level of detail from turning into a level index.
+    float clamped_lod = lod > 0.0f ? std::min(lod, static_cast<float>(levels.size() - 1)) : 0.0f;
+
+    if constexpr (FILTER == TextureFilter::NEAREST_MIPMAP) {
+        return sample_nearest<WRAP>(levels[static_cast<int>(clamped_lod + 0.5f)], u, v);
+    }
+
+    int level_index = static_cast<int>(clamped_lod);
+    float t = clamped_lod - level_index;
+
+    glm::vec3 color = sample_bilinear<WRAP>(levels[level_index], u, v);
+    if (t > 0.0f) {
+        color = glm::mix(color, sample_bilinear<WRAP>(levels[level_index + 1], u, v), t);
+    }
+
+    return color;
+}
+
+// --------------------------------------------------------------------------
+
+void texture::Texture::add_level(const std::vector<Uint32>& level_texels, int level_width, int level_height) {
+    MipLevel level;
+    level.width = level_width;
+    level.height = level_height;
+    level.tile_columns = (level_width + TILE_SIZE - 1) / TILE_SIZE;
+    level.width_mask = is_power_of_two(level_width) ? level_width - 1 : -1;
+    level.height_mask = is_power_of_two(level_height) ? level_height - 1 : -1;
+    level.first_texel = static_cast<int>(texels.size());
+
+    // Texels past the right and bottom edges only pad out the last tiles,
+    // and are never sampled since every coordinate is wrapped or clamped first.
+    int tile_rows = (level_height + TILE_SIZE - 1) / TILE_SIZE;
+    texels.resize(texels.size() + level.tile_columns * tile_rows * TILE_SIZE * TILE_SIZE);
+
+    for (int y = 0; y < level_height; y++) {
+        for (int x = 0; x < level_width; x++) {
+            texels[texel_index(level, x, y)] = level_texels[y * level_width + x];
+        }
     }
 
-    return glm::clamp(color, 0.0f, 1.0f);
-}
\ No newline at end of file
+    levels.push_back(level);
+}
+
+// --------------------------------------------------------------------------
+
+int texture::Texture::texel_index(const MipLevel& level, int x, int y) const {
+    int tile_index = (y >> TILE_SIZE_BITS) * level.tile_columns + (x >> TILE_SIZE_BITS);
+    return level.first_texel + (tile_index << (2 * TILE_SIZE_BITS)) + ((y & TILE_MASK) << TILE_SIZE_BITS) + (x & TILE_MASK);
+}
+
+// --------------------------------------------------------------------------
+
+Uint32 texture::Texture::fetch(const MipLevel& level, int x, int y) const {
+    return texels[texel_index(level, x, y)];
+}
+
+// --------------------------------------------------------------------------
+
+template<texture::TextureWrap WRAP>
+int texture::Texture::wrap_x(const MipLevel& level, int x) const {
+    return wrap_texel_coordinate<WRAP>(x, level.width, level.width_mask);
+}
+
+// --------------------------------------------------------------------------
+
+template<texture::TextureWrap WRAP>
+int texture::Texture::wrap_y(const MipLevel& level, int y) const {
+    return wrap_texel_coordinate<WRAP>(y, level.height, level.height_mask);
+}
+
+// --------------------------------------------------------------------------
+
+template<texture::TextureWrap WRAP>
+glm::vec3 texture::Texture::sample_nearest(const MipLevel& level, float u, float v) const {
+    int x = wrap_x<WRAP>(level, static_cast<int>(std::floor(u * level.width)));
+    int y = wrap_y<WRAP>(level, static_cast<int>(std::floor(v * level.height)));
+
+    return unpack_texel(fetch(level, x, y));
+}
+
+// --------------------------------------------------------------------------
+
+template<texture::TextureWrap WRAP>
+glm::vec3 texture::Texture::sample_bilinear(const MipLevel& level, float u, float v) const {
+    // Bilinear filtering blends the four texels whose centers surround the
+    // sample point, so texel centers are moved onto the integer coordinates.
+    float texel_x = u * level.width - 0.5f;
+    float texel_y = v * level.height - 0.5f;
+    float floor_x = std::floor(texel_x);
+    float floor_y = std::floor(texel_y);
+    float t_x = texel_x - floor_x;
+    float t_y = texel_y - floor_y;
+
+    int x0 = wrap_x<WRAP>(level, static_cast<int>(floor_x));
+    int y0 = wrap_y<WRAP>(level, static_cast<int>(floor_y));
+    int x1 = wrap_x<WRAP>(level, static_cast<int>(floor_x) + 1);
+    int y1 = wrap_y<WRAP>(level, static_cast<int>(floor_y) + 1);
+
+    glm::vec3 top_color = glm::mix(unpack_texel(fetch(level, x0, y0)), unpack_texel(fetch(level, x1, y0)), t_x);
+    glm::vec3 bottom_color = glm::mix(unpack_texel(fetch(level, x0, y1)), unpack_texel(fetch(level, x1, y1)), t_x);
+
+    return glm::mix(top_color, bottom_color, t_y);
+}
+
+// --------------------------------------------------------------------------
+
+// The rasterizer kernels pick one of these for every filter and wrap mode.
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::NEAREST, texture::TextureWrap::CLAMP>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::NEAREST, texture::TextureWrap::REPEAT>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::BILINEAR, texture::TextureWrap::CLAMP>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::BILINEAR, texture::TextureWrap::REPEAT>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::NEAREST_MIPMAP, texture::TextureWrap::CLAMP>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::NEAREST_MIPMAP, texture::TextureWrap::REPEAT>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::TRILINEAR, texture::TextureWrap::CLAMP>(const glm::vec2&, const float) const;
+template glm::vec3 texture::Texture::sample<texture::TextureFilter::TRILINEAR, texture::TextureWrap::REPEAT>(const glm::vec2&, const float) const;
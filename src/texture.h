@@ -3,11 +3,18 @@
 
 #include <SDL3/SDL.h>
 #include <glm/glm.hpp>
+#include <vector>
 
 namespace texture {
     enum class TextureFilter {
         NEAREST,
         BILINEAR,
+
+        // These pick a mip level from how much of the texture a pixel covers.
+        // NEAREST_MIPMAP takes the nearest texel of the nearest level, while
+        // TRILINEAR blends bilinear samples of the two nearest levels.
+        NEAREST_MIPMAP,
+        TRILINEAR,
     };
 
     enum class TextureWrap {
@@ -15,19 +22,99 @@ namespace texture {
         REPEAT,
     };
 
-    glm::vec3 sample_locked_surface(SDL_Surface* surface,
-                                    const SDL_PixelFormatDetails* surface_pixel_format_details,
-                                    const glm::vec2& texture_coordinate,
-                                    const texture::TextureFilter& texture_filter,
-                                    const texture::TextureWrap& texture_wrap);
+    // How a draw samples its texture.
+    struct SamplerState {
+        TextureFilter filter;
+        TextureWrap wrap;
+    };
+
+    // A texture decoded once, up front, into packed RGBA8888 texels. The texels
+    // are stored in small square tiles rather than row by row, so the texels
+    // around a sample are usually in the same cache line whichever way the
+    // texture is rotated on screen.
+    //
+    // A full chain of mip levels is built along with it, each one half the
+    // size of the one before, all the way down to a single texel.
+    //
+    // This lives here rather than in its own Texture.h, which would collide
+    // with texture.h on case-insensitive file systems.
+    class Texture {
+
+    public:
+
+        // The surface is only read while constructing the texture, and is
+        // assumed to have four bytes per pixel, so the caller needs to make
+        // sure it meets that invariant.
+        Texture(SDL_Surface* surface);
+        ~Texture();
+
+        int get_width() const;
+        int get_height() const;
+        int get_level_count() const;
+
+        // Every texture gets an id of its own when it is constructed, which
+        // is never 0, so draws can be grouped by texture without looking
+        // their textures up anywhere.
+        Uint32 get_id() const;
+
+        // The level of detail for a pixel whose texture coordinates change by
+        // these amounts when stepping one pixel right and one pixel down.
+        // Level 0 is the full texture, level 1 is half of it, and so on; a
+        // level of detail at or below 0 means the texture is magnified.
+        float compute_lod(const glm::vec2& texture_coordinate_step_x,
+                          const glm::vec2& texture_coordinate_step_y) const;
+
+        // The level of detail is only used by the mipmapped filters. The
+        // filter and wrap mode are template arguments so that rasterizer
+        // kernels built for one of them don't branch on them per sample.
+        // Every combination is instantiated in texture.cpp.
+        template<TextureFilter FILTER, TextureWrap WRAP>
+        glm::vec3 sample(const glm::vec2& texture_coordinate, const float lod) const;
+
+    private:
+
+        // Each tile is 4x4 texels, which is one 64 byte cache line.
+        static const int TILE_SIZE_BITS = 2;
+        static const int TILE_SIZE = 1 << TILE_SIZE_BITS;
+        static const int TILE_MASK = TILE_SIZE - 1;
 
-    glm::vec2 apply_wrap_to_texture_coord(const glm::vec2& texture_coordinate, const texture::TextureWrap texture_wrap);
+        struct MipLevel {
+            int width;
+            int height;
+            int tile_columns;
 
-    glm::vec3 apply_filter_to_texture_coord(SDL_Surface* surface,
-                                               const SDL_PixelFormatDetails* surface_pixel_format_details,
-                                               const texture::TextureFilter& filter,
-                                               const texture::TextureWrap& wrap,
-                                               const glm::vec2& tex_coord);
+            // Repeating a power of two sized level only takes a bitwise and.
+            // These are -1 for other sizes.
+            int width_mask;
+            int height_mask;
+
+            // Where the level's tiles start in texels.
+            int first_texel;
+        };
+
+        Uint32 id;
+
+        // Every level's tiles are stored one after the other, largest first.
+        std::vector<MipLevel> levels;
+        std::vector<Uint32> texels;
+
+        void add_level(const std::vector<Uint32>& level_texels, int level_width, int level_height);
+
+        int texel_index(const MipLevel& level, int x, int y) const;
+        Uint32 fetch(const MipLevel& level, int x, int y) const;
+
+        template<TextureWrap WRAP>
+        int wrap_x(const MipLevel& level, int x) const;
+
+        template<TextureWrap WRAP>
+        int wrap_y(const MipLevel& level, int y) const;
+
+        template<TextureWrap WRAP>
+        glm::vec3 sample_nearest(const MipLevel& level, float u, float v) const;
+
+        template<TextureWrap WRAP>
+        glm::vec3 sample_bilinear(const MipLevel& level, float u, float v) const;
+    };
 };
 
 #endif
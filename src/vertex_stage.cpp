@@ -0,0 +1,202 @@
+#include "vertex_stage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// --------------------------------------------------------------------------
+
+static Uint8 compute_clip_flags(float clip_x, float clip_y, float clip_z, float clip_w, const vertex_stage::Viewport& viewport) {
+    Uint8 clip_flags = 0;
+
+    if (clip_x < -clip_w) {
+        clip_flags |= vertex_stage::CLIP_LEFT;
+    }
+    if (clip_x > clip_w) {
+        clip_flags |= vertex_stage::CLIP_RIGHT;
+    }
+    if (clip_y < -clip_w) {
+        clip_flags |= vertex_stage::CLIP_BOTTOM;
+    }
+    if (clip_y > clip_w) {
+        clip_flags |= vertex_stage::CLIP_TOP;
+    }
+    if (clip_z < -clip_w) {
+        clip_flags |= vertex_stage::CLIP_NEAR;
+    }
+    if (clip_z > clip_w) {
+        clip_flags |= vertex_stage::CLIP_FAR;
+    }
+
+    float guard_band_w_x = viewport.guard_band_x * clip_w;
+    float guard_band_w_y = viewport.guard_band_y * clip_w;
+    if (clip_x < -guard_band_w_x || clip_x > guard_band_w_x || clip_y < -guard_band_w_y || clip_y > guard_band_w_y) {
+        clip_flags |= vertex_stage::CLIP_GUARD_BAND;
+    }
+
+    return clip_flags;
+}
+
+// --------------------------------------------------------------------------
+
+static void transform_positions_scalar(const vertex_stage::PositionStreams& positions,
+                                       const glm::mat4& mvp,
+                                       const glm::mat4& mv,
+                                       const vertex_stage::Viewport& viewport,
+                                       int first_index,
+                                       vertex_stage::TransformedVertices& output) {
+
+    for (int i = first_index; i < positions.count; i++) {
+        float x = positions.x[i];
+        float y = positions.y[i];
+        float z = positions.z[i];
+
+        float clip_x = mvp[0][0] * x + mvp[1][0] * y + mvp[2][0] * z + mvp[3][0];
+        float clip_y = mvp[0][1] * x + mvp[1][1] * y + mvp[2][1] * z + mvp[3][1];
+        float clip_z = mvp[0][2] * x + mvp[1][2] * y + mvp[2][2] * z + mvp[3][2];
+        float clip_w = mvp[0][3] * x + mvp[1][3] * y + mvp[2][3] * z + mvp[3][3];
+
+        output.clip_x[i] = clip_x;
+        output.clip_y[i] = clip_y;
+        output.clip_z[i] = clip_z;
+        output.clip_w[i] = clip_w;
+        output.clip_flags[i] = compute_clip_flags(clip_x, clip_y, clip_z, clip_w, viewport);
+
+        output.screen_x[i] = viewport.scale_x * (clip_x / clip_w + 1.0f);
+        output.screen_y[i] = viewport.scale_y * (clip_y / clip_w + 1.0f) + viewport.offset_y;
+        output.ndc_z[i] = clip_z / clip_w;
+        output.view_z[i] = mv[0][2] * x + mv[1][2] * y + mv[2][2] * z + mv[3][2];
+    }
+}
+
+// --------------------------------------------------------------------------
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// Dots one row of a matrix with four positions at once.
+static inline __m128 transform_row(const glm::mat4& matrix, int row, __m128 x, __m128 y, __m128 z) {
+    __m128 result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(matrix[0][row]), x), _mm_mul_ps(_mm_set1_ps(matrix[1][row]), y));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(matrix[2][row]), z));
+    return _mm_add_ps(result, _mm_set1_ps(matrix[3][row]));
+}
+
+// --------------------------------------------------------------------------
+
+// Turns a comparison mask into the given clip flag in every lane it is set.
+static inline __m128i clip_flag_lanes(__m128 mask, Uint8 clip_flag) {
+    return _mm_and_si128(_mm_castps_si128(mask), _mm_set1_epi32(clip_flag));
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+
+vertex_stage::Viewport vertex_stage::make_viewport(int width, int height) {
+    Viewport viewport;
+    viewport.scale_x = (width - 1.0f) / 2.0f;
+    viewport.scale_y = -(height - 1.0f) / 2.0f;
+    viewport.offset_y = height - 1.0f;
+
+    // One unit in normalized device coordinates is half the viewport, so
+    // this is how many of them it takes to reach the guard band.
+    viewport.guard_band_x = 1.0f + GUARD_BAND_PIXELS / std::max(viewport.scale_x, 1.0f);
+    viewport.guard_band_y = 1.0f + GUARD_BAND_PIXELS / std::max(-viewport.scale_y, 1.0f);
+
+    return viewport;
+}
+
+// --------------------------------------------------------------------------
+
+void vertex_stage::transform_positions(const PositionStreams& positions,
+                                       const glm::mat4& mvp,
+                                       const glm::mat4& mv,
+                                       const Viewport& viewport,
+                                       TransformedVertices& output) {
+
+    if (static_cast<int>(output.screen_x.size()) < positions.count) {
+        output.clip_x.resize(positions.count);
+        output.clip_y.resize(positions.count);
+        output.clip_z.resize(positions.count);
+        output.clip_w.resize(positions.count);
+        output.clip_flags.resize(positions.count);
+        output.screen_x.resize(positions.count);
+        output.screen_y.resize(positions.count);
+        output.ndc_z.resize(positions.count);
+        output.view_z.resize(positions.count);
+    }
+
+    int first_remaining_index = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale_x = _mm_set1_ps(viewport.scale_x);
+    const __m128 scale_y = _mm_set1_ps(viewport.scale_y);
+    const __m128 offset_y = _mm_set1_ps(viewport.offset_y);
+    const __m128 guard_band_x = _mm_set1_ps(viewport.guard_band_x);
+    const __m128 guard_band_y = _mm_set1_ps(viewport.guard_band_y);
+
+    for (; first_remaining_index + 4 <= positions.count; first_remaining_index += 4) {
+        int i = first_remaining_index;
+        __m128 x = _mm_loadu_ps(positions.x + i);
+        __m128 y = _mm_loadu_ps(positions.y + i);
+        __m128 z = _mm_loadu_ps(positions.z + i);
+
+        __m128 clip_x = transform_row(mvp, 0, x, y, z);
+        __m128 clip_y = transform_row(mvp, 1, x, y, z);
+        __m128 clip_z = transform_row(mvp, 2, x, y, z);
+        __m128 clip_w = transform_row(mvp, 3, x, y, z);
+
+        __m128 negative_clip_w = _mm_sub_ps(_mm_setzero_ps(), clip_w);
+        __m128i clip_flags = _mm_or_si128(clip_flag_lanes(_mm_cmplt_ps(clip_x, negative_clip_w), CLIP_LEFT),
+                                          clip_flag_lanes(_mm_cmpgt_ps(clip_x, clip_w), CLIP_RIGHT));
+        clip_flags = _mm_or_si128(clip_flags, clip_flag_lanes(_mm_cmplt_ps(clip_y, negative_clip_w), CLIP_BOTTOM));
+        clip_flags = _mm_or_si128(clip_flags, clip_flag_lanes(_mm_cmpgt_ps(clip_y, clip_w), CLIP_TOP));
+        clip_flags = _mm_or_si128(clip_flags, clip_flag_lanes(_mm_cmplt_ps(clip_z, negative_clip_w), CLIP_NEAR));
+        clip_flags = _mm_or_si128(clip_flags, clip_flag_lanes(_mm_cmpgt_ps(clip_z, clip_w), CLIP_FAR));
+
+        __m128 guard_band_w_x = _mm_mul_ps(guard_band_x, clip_w);
+        __m128 guard_band_w_y = _mm_mul_ps(guard_band_y, clip_w);
+        __m128 outside_guard_band = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(clip_x, _mm_sub_ps(_mm_setzero_ps(), guard_band_w_x)),
+                                                        _mm_cmpgt_ps(clip_x, guard_band_w_x)),
+                                              _mm_or_ps(_mm_cmplt_ps(clip_y, _mm_sub_ps(_mm_setzero_ps(), guard_band_w_y)),
+                                                        _mm_cmpgt_ps(clip_y, guard_band_w_y)));
+        clip_flags = _mm_or_si128(clip_flags, clip_flag_lanes(outside_guard_band, CLIP_GUARD_BAND));
+
+        // Every lane's flags fit in its lowest byte, so packing twice leaves
+        // the four of them in the lowest 32 bits.
+        clip_flags = _mm_packs_epi32(clip_flags, clip_flags);
+        clip_flags = _mm_packus_epi16(clip_flags, clip_flags);
+        Sint32 packed_clip_flags = _mm_cvtsi128_si32(clip_flags);
+        std::memcpy(output.clip_flags.data() + i, &packed_clip_flags, 4);
+
+        __m128 screen_x = _mm_mul_ps(scale_x, _mm_add_ps(_mm_div_ps(clip_x, clip_w), one));
+        __m128 screen_y = _mm_add_ps(_mm_mul_ps(scale_y, _mm_add_ps(_mm_div_ps(clip_y, clip_w), one)), offset_y);
+
+        _mm_storeu_ps(output.clip_x.data() + i, clip_x);
+        _mm_storeu_ps(output.clip_y.data() + i, clip_y);
+        _mm_storeu_ps(output.clip_z.data() + i, clip_z);
+        _mm_storeu_ps(output.clip_w.data() + i, clip_w);
+        _mm_storeu_ps(output.screen_x.data() + i, screen_x);
+        _mm_storeu_ps(output.screen_y.data() + i, screen_y);
+        _mm_storeu_ps(output.ndc_z.data() + i, _mm_div_ps(clip_z, clip_w));
+        _mm_storeu_ps(output.view_z.data() + i, transform_row(mv, 2, x, y, z));
+    }
+#endif
+
+    transform_positions_scalar(positions, mvp, mv, viewport, first_remaining_index, output);
+}
+
+// --------------------------------------------------------------------------
+
+void vertex_stage::project_to_viewport(const glm::vec4& clip_position,
+                                       const Viewport& viewport,
+                                       glm::vec2& screen_coord,
+                                       float& ndc_z) {
+
+    screen_coord.x = viewport.scale_x * (clip_position.x / clip_position.w + 1.0f);
+    screen_coord.y = viewport.scale_y * (clip_position.y / clip_position.w + 1.0f) + viewport.offset_y;
+    ndc_z = clip_position.z / clip_position.w;
+}
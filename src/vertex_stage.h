@@ -0,0 +1,91 @@
+#ifndef VERTEX_STAGE_H
+#define VERTEX_STAGE_H
+
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vertex_stage {
+    // Which clip space planes a vertex is outside of. The first six are the
+    // view frustum's, and the last one means the vertex is past the guard band.
+    static const Uint8 CLIP_LEFT = 1 << 0;
+    static const Uint8 CLIP_RIGHT = 1 << 1;
+    static const Uint8 CLIP_BOTTOM = 1 << 2;
+    static const Uint8 CLIP_TOP = 1 << 3;
+    static const Uint8 CLIP_NEAR = 1 << 4;
+    static const Uint8 CLIP_FAR = 1 << 5;
+    static const Uint8 CLIP_GUARD_BAND = 1 << 6;
+
+    static const Uint8 CLIP_FRUSTUM = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR;
+
+    // Triangles that stick out of the viewport are left for the rasterizer to
+    // trim, unless they reach this many pixels past it. That is still well
+    // within range of the rasterizer's fixed point coordinates and of the
+    // SIMD kernels' 32-bit edge values.
+    static const float GUARD_BAND_PIXELS = 8192.0f;
+
+    // The viewport mapping in the form scale * (ndc + 1) + offset, which
+    // linearly remaps [-1, 1] to [0, width - 1] horizontally and to
+    // [height - 1, 0] vertically, since the y axis points down on screen.
+    // The guard band's extents are in normalized device coordinates.
+    struct Viewport {
+        float scale_x;
+        float scale_y;
+        float offset_y;
+        float guard_band_x;
+        float guard_band_y;
+    };
+
+    // Object space positions, stored as one array per component so that
+    // several vertices can be transformed at once.
+    struct PositionStreams {
+        const float* x;
+        const float* y;
+        const float* z;
+        int count;
+    };
+
+    // The vertex stage's results, again one array per component. The same
+    // buffers are reused for every draw, so they only grow when an object
+    // has more vertices than any object drawn before it.
+    //
+    // The screen coordinates and normalized depth are garbage for vertices
+    // that are behind the camera, so triangles with any clip flags besides
+    // CLIP_LEFT through CLIP_TOP set have to be clipped in clip space first.
+    struct TransformedVertices {
+        std::vector<float> clip_x;
+        std::vector<float> clip_y;
+        std::vector<float> clip_z;
+        std::vector<float> clip_w;
+        std::vector<Uint8> clip_flags;
+        std::vector<float> screen_x;
+        std::vector<float> screen_y;
+        std::vector<float> ndc_z;
+        std::vector<float> view_z;
+
+        // The varyings that a draw's vertex shader computed, all of one
+        // vertex's after another. transform_positions() leaves them alone.
+        std::vector<float> varyings;
+    };
+
+    Viewport make_viewport(int width, int height);
+
+    // Transforms every position by the model-view-projection matrix, flags
+    // the planes it is outside of, does the perspective divide and maps the
+    // result to the viewport. The z coordinate in view space comes from the
+    // model-view matrix.
+    void transform_positions(const PositionStreams& positions,
+                             const glm::mat4& mvp,
+                             const glm::mat4& mv,
+                             const Viewport& viewport,
+                             TransformedVertices& output);
+
+    // Does the perspective divide and viewport mapping for a single clip
+    // space position, exactly the way transform_positions() does.
+    void project_to_viewport(const glm::vec4& clip_position,
+                             const Viewport& viewport,
+                             glm::vec2& screen_coord,
+                             float& ndc_z);
+};
+
+#endif